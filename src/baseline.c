@@ -0,0 +1,116 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/**
+ * Idle baselines. A baseline is the per slot mean of the raw PM table over
+ * some time, stored as a recording with a single frame. It is decoded like
+ * any other PM table, so comparing against it is a subtraction of two
+ * decoded frames (see pm_frame_subtract) or of two selections.
+ *
+ * Any recording or range of one works as a baseline as well. It is
+ * averaged when it is loaded.
+ **/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "baseline.h"
+#include "pm_diff.h"
+#include "recording.h"
+#include "timing.h"
+
+int baseline_capture(smu_obj_t *obj, unsigned int version, const char *spec, double interval_s) {
+    double seconds = BASELINE_DEFAULT_SECONDS, end;
+    char path[4096], *colon, *p;
+    recording_writer w;
+    unsigned char *pm_buf;
+    unsigned int failed = 0;
+    float *mean;
+    diff_side s;
+
+    snprintf(path, sizeof(path), "%s", spec);
+    colon = strrchr(path, ':');
+    if (colon) {
+        seconds = strtod(colon + 1, &p);
+        if (p == colon + 1 || *p || seconds <= 0) {
+            fprintf(stderr, "Invalid baseline duration \"%s\".\n", colon + 1);
+            exit(0);
+        }
+        *colon = 0;
+    }
+
+    pm_buf = calloc(obj->pm_table_size, sizeof(unsigned char));
+    mean = calloc(obj->pm_table_size, sizeof(unsigned char));
+    if (!pm_buf || !mean || !diff_side_init(&s, obj->pm_table_size / sizeof(float))) {
+        fprintf(stderr, "Could not allocate memory for the baseline.\n");
+        exit(0);
+    }
+
+    fprintf(stderr, "Capturing a baseline of PM Table version 0x%x for %g s. Keep the system idle.\n", version, seconds);
+    end = monotonic_s() + seconds;
+    while (monotonic_s() < end || !s.frames) {
+        if (smu_read_pm_table(obj, pm_buf, obj->pm_table_size) == SMU_Return_OK) {
+            diff_side_add(&s, pm_buf);
+            failed = 0;
+        }
+        else if (++failed > 100) {
+            fprintf(stderr, "Could not read the PM Table.\n");
+            exit(0);
+        }
+        sleep_seconds(interval_s, NULL);
+    }
+
+    diff_side_mean(&s, mean);
+    recording_create(&w, path, version, obj->pm_table_size);
+    recording_write(&w, (unsigned char*)mean, obj->pm_table_size);
+    recording_close(&w);
+    fprintf(stderr, "Wrote the mean of %llu samples to \"%s\".\n", (unsigned long long)s.frames, path);
+
+    diff_side_free(&s);
+    free(mean);
+    free(pm_buf);
+
+    return 0;
+}
+
+float* baseline_load(const char *spec, unsigned int version, unsigned int size) {
+    float *mean;
+    diff_side s;
+
+    if (!diff_side_load_spec(&s, spec)) exit(0);
+    if (s.num_slots * sizeof(float) < size) {
+        fprintf(stderr, "The baseline \"%s\" is smaller than the PM Table (%u of %u bytes).\n",
+            spec, (unsigned int)(s.num_slots * sizeof(float)), size);
+        exit(0);
+    }
+    if (s.version && s.version != version)
+        fprintf(stderr, "The baseline was taken with PM Table version 0x%x, not 0x%x.\n", s.version, version);
+
+    mean = calloc(s.num_slots, sizeof(float));
+    if (!mean) {
+        fprintf(stderr, "Could not allocate memory for the baseline.\n");
+        exit(0);
+    }
+    diff_side_mean(&s, mean);
+    diff_side_free(&s);
+
+    return mean;
+}
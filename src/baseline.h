@@ -0,0 +1,36 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef BASELINE_H
+#define BASELINE_H
+
+#include <libsmu.h>
+
+#define BASELINE_DEFAULT_SECONDS  30
+#define BASELINE_DEFAULT_INTERVAL 0.1
+
+//Samples the PM table for a while and writes the mean of every slot as a recording with
+//one frame. spec is "file" or "file:seconds".
+int baseline_capture(smu_obj_t *obj, unsigned int version, const char *spec, double interval_s);
+
+//The mean of a dump, recording or recording range ("file@start:end") as a PM table of
+//size bytes. Exits on errors.
+float* baseline_load(const char *spec, unsigned int version, unsigned int size);
+
+#endif
@@ -0,0 +1,389 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/**
+ * Per sample cost of the decode, render and export paths. Needs no driver.
+ *
+ *   ./bench/pm_bench [-t dumpfile -f version | -r recording] [-c cpu] [-n reps] [-s seconds] [-j]
+ *
+ * Without -t or -r, every built-in PM table version is measured on a table
+ * of deterministic pseudo random values. Each benchmark is calibrated to run
+ * at least -s seconds, repeated -n times on one pinned CPU and reported as
+ * the median ns per operation. Bytes per operation are the output written by
+ * the render, export and recording paths and the table copied when reading
+ * a recording. -j prints one JSON object per line instead of a table.
+ **/
+
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "pm_tables.h"
+#include "pm_frame.h"
+#include "pm_selection.h"
+#include "exporters.h"
+#include "recording.h"
+#include "core_stats.h"
+#include "cpu_topology.h"
+#include "perf_counters.h"
+#include "timing.h"
+
+#define BENCH_PM_BUF_SIZE   10240
+#define BENCH_OUT_SIZE      (256 * 1024)
+#define BENCH_MAX_REPS      64
+#define BENCH_REC_FRAMES    4096    //Frames of the synthetic recording
+
+//ryzen_monitor.c is linked in with main renamed
+void draw_screen(pm_frame *frame, system_info *sysinfo, cpu_topology *topo, perf_counters *perf);
+
+typedef struct {
+    unsigned int version;
+    unsigned int size;                      //Bytes of PM table per sample
+    unsigned char pm_buf[BENCH_PM_BUF_SIZE];
+    unsigned char copy_buf[BENCH_PM_BUF_SIZE];
+    pm_table pmt;
+    pm_frame frame;
+    system_info sysinfo;
+    pm_selection sel;                       //Everything, like -e without -F
+    FILE *out;                              //Fixed buffer, rewound per operation
+    char out_buf[BENCH_OUT_SIZE];
+    recording_writer writer;                //Writes to /dev/null
+    recording rec;
+    uint64_t rec_pos;
+} bench_ctx;
+
+typedef size_t (*bench_fn)(bench_ctx *ctx);
+
+static int reps = 5;
+static double min_seconds = 0.2;
+static int json = 0;
+static int cpu = -1;
+
+static size_t bench_select(bench_ctx *ctx) {
+    pm_table pmt;
+
+    select_pm_table_version(ctx->version, &pmt, ctx->pm_buf);
+    pm_table_free(&pmt);
+
+    return 0;
+}
+
+static size_t bench_extract(bench_ctx *ctx) {
+    pm_frame_extract(&ctx->frame);
+
+    return 0;
+}
+
+//The statistics draw_screen computes over the enabled cores
+static size_t bench_aggregate(bench_ctx *ctx) {
+    pm_frame *frame = &ctx->frame;
+    core_stat s;
+
+    core_stats_array(frame->core_freqeff, &frame->mask, &s);
+    core_stats_array(frame->core_temp, &frame->mask, &s);
+    core_stats_array(frame->core_voltage_est, &frame->mask, &s);
+    core_stats_array(frame->core_power, &frame->mask, &s);
+    core_stats_array(frame->core_c0, &frame->mask, &s);
+    core_stats_array(frame->core_cc6, &frame->mask, &s);
+
+    return 0;
+}
+
+static size_t bench_render(bench_ctx *ctx) {
+    FILE *screen = stdout;
+
+    rewind(ctx->out);
+    stdout = ctx->out;
+    draw_screen(&ctx->frame, &ctx->sysinfo, NULL, NULL);
+    stdout = screen;
+
+    return ftell(ctx->out);
+}
+
+static size_t bench_export(bench_ctx *ctx, export_format format) {
+    rewind(ctx->out);
+    pm_selection_decode(&ctx->sel);
+    export_sample(ctx->out, format, &ctx->sel, &ctx->pmt, 1.6e9, NULL);
+
+    return ftell(ctx->out);
+}
+
+static size_t bench_json(bench_ctx *ctx) {
+    return bench_export(ctx, EXPORT_JSON);
+}
+
+static size_t bench_prometheus(bench_ctx *ctx) {
+    return bench_export(ctx, EXPORT_PROMETHEUS);
+}
+
+static size_t bench_record_encode(bench_ctx *ctx) {
+    recording_write(&ctx->writer, ctx->pm_buf, ctx->size);
+
+    return sizeof(uint64_t) + ctx->size;
+}
+
+//Seeks to a frame by timestamp and copies it out, like replaying with -t does
+static size_t bench_record_decode(bench_ctx *ctx) {
+    const recording *r = &ctx->rec;
+    uint64_t i;
+
+    ctx->rec_pos = (ctx->rec_pos + 7919) % r->frames;
+    i = recording_find(r, recording_timestamp(r, ctx->rec_pos));
+    memcpy(ctx->copy_buf, recording_table(r, i), r->header.pm_table_size);
+
+    return r->header.pm_table_size;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static void run(bench_ctx *ctx, const char *name, bench_fn fn) {
+    double t, times[BENCH_MAX_REPS];
+    unsigned long long iters, i;
+    size_t bytes = 0;
+    int r;
+
+    //Calibrate to min_seconds per repetition, this also warms the caches
+    for (iters = 1; ; iters *= 2) {
+        t = monotonic_s();
+        for (i = 0; i < iters; i++) bytes = fn(ctx);
+        t = monotonic_s() - t;
+        if (t >= min_seconds / 4) break;
+    }
+    iters = iters * min_seconds / t + 1;
+
+    for (r = 0; r < reps; r++) {
+        t = monotonic_s();
+        for (i = 0; i < iters; i++) fn(ctx);
+        times[r] = (monotonic_s() - t) / iters * 1e9;
+    }
+    qsort(times, reps, sizeof(double), compare_double);
+
+    if (json)
+        fprintf(stdout, "{\"benchmark\":\"%s\",\"version\":\"0x%06x\",\"ns_per_op\":%.2f,\"min_ns_per_op\":%.2f,"
+            "\"bytes_per_op\":%zu,\"iterations\":%llu,\"reps\":%d,\"cpu\":%d}\n",
+            name, ctx->version, times[reps / 2], times[0], bytes, iters, reps, cpu);
+    else
+        fprintf(stdout, "%-16s 0x%06x %12.1f %12.1f %10zu\n", name, ctx->version, times[reps / 2], times[0], bytes);
+    fflush(stdout);
+}
+
+//xorshift32. Values like the SMU reports: temperatures, clocks, watts, residencies.
+static void fill_synthetic(unsigned char *pm_buf, unsigned int size, unsigned int seed) {
+    float *pm = (float*)pm_buf;
+    unsigned int i, x = seed;
+
+    for (i = 0; i < size / sizeof(float); i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        pm[i] = (x % 100000) / 100.f;
+    }
+}
+
+static void setup(bench_ctx *ctx) {
+    if (!select_pm_table_version(ctx->version, &ctx->pmt, ctx->pm_buf)) {
+        fprintf(stderr, "This PM Table version (0x%x) is currently not supported.\n", ctx->version);
+        exit(1);
+    }
+    if (ctx->size < ctx->pmt.min_size) {
+        fprintf(stderr, "The PM Table is %u bytes long, but version 0x%x needs %u.\n", ctx->size, ctx->version, ctx->pmt.min_size);
+        exit(1);
+    }
+
+    //All cores enabled, like reading a dump file. The header box is drawn too.
+    memset(&ctx->sysinfo, 0, sizeof(system_info));
+    ctx->sysinfo.available = 1;
+    strcpy(ctx->sysinfo.cpu_name, "Benchmark");
+    ctx->sysinfo.codename = "Benchmark";
+    ctx->sysinfo.smu_fw_ver = "0.0.0";
+    ctx->sysinfo.cores = ctx->sysinfo.enabled_cores_count = ctx->pmt.max_cores;
+    ctx->sysinfo.ccds = 1;
+    ctx->sysinfo.ccxs = 1;
+    ctx->sysinfo.cores_per_ccx = ctx->pmt.max_cores;
+
+    if (!pm_frame_init(&ctx->frame, &ctx->pmt, &ctx->sysinfo, ctx->pm_buf) || pm_selection_compile(&ctx->sel, &ctx->pmt, NULL) < 0) {
+        fprintf(stderr, "Could not allocate memory for the PM Table.\n");
+        exit(1);
+    }
+    pm_frame_extract(&ctx->frame);
+
+    ctx->out = fmemopen(ctx->out_buf, sizeof(ctx->out_buf), "w");
+    if (!ctx->out) {
+        fprintf(stderr, "Could not open the output buffer.\n");
+        exit(1);
+    }
+    recording_create(&ctx->writer, "/dev/null", ctx->version, ctx->size);
+    ctx->rec_pos = 0;
+}
+
+static void teardown(bench_ctx *ctx) {
+    recording_close(&ctx->writer);
+    fclose(ctx->out);
+    pm_selection_free(&ctx->sel);
+    pm_frame_free(&ctx->frame);
+    pm_table_free(&ctx->pmt);
+}
+
+static void run_all(bench_ctx *ctx) {
+    setup(ctx);
+    run(ctx, "select", bench_select);
+    run(ctx, "extract", bench_extract);
+    run(ctx, "aggregate", bench_aggregate);
+    run(ctx, "render", bench_render);
+    run(ctx, "json", bench_json);
+    run(ctx, "prometheus", bench_prometheus);
+    run(ctx, "record_encode", bench_record_encode);
+    if (ctx->rec.frames) run(ctx, "record_decode", bench_record_decode);
+    teardown(ctx);
+}
+
+//A recording of synthetic frames in a temporary file, unlinked once it is mapped
+static void synthetic_recording(bench_ctx *ctx) {
+    char path[] = "/tmp/pm_bench.XXXXXX";
+    recording_writer w;
+    unsigned char pm_buf[BENCH_PM_BUF_SIZE];
+    int fd, i;
+
+    fd = mkstemp(path);
+    if (fd < 0) {
+        fprintf(stderr, "Could not create a temporary recording.\n");
+        exit(1);
+    }
+    close(fd);
+    recording_create(&w, path, ctx->version, ctx->size);
+    for (i = 0; i < BENCH_REC_FRAMES; i++) {
+        fill_synthetic(pm_buf, ctx->size, ctx->version + i + 1);
+        recording_write(&w, pm_buf, ctx->size);
+    }
+    recording_close(&w);
+    if (!recording_open(&ctx->rec, path)) {
+        fprintf(stderr, "Could not read the temporary recording.\n");
+        exit(1);
+    }
+    unlink(path);
+}
+
+static void pin_cpu() {
+    cpu_set_t set;
+
+    if (cpu < 0) cpu = sched_getcpu();
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set)) {
+        fprintf(stderr, "Could not pin to CPU %d.\n", cpu);
+        exit(1);
+    }
+}
+
+#define BENCH_VERSION(v) v,
+static const unsigned int versions[] = { PM_TABLE_VERSIONS(BENCH_VERSION) 0 };
+
+int main(int argc, char **argv) {
+    char *dumpfile = NULL, *recfile = NULL;
+    unsigned int version = 0;
+    bench_ctx *ctx;
+    FILE *fp;
+    int c, i;
+
+    while ((c = getopt(argc, argv, "t:f:r:c:n:s:jh")) != -1) {
+        switch (c) {
+            case 't': dumpfile = optarg; break;
+            case 'f': version = strtoul(optarg, NULL, 16); break;
+            case 'r': recfile = optarg; break;
+            case 'c': cpu = atoi(optarg); break;
+            case 'n':
+                reps = atoi(optarg);
+                if (reps < 1 || reps > BENCH_MAX_REPS) {
+                    fprintf(stderr, "The number of repetitions must be 1 to %d.\n", BENCH_MAX_REPS);
+                    return 1;
+                }
+                break;
+            case 's': min_seconds = atof(optarg); break;
+            case 'j': json = 1; break;
+            default:
+                fprintf(stderr, "Usage: %s [-t dumpfile -f version | -r recording] [-c cpu] [-n reps] [-s seconds] [-j]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (dumpfile && !version) {
+        fprintf(stderr, "You need to specify a PM Table version with -f.\n");
+        return 1;
+    }
+
+    pin_cpu();
+    ctx = calloc(1, sizeof(bench_ctx));
+    if (!ctx) {
+        fprintf(stderr, "Could not allocate memory.\n");
+        return 1;
+    }
+
+    if (!json) {
+        fprintf(stdout, "CPU %d, %d repetitions of at least %g s, median and minimum\n", cpu, reps, min_seconds);
+        fprintf(stdout, "%-16s %8s %12s %12s %10s\n", "benchmark", "version", "ns/op", "min ns/op", "bytes/op");
+    }
+
+    if (dumpfile) {
+        fp = fopen(dumpfile, "rb");
+        if (!fp) {
+            fprintf(stderr, "Could not read the dumpfile (\"%s\").\n", dumpfile);
+            return 1;
+        }
+        ctx->size = fread(ctx->pm_buf, 1, sizeof(ctx->pm_buf), fp);
+        fclose(fp);
+        ctx->version = version;
+        run_all(ctx);
+    }
+    else if (recfile) {
+        if (!recording_open(&ctx->rec, recfile)) {
+            fprintf(stderr, "Could not read the recording \"%s\".\n", recfile);
+            return 1;
+        }
+        if (!ctx->rec.frames || ctx->rec.header.pm_table_size > sizeof(ctx->pm_buf)) {
+            fprintf(stderr, "The recording \"%s\" has no usable frames.\n", recfile);
+            return 1;
+        }
+        ctx->version = ctx->rec.header.pm_table_version;
+        ctx->size = ctx->rec.header.pm_table_size;
+        memcpy(ctx->pm_buf, recording_table(&ctx->rec, ctx->rec.frames / 2), ctx->size);
+        run_all(ctx);
+        recording_free(&ctx->rec);
+    }
+    else {
+        for (i = 0; versions[i]; i++) {
+            ctx->version = versions[i];
+            select_pm_table_version(ctx->version, &ctx->pmt, ctx->pm_buf);
+            ctx->size = ctx->pmt.min_size;
+            pm_table_free(&ctx->pmt);
+            fill_synthetic(ctx->pm_buf, ctx->size, ctx->version);
+            synthetic_recording(ctx);
+            run_all(ctx);
+            recording_free(&ctx->rec);
+        }
+    }
+    free(ctx);
+
+    return 0;
+}
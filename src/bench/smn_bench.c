@@ -0,0 +1,156 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/**
+ * Aggregate SMN read throughput of libsmu with 1, 2, 4 and 8 threads.
+ *
+ *   sudo ./bench/smn_bench [-t 1,2,4,8] [-s seconds] [-a address] [-b batch]
+ *
+ * All threads share one smu_obj_t like the sampler, exporters and register
+ * readers of ryzen_monitor would. With -b, every thread reads that many
+ * words per call of smu_read_smn_addrs instead of one per call.
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <libsmu.h>
+
+#include "timing.h"
+
+#define BENCH_MAX_THREADS   64
+#define BENCH_MAX_BATCH     64
+
+typedef struct {
+    pthread_t thread;
+    unsigned long long reads;
+    unsigned long long failed;
+} bench_thread;
+
+static smu_obj_t obj;
+static pthread_barrier_t start_barrier;
+static volatile int stop;
+static unsigned int address = 0x50200; //UMC config, also read by -m
+static unsigned int batch = 1;
+
+static void* reader(void *arg) {
+    unsigned int addrs[BENCH_MAX_BATCH], values[BENCH_MAX_BATCH], i;
+    bench_thread *t = arg;
+
+    for (i = 0; i < batch; i++) addrs[i] = address;
+    pthread_barrier_wait(&start_barrier);
+    while (!stop) {
+        if (batch == 1) {
+            if (smu_read_smn_addr(&obj, address, values) == SMU_Return_OK) t->reads++;
+            else t->failed++;
+        }
+        else {
+            if (smu_read_smn_addrs(&obj, addrs, values, batch) == SMU_Return_OK) t->reads += batch;
+            else t->failed++;
+        }
+    }
+
+    return NULL;
+}
+
+static void run(int num_threads, double seconds) {
+    bench_thread threads[BENCH_MAX_THREADS];
+    unsigned long long reads = 0, failed = 0;
+    smu_lock_stats locks[SMU_MUTEX_COUNT];
+    double t0, t1;
+    int i;
+
+    memset(threads, 0, sizeof(threads));
+    smu_lock_stats_enable(&obj, 0);
+    memset(obj.lock_stats, 0, sizeof(obj.lock_stats));
+    smu_lock_stats_enable(&obj, 1);
+
+    stop = 0;
+    pthread_barrier_init(&start_barrier, NULL, num_threads + 1);
+    for (i = 0; i < num_threads; i++) pthread_create(&threads[i].thread, NULL, reader, &threads[i]);
+    pthread_barrier_wait(&start_barrier);
+    t0 = monotonic_s();
+    usleep(seconds * 1e6);
+    stop = 1;
+    for (i = 0; i < num_threads; i++) {
+        pthread_join(threads[i].thread, NULL);
+        reads += threads[i].reads;
+        failed += threads[i].failed;
+    }
+    t1 = monotonic_s();
+    pthread_barrier_destroy(&start_barrier);
+
+    smu_get_lock_stats(&obj, locks);
+    fprintf(stdout, "%7d %12.0f %12.0f %10.2f %9.1f%% %9llu\n", num_threads,
+        reads / (t1 - t0), reads / (t1 - t0) / num_threads,
+        reads ? (t1 - t0) * num_threads / reads * 1e6 : 0.,
+        locks[SMU_MUTEX_SMN].acquisitions ? 100. * locks[SMU_MUTEX_SMN].contended / locks[SMU_MUTEX_SMN].acquisitions : 0.,
+        failed);
+}
+
+int main(int argc, char **argv) {
+    char *thread_list = "1,2,4,8", *p;
+    double seconds = 2;
+    smu_return_val ret;
+    int c, n;
+
+    while ((c = getopt(argc, argv, "t:s:a:b:h")) != -1) {
+        switch (c) {
+            case 't': thread_list = optarg; break;
+            case 's': seconds = atof(optarg); break;
+            case 'a': address = strtoul(optarg, NULL, 0); break;
+            case 'b':
+                batch = atoi(optarg);
+                if (batch < 1 || batch > BENCH_MAX_BATCH) {
+                    fprintf(stderr, "The batch size must be 1 to %d.\n", BENCH_MAX_BATCH);
+                    return 1;
+                }
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-t 1,2,4,8] [-s seconds] [-a address] [-b batch]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    ret = smu_init(&obj);
+    if (ret != SMU_Return_OK) {
+        fprintf(stderr, "%s\n", smu_return_to_str(ret));
+        return 2;
+    }
+
+    fprintf(stdout, "SMN reads of 0x%x for %g s per step, %u per call\n", address, seconds, batch);
+    fprintf(stdout, "%7s %12s %12s %10s %10s %9s\n", "threads", "reads/s", "per thread", "us/read", "contended", "failed");
+    for (p = thread_list; *p; ) {
+        n = strtol(p, &p, 10);
+        if (n < 1 || n > BENCH_MAX_THREADS) {
+            fprintf(stderr, "Thread counts must be 1 to %d.\n", BENCH_MAX_THREADS);
+            return 1;
+        }
+        run(n, seconds);
+        if (*p == ',') p++;
+        else if (*p) break;
+    }
+
+    smu_free(&obj);
+
+    return 0;
+}
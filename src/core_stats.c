@@ -0,0 +1,184 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/**
+ * Aggregation of per core PM table values over the enabled cores.
+ *
+ * Most layouts place a per core value of all cores in consecutive floats
+ * (assign_pm_elements_8/16_consec). Those runs are reduced in place with
+ * AVX2 or SSE2, depending on what the compiler targets, with the fused off
+ * cores masked out. Other arrays are gathered into a buffer first.
+ **/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "core_stats.h"
+
+#define CORE_STATS_LANES 8
+
+int core_mask_init(core_mask *m, const pm_table *pmt, system_info *sysinfo) {
+    int i, padded;
+
+    memset(m, 0, sizeof(core_mask));
+    padded = (pmt->max_cores + CORE_STATS_LANES - 1) / CORE_STATS_LANES * CORE_STATS_LANES;
+
+    m->lanes = calloc(padded, sizeof(unsigned int));
+    m->scratch = calloc(padded, sizeof(float));
+    if (!m->lanes || !m->scratch) {
+        core_mask_free(m);
+        return 0;
+    }
+
+    m->num_cores = pmt->max_cores;
+    for (i = 0; i < m->num_cores; i++) {
+        if (core_disabled(sysinfo, i)) continue;
+        m->lanes[i] = ~0u;
+        m->num_enabled++;
+    }
+
+    return 1;
+}
+
+void core_mask_free(core_mask *m) {
+    free(m->lanes);
+    free(m->scratch);
+    memset(m, 0, sizeof(core_mask));
+}
+
+float* core_stats_contiguous(float **arr, int n) {
+    int i;
+
+    for (i = 0; i < n; i++)
+        if (!arr[i] || arr[i] != arr[0] + i) return NULL;
+
+    return arr[0];
+}
+
+#if defined(__AVX2__)
+static int stats_kernel_simd(const float *v, const unsigned int *lanes, int n, float *min, float *max, float *sum) {
+    __m256 x, k, vmin, vmax, vsum;
+    float rmin[8], rmax[8], rsum[8];
+    int i, j;
+
+    vmin = _mm256_set1_ps(INFINITY);
+    vmax = _mm256_set1_ps(-INFINITY);
+    vsum = _mm256_setzero_ps();
+    for (i = 0; i + 8 <= n; i += 8) {
+        x = _mm256_loadu_ps(v + i);
+        k = _mm256_castsi256_ps(_mm256_loadu_si256((const __m256i*)(lanes + i)));
+        vsum = _mm256_add_ps(vsum, _mm256_and_ps(x, k));
+        //New value first: min/max return the second operand on NaN, so NaN never sticks
+        vmin = _mm256_min_ps(_mm256_blendv_ps(vmin, x, k), vmin);
+        vmax = _mm256_max_ps(_mm256_blendv_ps(vmax, x, k), vmax);
+    }
+    _mm256_storeu_ps(rmin, vmin);
+    _mm256_storeu_ps(rmax, vmax);
+    _mm256_storeu_ps(rsum, vsum);
+    for (j = 0; j < 8; j++) {
+        if (rmin[j] < *min) *min = rmin[j];
+        if (rmax[j] > *max) *max = rmax[j];
+        *sum += rsum[j];
+    }
+
+    return i;
+}
+#elif defined(__SSE2__)
+static int stats_kernel_simd(const float *v, const unsigned int *lanes, int n, float *min, float *max, float *sum) {
+    __m128 x, k, vmin, vmax, vsum;
+    float rmin[4], rmax[4], rsum[4];
+    int i, j;
+
+    vmin = _mm_set1_ps(INFINITY);
+    vmax = _mm_set1_ps(-INFINITY);
+    vsum = _mm_setzero_ps();
+    for (i = 0; i + 4 <= n; i += 4) {
+        x = _mm_loadu_ps(v + i);
+        k = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)(lanes + i)));
+        vsum = _mm_add_ps(vsum, _mm_and_ps(x, k));
+        //No blendv before SSE4.1
+        vmin = _mm_min_ps(_mm_or_ps(_mm_and_ps(k, x), _mm_andnot_ps(k, vmin)), vmin);
+        vmax = _mm_max_ps(_mm_or_ps(_mm_and_ps(k, x), _mm_andnot_ps(k, vmax)), vmax);
+    }
+    _mm_storeu_ps(rmin, vmin);
+    _mm_storeu_ps(rmax, vmax);
+    _mm_storeu_ps(rsum, vsum);
+    for (j = 0; j < 4; j++) {
+        if (rmin[j] < *min) *min = rmin[j];
+        if (rmax[j] > *max) *max = rmax[j];
+        *sum += rsum[j];
+    }
+
+    return i;
+}
+#else
+static int stats_kernel_simd(const float *v, const unsigned int *lanes, int n, float *min, float *max, float *sum) {
+    return 0;
+}
+#endif
+
+static void stats_kernel(const float *v, const unsigned int *lanes, int n, core_stat *s) {
+    float min, max, sum;
+    int i;
+
+    min = INFINITY;
+    max = -INFINITY;
+    sum = 0;
+
+    i = stats_kernel_simd(v, lanes, n, &min, &max, &sum);
+    for (; i < n; i++) {
+        if (!lanes[i]) continue;
+        sum += v[i];
+        if (v[i] < min) min = v[i];
+        if (v[i] > max) max = v[i];
+    }
+
+    s->min = min;
+    s->max = max;
+    s->sum = sum;
+}
+
+void core_stats_array(const float *v, core_mask *m, core_stat *s) {
+    s->count = m->num_enabled;
+    if (!m->num_enabled) {
+        s->min = s->max = s->sum = s->mean = 0;
+        return;
+    }
+
+    stats_kernel(v, m->lanes, m->num_cores, s);
+    s->mean = s->sum / s->count;
+}
+
+void core_stats(float **arr, core_mask *m, core_stat *s) {
+    const float *v;
+    int i;
+
+    v = core_stats_contiguous(arr, m->num_cores);
+    if (!v) {
+        for (i = 0; i < m->num_cores; i++) m->scratch[i] = arr[i] ? *arr[i] : NAN;
+        v = m->scratch;
+    }
+
+    core_stats_array(v, m, s);
+}
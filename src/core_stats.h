@@ -0,0 +1,54 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef CORE_STATS_H
+#define CORE_STATS_H
+
+#include "pm_tables.h"
+#include "readinfo.h"
+
+typedef struct {
+    int num_cores;
+    int num_enabled;
+    unsigned int *lanes;    //One all-ones word per enabled core, 0 for disabled ones. Padded to 8 cores.
+    float *scratch;         //Gather buffer for per core arrays that are not contiguous in the PM table
+} core_mask;
+
+typedef struct {
+    float min;
+    float max;
+    float sum;
+    float mean;
+    int count;              //Enabled cores. min/max/sum/mean are 0 if there are none.
+} core_stat;
+
+//Builds the lane mask of the enabled cores from core_disable_map.
+int core_mask_init(core_mask *m, const pm_table *pmt, system_info *sysinfo);
+void core_mask_free(core_mask *m);
+
+//Start of the run if arr[0..n) point to consecutive floats, NULL otherwise.
+float* core_stats_contiguous(float **arr, int n);
+
+//min/max/sum/mean of a per core array (e.g. pmt->CORE_POWER) over the enabled cores.
+//Runs directly over the PM table if the array is contiguous in it. Missing elements are NaN, like pmta().
+void core_stats(float **arr, core_mask *m, core_stat *s);
+//Same over num_cores consecutive floats, e.g. the arrays of a pm_frame.
+void core_stats_array(const float *v, core_mask *m, core_stat *s);
+
+#endif
@@ -0,0 +1,286 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/**
+ * Mapping of PM table cores to Linux logical CPUs and per CPU utilization.
+ *
+ * The PM table has one slot per physical core position, including fused off
+ * cores. On a single package, Linux' core_id is that position as well, with
+ * the same gaps, so it is used directly when it fits the enabled PM table
+ * cores. Otherwise the physical cores sorted by (package, die, core_id) are
+ * assigned to the enabled PM table cores in order. That only holds if every
+ * core is online, with a whole core offline nothing is mapped.
+ **/
+
+#include <math.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+
+#include "cpu_topology.h"
+
+#define SYSFS_CPU_PATH "/sys/devices/system/cpu"
+#define PROC_STAT_PATH "/proc/stat"
+
+typedef struct {
+    int package_id;
+    int die_id;
+    int core_id;
+    int first_cpu;  //Lowest thread sibling. Identifies the physical core.
+    int pm_core;    //Assigned PM table core
+} phys_core;
+
+static int read_topology_int(int cpu, const char *name, int *value) {
+    char path[128], buf[32];
+    FILE *fp;
+    int ok;
+
+    snprintf(path, sizeof(path), SYSFS_CPU_PATH "/cpu%d/topology/%s", cpu, name);
+    fp = fopen(path, "r");
+    if (!fp) return 0;
+    ok = fgets(buf, sizeof(buf), fp) != NULL;
+    fclose(fp);
+    if (ok) *value = atoi(buf);
+
+    return ok;
+}
+
+//Parses a cpu list like "0,16" or "0-1" and returns the lowest cpu and the number of cpus in it.
+static int read_thread_siblings(int cpu, int *first, int *count) {
+    char path[128], buf[256], *p;
+    int a, b, n;
+    FILE *fp;
+
+    snprintf(path, sizeof(path), SYSFS_CPU_PATH "/cpu%d/topology/thread_siblings_list", cpu);
+    fp = fopen(path, "r");
+    if (!fp) return 0;
+    p = fgets(buf, sizeof(buf), fp);
+    fclose(fp);
+    if (!p) return 0;
+
+    *first = -1;
+    *count = 0;
+    while (*p && *p != '\n') {
+        if (sscanf(p, "%d%n", &a, &n) != 1) break;
+        p += n;
+        b = a;
+        if (*p == '-') {
+            p++;
+            if (sscanf(p, "%d%n", &b, &n) != 1) break;
+            p += n;
+        }
+        if (*first < 0 || a < *first) *first = a;
+        *count += b - a + 1;
+        if (*p == ',') p++;
+    }
+
+    return *first >= 0;
+}
+
+static int compare_phys_core(const void *a, const void *b) {
+    const phys_core *x = a, *y = b;
+
+    if (x->package_id != y->package_id) return x->package_id - y->package_id;
+    if (x->die_id != y->die_id) return x->die_id - y->die_id;
+    if (x->core_id != y->core_id) return x->core_id - y->core_id;
+    return x->first_cpu - y->first_cpu;
+}
+
+static int enabled_cores(system_info *sysinfo, int max_cores) {
+    int i, n = 0;
+
+    for (i = 0; i < max_cores; i++)
+        if (!core_disabled(sysinfo, i)) n++;
+
+    return n;
+}
+
+int cpu_topology_init(cpu_topology *topo, system_info *sysinfo, int max_cores) {
+    int i, j, cpu, first, count, num_phys, core, offline, by_id;
+    phys_core *phys;
+    char *seen;
+    struct dirent *de;
+    DIR *dir;
+
+    memset(topo, 0, sizeof(cpu_topology));
+    topo->stat_fd = -1;
+    topo->max_cores = max_cores;
+    topo->threads_per_core = 1;
+
+    dir = opendir(SYSFS_CPU_PATH);
+    if (!dir) return 0;
+    while ((de = readdir(dir))) {
+        if (sscanf(de->d_name, "cpu%d", &cpu) == 1 && cpu >= topo->num_cpus)
+            topo->num_cpus = cpu + 1;
+    }
+    closedir(dir);
+    if (!topo->num_cpus) return 0;
+
+    phys = calloc(topo->num_cpus, sizeof(phys_core));
+    topo->cpu_to_core = malloc(topo->num_cpus * sizeof(int));
+    if (!phys || !topo->cpu_to_core) {
+        free(phys);
+        cpu_topology_free(topo);
+        return 0;
+    }
+
+    //Collect physical cores. Offline CPUs don't have a topology directory.
+    num_phys = 0;
+    offline = 0;
+    for (cpu = 0; cpu < topo->num_cpus; cpu++) {
+        topo->cpu_to_core[cpu] = -1;
+        if (!read_thread_siblings(cpu, &first, &count)) {
+            offline = 1;
+            continue;
+        }
+        if (count > topo->threads_per_core) topo->threads_per_core = count;
+        if (first != cpu) continue; //Only count each physical core once
+
+        phys[num_phys].first_cpu = cpu;
+        if (!read_topology_int(cpu, "core_id", &phys[num_phys].core_id)) continue;
+        if (!read_topology_int(cpu, "die_id", &phys[num_phys].die_id)) phys[num_phys].die_id = 0;
+        if (!read_topology_int(cpu, "physical_package_id", &phys[num_phys].package_id)) phys[num_phys].package_id = 0;
+        num_phys++;
+    }
+    qsort(phys, num_phys, sizeof(phys_core), compare_phys_core);
+
+    topo->core_cpus = malloc(max_cores * topo->threads_per_core * sizeof(int));
+    if (!topo->core_cpus) {
+        free(phys);
+        cpu_topology_free(topo);
+        return 0;
+    }
+    for (i = 0; i < max_cores * topo->threads_per_core; i++) topo->core_cpus[i] = -1;
+
+    //core_id is the PM table core if all of them are distinct, in range and not fused off
+    seen = calloc(max_cores, 1);
+    by_id = seen != NULL;
+    for (j = 0; j < num_phys && by_id; j++) {
+        core = phys[j].core_id;
+        if (phys[j].package_id || core < 0 || core >= max_cores || seen[core] || core_disabled(sysinfo, core)) by_id = 0;
+        else seen[core] = 1;
+    }
+    free(seen);
+
+    if (by_id) {
+        for (j = 0; j < num_phys; j++) phys[j].pm_core = phys[j].core_id;
+    }
+    else if (offline && num_phys < enabled_cores(sysinfo, max_cores)) {
+        //A whole core is offline. Assigning in order would shift every core after it.
+        num_phys = 0;
+    }
+    else {
+        //Enabled PM table cores get the physical cores in order. Fused off cores are skipped,
+        //just like draw_screen does when numbering the cores.
+        for (i = 0, j = 0; i < max_cores && j < num_phys; i++) {
+            if (core_disabled(sysinfo, i)) continue;
+            phys[j++].pm_core = i;
+        }
+        num_phys = j;
+    }
+
+    for (cpu = 0; cpu < topo->num_cpus; cpu++) {
+        if (!read_thread_siblings(cpu, &first, &count)) continue;
+        for (j = 0; j < num_phys && phys[j].first_cpu != first; j++);
+        if (j == num_phys) continue;
+
+        core = phys[j].pm_core;
+        topo->cpu_to_core[cpu] = core;
+        for (i = 0; i < topo->threads_per_core; i++) {
+            if (cpu_topology_core_cpu(topo, core, i) < 0) {
+                cpu_topology_core_cpu(topo, core, i) = cpu;
+                break;
+            }
+        }
+    }
+    free(phys);
+
+    topo->busy_ticks = calloc(topo->num_cpus, sizeof(unsigned long long));
+    topo->total_ticks = calloc(topo->num_cpus, sizeof(unsigned long long));
+    topo->cpu_util = malloc(topo->num_cpus * sizeof(float));
+    topo->busy_delta = calloc(topo->num_cpus, sizeof(unsigned long long));
+    topo->stat_buf_size = 4096 + topo->num_cpus * 128;
+    topo->stat_buf = malloc(topo->stat_buf_size);
+    if (!topo->busy_ticks || !topo->total_ticks || !topo->cpu_util || !topo->busy_delta || !topo->stat_buf) {
+        cpu_topology_free(topo);
+        return 0;
+    }
+    for (cpu = 0; cpu < topo->num_cpus; cpu++) topo->cpu_util[cpu] = NAN;
+
+    topo->stat_fd = open(PROC_STAT_PATH, O_RDONLY);
+    if (topo->stat_fd >= 0) cpu_topology_sample(topo); //Sets the reference for the first interval
+
+    return 1;
+}
+
+void cpu_topology_free(cpu_topology *topo) {
+    if (topo->stat_fd >= 0) close(topo->stat_fd);
+    free(topo->cpu_to_core);
+    free(topo->core_cpus);
+    free(topo->busy_ticks);
+    free(topo->total_ticks);
+    free(topo->cpu_util);
+    free(topo->busy_delta);
+    free(topo->stat_buf);
+    memset(topo, 0, sizeof(cpu_topology));
+    topo->stat_fd = -1;
+}
+
+int cpu_topology_sample(cpu_topology *topo) {
+    unsigned long long v[8], busy, total;
+    char *p, *end;
+    ssize_t len;
+    int cpu, i;
+
+    if (topo->stat_fd < 0) return 0;
+
+    len = pread(topo->stat_fd, topo->stat_buf, topo->stat_buf_size - 1, 0);
+    if (len <= 0) return 0;
+    topo->stat_buf[len] = 0;
+
+    //Skip the summary line, per CPU lines follow directly
+    p = strchr(topo->stat_buf, '\n');
+    while (p && p[1] == 'c' && p[2] == 'p' && p[3] == 'u') {
+        p += 4;
+        cpu = strtol(p, &end, 10);
+        p = end;
+        //user nice system idle iowait irq softirq steal
+        for (i = 0; i < 8; i++) {
+            v[i] = strtoull(p, &end, 10);
+            p = end;
+        }
+        if (cpu >= 0 && cpu < topo->num_cpus) {
+            busy = v[0] + v[1] + v[2] + v[5] + v[6] + v[7];
+            total = busy + v[3] + v[4];
+            if (topo->total_ticks[cpu] && total > topo->total_ticks[cpu]) {
+                topo->busy_delta[cpu] = busy - topo->busy_ticks[cpu];
+                topo->cpu_util[cpu] = (float)topo->busy_delta[cpu] * 100.f
+                                    / (float)(total - topo->total_ticks[cpu]);
+            }
+            topo->busy_ticks[cpu] = busy;
+            topo->total_ticks[cpu] = total;
+        }
+        p = strchr(p, '\n');
+    }
+
+    return 1;
+}
@@ -0,0 +1,54 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef CPU_TOPOLOGY_H
+#define CPU_TOPOLOGY_H
+
+#include "readinfo.h"
+
+typedef struct {
+    int num_cpus;                   //Highest Linux CPU id + 1
+    int max_cores;                  //Number of PM table cores (incl. disabled ones)
+    int threads_per_core;           //Width of a row in core_cpus
+
+    int *cpu_to_core;               //Linux CPU -> PM table core index. -1 if offline or not mapped
+    int *core_cpus;                 //PM table core -> Linux CPUs, threads_per_core entries per core, -1 padded
+
+    //Per CPU utilization from /proc/stat
+    int stat_fd;
+    char *stat_buf;
+    unsigned int stat_buf_size;
+    unsigned long long *busy_ticks; //Previous sample
+    unsigned long long *total_ticks;
+    float *cpu_util;                //Busy time of the last interval in %. NAN if unknown
+    unsigned long long *busy_delta; //Busy ticks (USER_HZ) of the last interval
+} cpu_topology;
+
+//Builds the map from /sys/devices/system/cpu/cpu*/topology and the fuse based core_disable_map.
+//Returns 0 if the topology could not be read.
+int cpu_topology_init(cpu_topology *topo, system_info *sysinfo, int max_cores);
+void cpu_topology_free(cpu_topology *topo);
+
+//Updates cpu_util with the busy time since the previous call. Uses a single pread of /proc/stat.
+int cpu_topology_sample(cpu_topology *topo);
+
+//Linux CPU of the given hardware thread of a PM table core. -1 if there is none.
+#define cpu_topology_core_cpu(topo, core, thread) ((topo)->core_cpus[(core) * (topo)->threads_per_core + (thread)])
+
+#endif
@@ -0,0 +1,597 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/**
+ * Estimates how much energy each process and cgroup used.
+ *
+ * The energy of a core in an interval (CORE_POWER * dt) is split between the
+ * tasks that ran on the core, weighted with their CPU time. The uncore energy
+ * is split proportionally to the CPU time of each task on the whole package.
+ * What is left is reported as unattributed (idle cores, exited tasks).
+ *
+ * Scanning is incremental: /proc/<pid>/stat is read through a cached fd for
+ * every process, but the threads of a process are only read when the
+ * runtime of the process changed since the previous interval.
+ **/
+
+#include <time.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "energy_attribution.h"
+
+#define MAP_EMPTY -1
+
+/** Open addressing hash map: int key -> int value **/
+
+static unsigned int map_slot(attr_map *m, int key) {
+    return ((unsigned int)key * 2654435761u) & (m->cap - 1);
+}
+
+static int map_get(attr_map *m, int key) {
+    unsigned int i;
+
+    if (!m->cap) return MAP_EMPTY;
+    for (i = map_slot(m, key); m->keys[i] != MAP_EMPTY; i = (i + 1) & (m->cap - 1))
+        if (m->keys[i] == key) return m->vals[i];
+
+    return MAP_EMPTY;
+}
+
+static void map_clear(attr_map *m, unsigned int cap) {
+    free(m->keys);
+    free(m->vals);
+    m->cap = cap;
+    m->used = 0;
+    m->keys = malloc(cap * sizeof(int));
+    m->vals = malloc(cap * sizeof(int));
+    if (!m->keys || !m->vals) {
+        fprintf(stderr, "Could not allocate memory for the energy attribution.\n");
+        exit(0);
+    }
+    memset(m->keys, 0xff, cap * sizeof(int)); //MAP_EMPTY
+}
+
+static void map_put(attr_map *m, int key, int val) {
+    unsigned int i, old_cap;
+    int *old_keys, *old_vals;
+
+    if ((m->used + 1) * 2 > m->cap) {
+        old_keys = m->keys;
+        old_vals = m->vals;
+        old_cap = m->cap;
+        m->keys = m->vals = NULL;
+        map_clear(m, old_cap ? old_cap * 2 : 1024);
+        for (i = 0; i < old_cap; i++)
+            if (old_keys[i] != MAP_EMPTY) map_put(m, old_keys[i], old_vals[i]);
+        free(old_keys);
+        free(old_vals);
+    }
+
+    for (i = map_slot(m, key); m->keys[i] != MAP_EMPTY; i = (i + 1) & (m->cap - 1)) {
+        if (m->keys[i] == key) {
+            m->vals[i] = val;
+            return;
+        }
+    }
+    m->keys[i] = key;
+    m->vals[i] = val;
+    m->used++;
+}
+
+static void* grow(void *arr, unsigned int *cap, unsigned int needed, size_t size) {
+    if (needed <= *cap) return arr;
+
+    *cap = *cap ? *cap * 2 : 256;
+    if (*cap < needed) *cap = needed;
+    arr = realloc(arr, *cap * size);
+    if (!arr) {
+        fprintf(stderr, "Could not allocate memory for the energy attribution.\n");
+        exit(0);
+    }
+
+    return arr;
+}
+
+/** procfs parsing **/
+
+typedef struct {
+    char comm[ATTR_COMM_LEN];
+    unsigned long long runtime, starttime;
+    int num_threads, cpu;
+} task_stat;
+
+static int parse_stat(char *buf, task_stat *ts) {
+    char *p, *end;
+    int field;
+
+    //comm may contain spaces and parentheses. It ends at the last ')'.
+    p = strchr(buf, '(');
+    end = strrchr(buf, ')');
+    if (!p || !end) return 0;
+    snprintf(ts->comm, sizeof(ts->comm), "%.*s", (int)(end - p - 1), p + 1);
+
+    ts->runtime = 0;
+    p = end + 2; //Field 3: state
+    for (field = 3; *p && field <= 39; field++) {
+        switch (field) {
+            case 14: //utime
+            case 15: //stime
+                ts->runtime += strtoull(p, NULL, 10);
+                break;
+            case 20: ts->num_threads = atoi(p); break;
+            case 22: ts->starttime = strtoull(p, NULL, 10); break;
+            case 39: ts->cpu = atoi(p); return 1;
+        }
+        p = strchr(p, ' ');
+        if (!p) break;
+        p++;
+    }
+
+    return 0;
+}
+
+static int read_stat_fd(int fd, task_stat *ts) {
+    char buf[1024];
+    ssize_t len;
+
+    len = pread(fd, buf, sizeof(buf) - 1, 0);
+    if (len <= 0) return 0;
+    buf[len] = 0;
+
+    return parse_stat(buf, ts);
+}
+
+static int read_stat_path(const char *path, task_stat *ts) {
+    int fd, ret;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+    ret = read_stat_fd(fd, ts);
+    close(fd);
+
+    return ret;
+}
+
+static unsigned int hash_str(const char *s) {
+    unsigned int h = 2166136261u;
+
+    while (*s) h = (h ^ (unsigned char)*s++) * 16777619u;
+
+    return h & 0x7fffffff; //Keys must not collide with MAP_EMPTY
+}
+
+static int lookup_cgroup(energy_attribution *ea, int pid) {
+    char path[64], line[4096], *cg = NULL, *nl;
+    unsigned int h, i;
+    FILE *fp;
+    int idx;
+
+    snprintf(path, sizeof(path), "/proc/%d/cgroup", pid);
+    fp = fopen(path, "r");
+    if (fp) {
+        //cgroup v2 has a single "0::/path" line. On v1 hosts, the first hierarchy is used.
+        while (fgets(line, sizeof(line), fp)) {
+            cg = strchr(line, ':');
+            if (cg) cg = strchr(cg + 1, ':');
+            if (cg) cg++;
+            if (!strncmp(line, "0::", 3)) break;
+        }
+        fclose(fp);
+    }
+    if (!cg) cg = "/";
+    nl = strchr(cg, '\n');
+    if (nl) *nl = 0;
+
+    h = hash_str(cg);
+    idx = map_get(&ea->cgroup_map, h);
+    if (idx != MAP_EMPTY && !strcmp(ea->cgroups[idx].path, cg)) return idx;
+    if (idx != MAP_EMPTY) {
+        //Hash collision. Rare enough to fall back to a linear search.
+        for (i = 0; i < ea->num_cgroups; i++)
+            if (!strcmp(ea->cgroups[i].path, cg)) return i;
+    }
+
+    ea->cgroups = grow(ea->cgroups, &ea->cap_cgroups, ea->num_cgroups + 1, sizeof(attr_cgroup));
+    idx = ea->num_cgroups++;
+    memset(&ea->cgroups[idx], 0, sizeof(attr_cgroup));
+    ea->cgroups[idx].path = strdup(cg);
+    ea->cgroups[idx].hash = h;
+    if (map_get(&ea->cgroup_map, h) == MAP_EMPTY) map_put(&ea->cgroup_map, h, idx);
+
+    return idx;
+}
+
+static void add_contribution(energy_attribution *ea, int proc, int core, unsigned long long ticks) {
+    attr_contribution *c;
+
+    ea->contrib = grow(ea->contrib, &ea->cap_contrib, ea->num_contrib + 1, sizeof(attr_contribution));
+    c = &ea->contrib[ea->num_contrib++];
+    c->proc = proc;
+    c->core = core;
+    c->ticks = ticks;
+    ea->core_ticks[core] += ticks;
+    ea->processes[proc].ticks += ticks;
+}
+
+//Reads the threads of a process whose runtime changed and collects their CPU time per core.
+static void scan_threads(energy_attribution *ea, int proc, cpu_topology *topo) {
+    char path[64];
+    attr_process *p = &ea->processes[proc];
+    attr_thread *t;
+    struct dirent *de;
+    task_stat ts;
+    int tid, idx;
+    DIR *dir;
+
+    snprintf(path, sizeof(path), "/proc/%d/task", p->pid);
+    dir = opendir(path);
+    if (!dir) return;
+    p->threads_seen = ea->generation;
+
+    while ((de = readdir(dir))) {
+        tid = atoi(de->d_name);
+        if (tid <= 0) continue;
+
+        snprintf(path, sizeof(path), "/proc/%d/task/%d/stat", p->pid, tid);
+        if (!read_stat_path(path, &ts)) continue;
+
+        idx = map_get(&ea->thread_map, tid);
+        if (idx == MAP_EMPTY || ea->threads[idx].proc != proc || ea->threads[idx].starttime != ts.starttime) {
+            //First time we see this thread: its runtime is the reference for the next interval.
+            //A reused TID is a new thread, the old entry is dropped by purge_threads.
+            ea->threads = grow(ea->threads, &ea->cap_threads, ea->num_threads + 1, sizeof(attr_thread));
+            idx = ea->num_threads++;
+            ea->threads[idx].tid = tid;
+            ea->threads[idx].proc = proc;
+            ea->threads[idx].starttime = ts.starttime;
+            ea->threads[idx].runtime = ts.runtime;
+            ea->threads[idx].seen = ea->generation;
+            map_put(&ea->thread_map, tid, idx);
+            continue;
+        }
+
+        t = &ea->threads[idx];
+        t->seen = ea->generation;
+        if (ts.runtime > t->runtime && ts.cpu >= 0 && ts.cpu < topo->num_cpus && topo->cpu_to_core[ts.cpu] >= 0)
+            add_contribution(ea, proc, topo->cpu_to_core[ts.cpu], ts.runtime - t->runtime);
+        t->runtime = ts.runtime;
+    }
+    closedir(dir);
+}
+
+//Drops threads of exited processes and the exited threads of processes whose threads were scanned
+//in this interval. Threads of the other processes were not looked at and stay. Rebuilds the thread
+//map if anything was dropped.
+static void purge_threads(energy_attribution *ea) {
+    attr_process *p;
+    attr_thread *t;
+    unsigned int i, n;
+
+    for (i = 0, n = 0; i < ea->num_threads; i++) {
+        t = &ea->threads[i];
+        if (t->proc < 0) continue;
+        p = &ea->processes[t->proc];
+        if (!p->alive || (p->threads_seen == ea->generation && t->seen != ea->generation)) continue;
+        ea->threads[n++] = *t;
+    }
+    if (n == ea->num_threads) return;
+    ea->num_threads = n;
+
+    map_clear(&ea->thread_map, ea->thread_map.cap);
+    for (i = 0; i < n; i++) map_put(&ea->thread_map, ea->threads[i].tid, i);
+}
+
+//Drops exited processes once they make up half of the table. Their energy stays in their cgroup.
+static void compact_processes(energy_attribution *ea) {
+    unsigned int i, n, dead;
+    int *remap;
+
+    for (i = 0, dead = 0; i < ea->num_processes; i++)
+        if (!ea->processes[i].alive) dead++;
+    if (dead * 2 < ea->num_processes) return;
+
+    remap = malloc(ea->num_processes * sizeof(int));
+    if (!remap) return;
+
+    map_clear(&ea->process_map, ea->process_map.cap);
+    for (i = 0, n = 0; i < ea->num_processes; i++) {
+        remap[i] = -1;
+        if (!ea->processes[i].alive) continue;
+        remap[i] = n;
+        ea->processes[n] = ea->processes[i];
+        map_put(&ea->process_map, ea->processes[n].pid, n);
+        n++;
+    }
+    ea->num_processes = n;
+
+    for (i = 0; i < ea->num_threads; i++)
+        ea->threads[i].proc = remap[ea->threads[i].proc];
+    //Contributions of this interval only come from running processes
+    for (i = 0; i < ea->num_contrib; i++)
+        ea->contrib[i].proc = remap[ea->contrib[i].proc];
+    free(remap);
+}
+
+static void scan_processes(energy_attribution *ea, cpu_topology *topo) {
+    char path[64];
+    attr_process *p;
+    struct dirent *de;
+    task_stat ts;
+    int pid, idx, ok;
+    unsigned int i, exited;
+    DIR *dir;
+
+    ea->generation++;
+    ea->scanned = ea->changed = 0;
+
+    dir = opendir("/proc");
+    if (!dir) return;
+
+    while ((de = readdir(dir))) {
+        if (de->d_name[0] < '1' || de->d_name[0] > '9') continue;
+        pid = atoi(de->d_name);
+
+        idx = map_get(&ea->process_map, pid);
+        if (idx != MAP_EMPTY && ea->processes[idx].alive) {
+            p = &ea->processes[idx];
+            if (p->fd >= 0) ok = read_stat_fd(p->fd, &ts);
+            else {
+                snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+                ok = read_stat_path(path, &ts);
+            }
+            ea->scanned++;
+            if (ok && ts.starttime == p->starttime) {
+                p->seen = ea->generation;
+                if (ts.runtime != p->runtime) {
+                    ea->changed++;
+                    if (ts.num_threads <= 1 && ts.cpu >= 0 && ts.cpu < topo->num_cpus && topo->cpu_to_core[ts.cpu] >= 0)
+                        add_contribution(ea, idx, topo->cpu_to_core[ts.cpu], ts.runtime - p->runtime);
+                    else
+                        scan_threads(ea, idx, topo);
+                    p->runtime = ts.runtime;
+                    p->num_threads = ts.num_threads;
+                }
+                continue;
+            }
+            //The process is gone or the PID was reused. Start over with a new entry.
+            if (p->fd >= 0) close(p->fd);
+            p->fd = -1;
+            p->alive = 0;
+        }
+
+        ea->processes = grow(ea->processes, &ea->cap_processes, ea->num_processes + 1, sizeof(attr_process));
+        idx = ea->num_processes;
+        p = &ea->processes[idx];
+        memset(p, 0, sizeof(attr_process));
+
+        snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+        p->fd = open(path, O_RDONLY);
+        //Out of file descriptors: still works, but with an open() per read
+        if (p->fd < 0 && errno != EMFILE && errno != ENFILE) continue;
+        if (!(p->fd >= 0 ? read_stat_fd(p->fd, &ts) : read_stat_path(path, &ts))) {
+            if (p->fd >= 0) close(p->fd);
+            continue;
+        }
+
+        p->pid = pid;
+        p->starttime = ts.starttime;
+        p->runtime = ts.runtime;
+        p->num_threads = ts.num_threads;
+        p->seen = ea->generation;
+        p->alive = 1;
+        memcpy(p->comm, ts.comm, sizeof(p->comm));
+        p->cgroup = lookup_cgroup(ea, pid);
+        ea->num_processes++;
+        map_put(&ea->process_map, pid, idx);
+        //Multi-threaded processes need a reference runtime for each thread
+        if (ts.num_threads > 1) scan_threads(ea, idx, topo);
+    }
+    closedir(dir);
+
+    exited = 0;
+    for (i = 0; i < ea->num_processes; i++) {
+        p = &ea->processes[i];
+        if (!p->alive || p->seen == ea->generation) continue;
+        if (p->fd >= 0) close(p->fd);
+        p->fd = -1;
+        p->alive = 0;
+        exited++;
+    }
+    purge_threads(ea);
+    if (exited) compact_processes(ea);
+}
+
+int energy_attribution_init(energy_attribution *ea, int max_cores) {
+    struct timespec now;
+    struct rlimit rl;
+
+    memset(ea, 0, sizeof(energy_attribution));
+
+    //One cached fd per process. Use whatever the hard limit allows.
+    if (!getrlimit(RLIMIT_NOFILE, &rl) && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    ea->core_ticks = calloc(max_cores, sizeof(double));
+    if (!ea->core_ticks) return 0;
+    map_clear(&ea->process_map, 1024);
+    map_clear(&ea->thread_map, 1024);
+    map_clear(&ea->cgroup_map, 1024);
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    ea->last_update = now.tv_sec + now.tv_nsec * 1e-9;
+
+    return 1;
+}
+
+void energy_attribution_free(energy_attribution *ea) {
+    unsigned int i;
+
+    for (i = 0; i < ea->num_processes; i++)
+        if (ea->processes[i].fd >= 0) close(ea->processes[i].fd);
+    for (i = 0; i < ea->num_cgroups; i++)
+        free(ea->cgroups[i].path);
+    free(ea->processes);
+    free(ea->threads);
+    free(ea->cgroups);
+    free(ea->contrib);
+    free(ea->core_ticks);
+    free(ea->process_map.keys);
+    free(ea->process_map.vals);
+    free(ea->thread_map.keys);
+    free(ea->thread_map.vals);
+    free(ea->cgroup_map.keys);
+    free(ea->cgroup_map.vals);
+    memset(ea, 0, sizeof(energy_attribution));
+}
+
+void energy_attribution_update(energy_attribution *ea, pm_frame *frame, system_info *sysinfo, cpu_topology *topo) {
+    double dt, now_s, e, core_energy, uncore_energy, busy, total_busy, total_ticks, attributed;
+    struct timespec now;
+    attr_contribution *c;
+    attr_process *p;
+    unsigned int i;
+    int core, t, cpu;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    now_s = now.tv_sec + now.tv_nsec * 1e-9;
+    dt = now_s - ea->last_update;
+    ea->last_update = now_s;
+
+    for (i = 0; i < ea->num_processes; i++) ea->processes[i].ticks = 0;
+    for (core = 0; core < frame->num_cores; core++) ea->core_ticks[core] = 0;
+    ea->num_contrib = 0;
+
+    scan_processes(ea, topo);
+
+    for (i = 0; i < ea->num_processes; i++) ea->processes[i].power = 0;
+    for (i = 0; i < ea->num_cgroups; i++) ea->cgroups[i].power = 0;
+
+    //Core energy, split by CPU time on each core. The busy time from /proc/stat is the
+    //denominator, so the share of idle time and untracked tasks stays unattributed.
+    attributed = 0;
+    core_energy = 0;
+    total_busy = 0;
+    total_ticks = 0;
+    for (core = 0; core < frame->num_cores; core++) {
+        if (core_disabled(sysinfo, core)) continue;
+        core_energy += pmf_nan0(frame->core_power[core]) * dt;
+        for (t = 0; t < topo->threads_per_core; t++) {
+            cpu = cpu_topology_core_cpu(topo, core, t);
+            if (cpu >= 0) total_busy += topo->busy_delta[cpu];
+        }
+        total_ticks += ea->core_ticks[core];
+    }
+    for (i = 0; i < ea->num_contrib; i++) {
+        c = &ea->contrib[i];
+        busy = 0;
+        for (t = 0; t < topo->threads_per_core; t++) {
+            cpu = cpu_topology_core_cpu(topo, c->core, t);
+            if (cpu >= 0) busy += topo->busy_delta[cpu];
+        }
+        //Task and /proc/stat ticks are not sampled at the same instant
+        if (busy < ea->core_ticks[c->core]) busy = ea->core_ticks[c->core];
+
+        e = pmf_nan0(frame->core_power[c->core]) * dt * c->ticks / busy;
+        p = &ea->processes[c->proc];
+        p->core_energy += e;
+        p->power += e / dt;
+        ea->cgroups[p->cgroup].core_energy += e;
+        ea->cgroups[p->cgroup].power += e / dt;
+        attributed += e;
+    }
+
+    //Uncore energy, split by CPU time on the whole package
+    uncore_energy = pmf0(VDDCR_SOC_POWER) + pmf0(GMI2_VDDG_POWER) + pmf0(VDDIO_MEM_POWER)
+                  + pmf0(IOD_VDDIO_MEM_POWER) + pmf0(DDR_VDDP_POWER) + pmf0(VDD18_POWER);
+    for (i = 0; i < (unsigned int)frame->num_l3; i++)
+        uncore_energy += pmf_nan0(frame->l3_logic_power[i]) + pmf_nan0(frame->l3_vddm_power[i]);
+    uncore_energy *= dt;
+
+    if (total_busy < total_ticks) total_busy = total_ticks;
+    if (total_busy > 0) {
+        for (i = 0; i < ea->num_processes; i++) {
+            p = &ea->processes[i];
+            if (!p->ticks) continue;
+            e = uncore_energy * p->ticks / total_busy;
+            p->uncore_energy += e;
+            p->power += e / dt;
+            ea->cgroups[p->cgroup].uncore_energy += e;
+            ea->cgroups[p->cgroup].power += e / dt;
+            attributed += e;
+        }
+    }
+
+    ea->total_energy += core_energy + uncore_energy;
+    ea->unattributed_energy += core_energy + uncore_energy - attributed;
+}
+
+int energy_attribution_top_processes(energy_attribution *ea, int *idx, int n) {
+    double e, best;
+    unsigned int i;
+    int k, j, b;
+
+    for (k = 0; k < n; k++) {
+        b = -1;
+        best = 0;
+        for (i = 0; i < ea->num_processes; i++) {
+            e = ea->processes[i].core_energy + ea->processes[i].uncore_energy;
+            if (e <= best) continue;
+            for (j = 0; j < k && idx[j] != (int)i; j++);
+            if (j < k) continue;
+            best = e;
+            b = i;
+        }
+        if (b < 0) break;
+        idx[k] = b;
+    }
+
+    return k;
+}
+
+int energy_attribution_top_cgroups(energy_attribution *ea, int *idx, int n) {
+    double e, best;
+    unsigned int i;
+    int k, j, b;
+
+    for (k = 0; k < n; k++) {
+        b = -1;
+        best = 0;
+        for (i = 0; i < ea->num_cgroups; i++) {
+            e = ea->cgroups[i].core_energy + ea->cgroups[i].uncore_energy;
+            if (e <= best) continue;
+            for (j = 0; j < k && idx[j] != (int)i; j++);
+            if (j < k) continue;
+            best = e;
+            b = i;
+        }
+        if (b < 0) break;
+        idx[k] = b;
+    }
+
+    return k;
+}
@@ -0,0 +1,111 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef ENERGY_ATTRIBUTION_H
+#define ENERGY_ATTRIBUTION_H
+
+#include "pm_frame.h"
+#include "readinfo.h"
+#include "cpu_topology.h"
+
+#define ATTR_COMM_LEN 16
+
+typedef struct {
+    int pid;
+    int fd;                         //Cached /proc/<pid>/stat. -1 if not cached
+    unsigned long long starttime;   //Detects reuse of the PID
+    unsigned long long runtime;     //utime + stime of all threads in ticks
+    int num_threads;
+    unsigned int seen;              //Scan generation
+    unsigned int threads_seen;      //Generation of the last scan of its threads
+    int alive;
+    int cgroup;                     //Index into cgroups
+    char comm[ATTR_COMM_LEN];
+    unsigned long long ticks;       //CPU time of the last interval
+    double core_energy;             //Joule since start
+    double uncore_energy;
+    double power;                   //Watt in the last interval
+} attr_process;
+
+typedef struct {
+    int tid;
+    int proc;                       //Index into processes
+    unsigned long long starttime;   //Detects reuse of the TID
+    unsigned long long runtime;
+    unsigned int seen;              //Generation of the last scan of the process' threads it was in
+} attr_thread;
+
+typedef struct {
+    char *path;
+    unsigned int hash;
+    double core_energy;
+    double uncore_energy;
+    double power;
+} attr_cgroup;
+
+typedef struct {
+    int *keys;
+    int *vals;
+    unsigned int cap;
+    unsigned int used;
+} attr_map;
+
+typedef struct {
+    int proc;
+    int core;
+    unsigned long long ticks;
+} attr_contribution;
+
+typedef struct {
+    attr_process *processes;
+    unsigned int num_processes, cap_processes;
+    attr_thread *threads;
+    unsigned int num_threads, cap_threads;
+    attr_cgroup *cgroups;
+    unsigned int num_cgroups, cap_cgroups;
+    attr_map process_map, thread_map, cgroup_map;
+
+    attr_contribution *contrib;     //CPU time per process and core of the current interval
+    unsigned int num_contrib, cap_contrib;
+    double *core_ticks;             //Sum of the contributions per core
+
+    unsigned int generation;
+    double last_update;
+
+    //Totals since start
+    double unattributed_energy;     //Idle cores and CPU time that could not be assigned to a task
+    double total_energy;
+    //Statistics of the last scan
+    unsigned int scanned;           //Processes read
+    unsigned int changed;           //Processes whose runtime changed
+} energy_attribution;
+
+int energy_attribution_init(energy_attribution *ea, int max_cores);
+void energy_attribution_free(energy_attribution *ea);
+
+//Call once per sample after pm_frame_extract and cpu_topology_sample.
+//Apportions the core energy of the last interval to the tasks that ran on each core
+//and splits the uncore energy (SoC, L3, memory) proportionally to their CPU time.
+void energy_attribution_update(energy_attribution *ea, pm_frame *frame, system_info *sysinfo, cpu_topology *topo);
+
+//Fills idx with the indices of the n processes / cgroups with the highest energy. Returns the count.
+int energy_attribution_top_processes(energy_attribution *ea, int *idx, int n);
+int energy_attribution_top_cgroups(energy_attribution *ea, int *idx, int n);
+
+#endif
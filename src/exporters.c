@@ -0,0 +1,151 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <math.h>
+#include <ctype.h>
+#include <string.h>
+
+#include "exporters.h"
+
+export_format export_parse_format(const char *name) {
+    if (!strcmp(name, "json")) return EXPORT_JSON;
+    if (!strcmp(name, "prometheus")) return EXPORT_PROMETHEUS;
+    return EXPORT_NONE;
+}
+
+//Number of refs starting at i that belong to the same field
+static unsigned int field_run(const pm_selection *sel, unsigned int i) {
+    unsigned int j;
+
+    for (j = i + 1; j < sel->num_refs && sel->refs[j].field == sel->refs[i].field; j++);
+
+    return j - i;
+}
+
+static void json_value(FILE *out, float v) {
+    if (isfinite(v)) fprintf(out, "%g", v);
+    else fprintf(out, "null");
+}
+
+static void export_json(FILE *out, const pm_selection *sel, const pm_table *pmt, double timestamp,
+    const self_overhead *ovh) {
+    const pm_selection_ref *r;
+    unsigned int i, j, n;
+
+    fprintf(out, "{\"time\":%.3f,\"version\":\"0x%06x\"", timestamp, pmt->version);
+    for (i = 0; i < sel->num_refs; i += n) {
+        r = &sel->refs[i];
+        n = field_run(sel, i);
+
+        if (pm_fields[r->field].kind == PMT_FIELD_SCALAR) {
+            fprintf(out, ",\"%s\":", pm_fields[r->field].name);
+            json_value(out, sel->values[i]);
+        }
+        else if ((int)n == pm_field_length(pmt, r->field)) {
+            //Complete array
+            fprintf(out, ",\"%s\":[", pm_fields[r->field].name);
+            for (j = 0; j < n; j++) {
+                if (j) fputc(',', out);
+                json_value(out, sel->values[i + j]);
+            }
+            fputc(']', out);
+        }
+        else {
+            for (j = 0; j < n; j++) {
+                fprintf(out, ",\"%s[%d]\":", pm_fields[r->field].name, r[j].element);
+                json_value(out, sel->values[i + j]);
+            }
+        }
+    }
+    if (ovh) {
+        fprintf(out, ",\"monitor\":{\"cpu_percent\":%g,\"wakeups_per_s\":%g,\"bytes_per_s\":%g",
+            ovh->cpu_percent, ovh->wakeups_per_s, ovh->bytes_per_s);
+        for (i = 0; i < OVH_NUM_STAGES; i++)
+            fprintf(out, ",\"%s_us\":%g", self_overhead_stage_names[i], ovh->stage_s[i] * 1e6);
+        fputc('}', out);
+    }
+    fprintf(out, "}\n");
+}
+
+static void prometheus_value(FILE *out, float v) {
+    if (isnan(v)) fprintf(out, "NaN");
+    else if (isinf(v)) fprintf(out, v > 0 ? "+Inf" : "-Inf");
+    else fprintf(out, "%g", v);
+}
+
+static void prometheus_overhead(FILE *out, const self_overhead *ovh, long long ms) {
+    int i;
+
+    fprintf(out, "# HELP ryzen_monitor_cpu_percent CPU time of the monitor (%% of one CPU)\n");
+    fprintf(out, "# TYPE ryzen_monitor_cpu_percent gauge\n");
+    fprintf(out, "ryzen_monitor_cpu_percent %g %lld\n", ovh->cpu_percent, ms);
+    fprintf(out, "# HELP ryzen_monitor_wakeups_per_second Voluntary context switches of the monitor\n");
+    fprintf(out, "# TYPE ryzen_monitor_wakeups_per_second gauge\n");
+    fprintf(out, "ryzen_monitor_wakeups_per_second %g %lld\n", ovh->wakeups_per_s, ms);
+    fprintf(out, "# HELP ryzen_monitor_bytes_per_second Output and recording written by the monitor\n");
+    fprintf(out, "# TYPE ryzen_monitor_bytes_per_second gauge\n");
+    fprintf(out, "ryzen_monitor_bytes_per_second %g %lld\n", ovh->bytes_per_s, ms);
+    fprintf(out, "# HELP ryzen_monitor_stage_seconds Time of each stage of the previous sample\n");
+    fprintf(out, "# TYPE ryzen_monitor_stage_seconds gauge\n");
+    for (i = 0; i < OVH_NUM_STAGES; i++)
+        fprintf(out, "ryzen_monitor_stage_seconds{stage=\"%s\"} %g %lld\n", self_overhead_stage_names[i],
+            ovh->stage_s[i], ms);
+}
+
+static void export_prometheus(FILE *out, const pm_selection *sel, double timestamp, const self_overhead *ovh) {
+    const pm_selection_ref *r;
+    const pm_field *f;
+    char metric[64];
+    unsigned int i, j, n, k;
+    long long ms;
+
+    ms = (long long)(timestamp * 1000);
+    for (i = 0; i < sel->num_refs; i += n) {
+        r = &sel->refs[i];
+        f = &pm_fields[r->field];
+        n = field_run(sel, i);
+
+        k = snprintf(metric, sizeof(metric), "ryzen_pm_");
+        for (j = 0; f->name[j] && k < sizeof(metric) - 1; j++) metric[k++] = tolower((unsigned char)f->name[j]);
+        metric[k] = 0;
+
+        fprintf(out, "# HELP %s %s%s%s%s\n", metric, f->name, *f->unit ? " (" : "", f->unit, *f->unit ? ")" : "");
+        fprintf(out, "# TYPE %s gauge\n", metric);
+        for (j = 0; j < n; j++) {
+            if (f->kind == PMT_FIELD_SCALAR)
+                fprintf(out, "%s{category=\"%s\"} ", metric, pm_field_category_names[f->category]);
+            else
+                fprintf(out, "%s{category=\"%s\",index=\"%d\"} ", metric,
+                    pm_field_category_names[f->category], r[j].element);
+            prometheus_value(out, sel->values[i + j]);
+            fprintf(out, " %lld\n", ms);
+        }
+    }
+    if (ovh) prometheus_overhead(out, ovh, ms);
+    fprintf(out, "# EOF\n");
+}
+
+void export_sample(FILE *out, export_format format, const pm_selection *sel, const pm_table *pmt, double timestamp,
+    const self_overhead *ovh) {
+    switch (format) {
+        case EXPORT_JSON:       export_json(out, sel, pmt, timestamp, ovh); break;
+        case EXPORT_PROMETHEUS: export_prometheus(out, sel, timestamp, ovh); break;
+        default:                break;
+    }
+}
@@ -0,0 +1,42 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef EXPORTERS_H
+#define EXPORTERS_H
+
+#include <stdio.h>
+
+#include "pm_selection.h"
+#include "self_overhead.h"
+
+typedef enum {
+    EXPORT_NONE,
+    EXPORT_JSON,        //One JSON object per sample and line
+    EXPORT_PROMETHEUS   //Prometheus text format, each sample terminated by "# EOF"
+} export_format;
+
+//Parses "json" or "prometheus". Returns EXPORT_NONE for anything else.
+export_format export_parse_format(const char *name);
+
+//Writes the values of the last pm_selection_decode(...). timestamp is in seconds since the epoch.
+//The monitor's own overhead of the previous sample is added if ovh is not NULL.
+void export_sample(FILE *out, export_format format, const pm_selection *sel, const pm_table *pmt, double timestamp,
+    const self_overhead *ovh);
+
+#endif
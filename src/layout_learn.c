@@ -0,0 +1,706 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/**
+ * Learning the layout of unknown PM table versions.
+ *
+ * The table is sampled for a while into a matrix with one row per sample.
+ * Every 4 byte slot is classified as zero, static or dynamic and gets the
+ * value ranges it could belong to (temperature, voltage, ...). The rows are
+ * processed one at a time across all slots, so the loops run contiguously
+ * with AVX2 or SSE2, depending on what the compiler targets.
+ *
+ * The slots are then aligned with every known layout. Versions of a family
+ * mostly differ by inserted fields, which shifts everything behind them. So
+ * each field gets the shift in -LEARN_MAX_SHIFT..LEARN_MAX_SHIFT under which
+ * it and its neighbours fit the slots best. Arrays are shifted as a whole,
+ * which keeps the per core stride intact. The version with the best overall
+ * fit is used for the proposal.
+ **/
+
+#include <math.h>
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "layout_learn.h"
+#include "pm_tables.h"
+#include "pm_selection.h"
+#include "timing.h"
+
+#define LEARN_LANES      8      //Rows are padded to this many floats
+#define LEARN_MAX_VALUE  1e6f   //Anything larger is not a sensor value
+#define LEARN_MAX_SHIFT  64     //Slots a field may move relative to the known layout
+#define LEARN_SHIFTS     (2 * LEARN_MAX_SHIFT + 1)
+#define LEARN_SHIFT_COST 3.0f   //Penalty for changing the shift between two elements
+#define LEARN_LOW_FIT    0.5f   //Fields below this fit are marked in the proposal
+#define LEARN_MIN_CORR   0.9f   //Correlation of a total with the sum of its parts
+
+//One element of a known layout
+typedef struct {
+    unsigned short field;
+    unsigned short element;
+    int index;                  //Float index in the known layout
+    unsigned short plausible;   //LEARN_RANGE_* expected from the unit
+    unsigned short typical;     //LEARN_TYPICAL_* expected from the unit
+    unsigned char limit;        //Name suggests a static limit
+    unsigned char changing;     //Name or unit suggests a dynamic value
+} learn_element;
+
+typedef struct {
+    unsigned int version;
+    pm_table meta;              //Header fields of the known layout
+    learn_element *elements;
+    int num_elements;
+    int *shift;                 //Per element
+    float *fit;                 //Per element, score at the chosen shift
+    float score;
+} learn_match;
+
+static float probe[16384];
+
+int layout_learn_init(layout_learner *l, unsigned int table_size, unsigned int max_samples) {
+    size_t row;
+
+    memset(l, 0, sizeof(layout_learner));
+    l->num_slots = table_size / sizeof(float);
+    l->stride = (l->num_slots + LEARN_LANES - 1) / LEARN_LANES * LEARN_LANES;
+    l->max_samples = max_samples;
+    row = l->stride * sizeof(float);
+
+    l->data = aligned_alloc(32, row * max_samples);
+    l->invalid = calloc(l->stride, sizeof(unsigned char));
+    l->cls = calloc(l->stride, sizeof(unsigned char));
+    l->ranges = calloc(l->stride, sizeof(unsigned short));
+    l->min = aligned_alloc(32, row);
+    l->max = aligned_alloc(32, row);
+    l->mean = aligned_alloc(32, row);
+    l->stddev = aligned_alloc(32, row);
+    if (!l->data || !l->invalid || !l->cls || !l->ranges || !l->min || !l->max || !l->mean || !l->stddev) {
+        layout_learn_free(l);
+        return 0;
+    }
+
+    return 1;
+}
+
+void layout_learn_free(layout_learner *l) {
+    free(l->data);
+    free(l->invalid);
+    free(l->cls);
+    free(l->ranges);
+    free(l->min);
+    free(l->max);
+    free(l->mean);
+    free(l->stddev);
+    memset(l, 0, sizeof(layout_learner));
+}
+
+void layout_learn_add(layout_learner *l, const unsigned char *pm_buf) {
+    float *row;
+    unsigned int j;
+
+    if (l->num_samples >= l->max_samples) return;
+
+    row = l->data + (size_t)l->num_samples * l->stride;
+    memcpy(row, pm_buf, l->num_slots * sizeof(float));
+    for (j = l->num_slots; j < l->stride; j++) row[j] = 0;
+
+    //Integers and other non-float data would poison the sums. Mark the slot and continue with 0.
+    for (j = 0; j < l->num_slots; j++) {
+        if (!isfinite(row[j]) || fabsf(row[j]) > LEARN_MAX_VALUE || fpclassify(row[j]) == FP_SUBNORMAL) {
+            l->invalid[j] = 1;
+            row[j] = 0;
+        }
+    }
+    l->num_samples++;
+}
+
+#if defined(__AVX2__)
+#define LEARN_VEC 8
+typedef __m256 learn_vec;
+#define vec_load(p)     _mm256_load_ps(p)
+#define vec_store(p, x) _mm256_store_ps(p, x)
+#define vec_set1(x)     _mm256_set1_ps(x)
+#define vec_add(a, b)   _mm256_add_ps(a, b)
+#define vec_sub(a, b)   _mm256_sub_ps(a, b)
+#define vec_mul(a, b)   _mm256_mul_ps(a, b)
+#define vec_min(a, b)   _mm256_min_ps(a, b)
+#define vec_max(a, b)   _mm256_max_ps(a, b)
+#elif defined(__SSE2__)
+#define LEARN_VEC 4
+typedef __m128 learn_vec;
+#define vec_load(p)     _mm_load_ps(p)
+#define vec_store(p, x) _mm_store_ps(p, x)
+#define vec_set1(x)     _mm_set1_ps(x)
+#define vec_add(a, b)   _mm_add_ps(a, b)
+#define vec_sub(a, b)   _mm_sub_ps(a, b)
+#define vec_mul(a, b)   _mm_mul_ps(a, b)
+#define vec_min(a, b)   _mm_min_ps(a, b)
+#define vec_max(a, b)   _mm_max_ps(a, b)
+#endif
+
+//The kernels process one sample row and return the number of slots done. The rest is left
+//to the scalar loops of the callers.
+#ifdef LEARN_VEC
+static unsigned int minmax_sum_kernel(const float *row, float *min, float *max, float *sum, unsigned int n) {
+    learn_vec x;
+    unsigned int j;
+
+    for (j = 0; j + LEARN_VEC <= n; j += LEARN_VEC) {
+        x = vec_load(row + j);
+        vec_store(min + j, vec_min(vec_load(min + j), x));
+        vec_store(max + j, vec_max(vec_load(max + j), x));
+        vec_store(sum + j, vec_add(vec_load(sum + j), x));
+    }
+
+    return j;
+}
+
+static unsigned int variance_kernel(const float *row, const float *mean, float *sq, unsigned int n) {
+    learn_vec d;
+    unsigned int j;
+
+    for (j = 0; j + LEARN_VEC <= n; j += LEARN_VEC) {
+        d = vec_sub(vec_load(row + j), vec_load(mean + j));
+        vec_store(sq + j, vec_add(vec_load(sq + j), vec_mul(d, d)));
+    }
+
+    return j;
+}
+
+static unsigned int covariance_kernel(const float *row, const float *mean, float *acc, float w, unsigned int n) {
+    learn_vec d, vw;
+    unsigned int j;
+
+    vw = vec_set1(w);
+    for (j = 0; j + LEARN_VEC <= n; j += LEARN_VEC) {
+        d = vec_sub(vec_load(row + j), vec_load(mean + j));
+        vec_store(acc + j, vec_add(vec_load(acc + j), vec_mul(d, vw)));
+    }
+
+    return j;
+}
+#else
+static unsigned int minmax_sum_kernel(const float *row, float *min, float *max, float *sum, unsigned int n) {
+    return 0;
+}
+
+static unsigned int variance_kernel(const float *row, const float *mean, float *sq, unsigned int n) {
+    return 0;
+}
+
+static unsigned int covariance_kernel(const float *row, const float *mean, float *acc, float w, unsigned int n) {
+    return 0;
+}
+#endif
+
+static unsigned short value_ranges(float min, float max, float mean) {
+    unsigned short r = 0;
+
+    if (min >= 0 && max <= 2)      r |= LEARN_RANGE_VOLTAGE;
+    if (min >= 0 && max <= 7)      r |= LEARN_RANGE_GHZ;
+    if (min >= 0 && max <= 100.5f) r |= LEARN_RANGE_PERCENT;
+    if (min >= 10 && max <= 120)   r |= LEARN_RANGE_TEMP;
+    if (min >= -1 && max <= 600)   r |= LEARN_RANGE_POWER;
+    if (min >= 0 && max <= 8000 && max >= 100) r |= LEARN_RANGE_MHZ;
+
+    if (mean >= 0.5f && mean <= 1.6f) r |= LEARN_TYPICAL_VOLTAGE;
+    if (mean >= 25 && mean <= 100)    r |= LEARN_TYPICAL_TEMP;
+    if (mean >= 0.4f && mean <= 6)    r |= LEARN_TYPICAL_GHZ;
+    if (mean >= 300 && mean <= 7000)  r |= LEARN_TYPICAL_MHZ;
+
+    return r;
+}
+
+void layout_learn_analyze(layout_learner *l) {
+    const float *row;
+    unsigned int i, j, n;
+
+    n = l->num_samples;
+    for (j = 0; j < l->stride; j++) {
+        l->min[j] = INFINITY;
+        l->max[j] = -INFINITY;
+        l->mean[j] = 0;
+        l->stddev[j] = 0;
+    }
+    if (!n) return;
+
+    for (i = 0; i < n; i++) {
+        row = l->data + (size_t)i * l->stride;
+        for (j = minmax_sum_kernel(row, l->min, l->max, l->mean, l->stride); j < l->stride; j++) {
+            if (row[j] < l->min[j]) l->min[j] = row[j];
+            if (row[j] > l->max[j]) l->max[j] = row[j];
+            l->mean[j] += row[j];
+        }
+    }
+    for (j = 0; j < l->stride; j++) l->mean[j] /= n;
+
+    //Second pass around the mean. Single pass sums of squares lose too much in float.
+    for (i = 0; i < n; i++) {
+        row = l->data + (size_t)i * l->stride;
+        for (j = variance_kernel(row, l->mean, l->stddev, l->stride); j < l->stride; j++)
+            l->stddev[j] += (row[j] - l->mean[j]) * (row[j] - l->mean[j]);
+    }
+
+    for (j = 0; j < l->num_slots; j++) {
+        l->stddev[j] = sqrtf(l->stddev[j] / n);
+        l->ranges[j] = 0;
+        if (l->invalid[j]) l->cls[j] = LEARN_SLOT_INVALID;
+        else if (l->min[j] == 0 && l->max[j] == 0) l->cls[j] = LEARN_SLOT_ZERO;
+        else {
+            l->cls[j] = l->min[j] == l->max[j] ? LEARN_SLOT_STATIC : LEARN_SLOT_DYNAMIC;
+            l->ranges[j] = value_ranges(l->min[j], l->max[j], l->mean[j]);
+        }
+    }
+}
+
+void layout_learn_correlate(layout_learner *l, const float *ref, float *corr) {
+    const float *row;
+    double rmean, rvar;
+    unsigned int i, j, n;
+    float w;
+
+    n = l->num_samples;
+    rmean = rvar = 0;
+    for (i = 0; i < n; i++) rmean += ref[i];
+    rmean /= n;
+    for (i = 0; i < n; i++) rvar += (ref[i] - rmean) * (ref[i] - rmean);
+
+    for (j = 0; j < l->stride; j++) corr[j] = 0;
+    for (i = 0; i < n; i++) {
+        row = l->data + (size_t)i * l->stride;
+        w = ref[i] - rmean;
+        for (j = covariance_kernel(row, l->mean, corr, w, l->stride); j < l->stride; j++)
+            corr[j] += (row[j] - l->mean[j]) * w;
+    }
+
+    for (j = 0; j < l->num_slots; j++) {
+        if (rvar > 0 && l->stddev[j] > 0) corr[j] /= sqrt(rvar / n) * l->stddev[j] * n;
+        else corr[j] = 0;
+    }
+}
+
+static void unit_ranges(const pm_field *f, learn_element *e) {
+    e->plausible = e->typical = 0;
+    if      (!strcmp(f->unit, "V"))   { e->plausible = LEARN_RANGE_VOLTAGE; e->typical = LEARN_TYPICAL_VOLTAGE; }
+    else if (!strcmp(f->unit, "GHz")) { e->plausible = LEARN_RANGE_GHZ;     e->typical = LEARN_TYPICAL_GHZ; }
+    else if (!strcmp(f->unit, "MHz")) { e->plausible = LEARN_RANGE_MHZ;     e->typical = LEARN_TYPICAL_MHZ; }
+    else if (!strcmp(f->unit, "C"))   { e->plausible = LEARN_RANGE_TEMP;    e->typical = LEARN_TYPICAL_TEMP; }
+    else if (!strcmp(f->unit, "%"))   e->plausible = LEARN_RANGE_PERCENT;
+    else if (!strcmp(f->unit, "W") || !strcmp(f->unit, "A")) e->plausible = LEARN_RANGE_POWER;
+
+    e->limit = strstr(f->name, "LIMIT") != NULL;
+    e->changing = strstr(f->name, "VALUE") || !strcmp(f->unit, "C") || !strcmp(f->unit, "W");
+}
+
+static int compare_element(const void *a, const void *b) {
+    const learn_element *x = a, *y = b;
+
+    if (x->index != y->index) return x->index - y->index;
+    return x->field != y->field ? x->field - y->field : x->element - y->element;
+}
+
+//Fills m with the elements of a known layout, ordered by their index
+static int known_elements(unsigned int version, learn_match *m) {
+    pm_table pmt;
+    const float *p;
+    int f, e, n, cap;
+
+    memset(m, 0, sizeof(learn_match));
+    if (!select_pm_table_version(version, &pmt, (unsigned char*)probe)) return 0;
+    m->version = version;
+    memcpy(&m->meta, &pmt, offsetof(pm_table, STAPM_LIMIT));
+
+    cap = 0;
+    for (f = 0; f < PMT_NUM_FIELDS; f++) cap += pm_field_length(&pmt, f);
+    m->elements = malloc(cap * sizeof(learn_element));
+    m->shift = malloc(cap * sizeof(int));
+    m->fit = malloc(cap * sizeof(float));
+    if (!m->elements || !m->shift || !m->fit) {
+        pm_table_free(&pmt);
+        return 0;
+    }
+
+    for (f = 0; f < PMT_NUM_FIELDS; f++) {
+        n = pm_field_length(&pmt, f);
+        for (e = 0; e < n; e++) {
+            p = pm_field_element(&pmt, f, e);
+            if (!p) continue;
+            m->elements[m->num_elements].field = f;
+            m->elements[m->num_elements].element = e;
+            m->elements[m->num_elements].index = p - probe;
+            unit_ranges(&pm_fields[f], &m->elements[m->num_elements]);
+            m->num_elements++;
+        }
+    }
+    pm_table_free(&pmt);
+    qsort(m->elements, m->num_elements, sizeof(learn_element), compare_element);
+
+    return m->num_elements > 0;
+}
+
+static void free_match(learn_match *m) {
+    free(m->elements);
+    free(m->shift);
+    free(m->fit);
+    memset(m, 0, sizeof(learn_match));
+}
+
+//How well a slot fits an element of a known layout
+static float slot_score(const layout_learner *l, const learn_element *e, int slot) {
+    float score;
+
+    if (slot < 0 || slot >= (int)l->num_slots) return -1;
+    switch (l->cls[slot]) {
+        case LEARN_SLOT_INVALID: return -2;
+        case LEARN_SLOT_ZERO:    return 0;
+    }
+    if (!e->plausible) return 0.2f;
+    if (!(l->ranges[slot] & e->plausible)) return -1;
+
+    score = 1;
+    if (l->ranges[slot] & e->typical) score += 1;
+    if (e->limit && l->cls[slot] == LEARN_SLOT_STATIC) score += 0.5f;
+    if (e->changing && l->cls[slot] == LEARN_SLOT_DYNAMIC) score += 0.5f;
+
+    return score;
+}
+
+//Picks the shift of every element, walking the elements in index order. The shift stays
+//constant unless changing it pays off by more than LEARN_SHIFT_COST, so fields without much
+//evidence of their own (unknown units, zeros) move together with their neighbours. The
+//order of the elements is kept. Returns the mean fit of all elements.
+static float align(const layout_learner *l, learn_match *m) {
+    float *cost, *prev, *cur, *score, pmin[LEARN_SHIFTS], best, total, stay, moved;
+    unsigned char *back;
+    int pmin_d[LEARN_SHIFTS], i, d, g, k, n;
+
+    n = m->num_elements;
+    cost = malloc(2 * LEARN_SHIFTS * sizeof(float));
+    score = malloc((size_t)n * LEARN_SHIFTS * sizeof(float));
+    back = malloc((size_t)n * LEARN_SHIFTS);
+    if (!cost || !score || !back) {
+        free(cost);
+        free(score);
+        free(back);
+        return -INFINITY;
+    }
+
+    for (i = 0; i < n; i++)
+        for (d = 0; d < LEARN_SHIFTS; d++)
+            score[i * LEARN_SHIFTS + d] = slot_score(l, &m->elements[i], m->elements[i].index + d - LEARN_MAX_SHIFT);
+
+    //Costs are negative scores. Starting with a shift other than 0 costs like a change.
+    prev = cost;
+    cur = cost + LEARN_SHIFTS;
+    for (d = 0; d < LEARN_SHIFTS; d++)
+        prev[d] = -score[d] + (d != LEARN_MAX_SHIFT ? LEARN_SHIFT_COST : 0);
+
+    for (i = 1; i < n; i++) {
+        g = m->elements[i].index - m->elements[i - 1].index;
+
+        //Best previous shift up to d
+        pmin[0] = prev[0];
+        pmin_d[0] = 0;
+        for (d = 1; d < LEARN_SHIFTS; d++) {
+            pmin[d] = prev[d] < pmin[d - 1] ? prev[d] : pmin[d - 1];
+            pmin_d[d] = prev[d] < pmin[d - 1] ? d : pmin_d[d - 1];
+        }
+
+        for (d = 0; d < LEARN_SHIFTS; d++) {
+            stay = prev[d];
+            back[i * LEARN_SHIFTS + d] = d;
+            //Elements at the same index are aliases and keep the shift. Otherwise the
+            //previous element has to stay in front: previous shift < d + g.
+            if (g > 0) {
+                k = d + g - 1 < LEARN_SHIFTS - 1 ? d + g - 1 : LEARN_SHIFTS - 1;
+                moved = pmin[k] + LEARN_SHIFT_COST;
+                if (moved < stay) {
+                    stay = moved;
+                    back[i * LEARN_SHIFTS + d] = pmin_d[k];
+                }
+            }
+            cur[d] = stay - score[i * LEARN_SHIFTS + d];
+        }
+        prev = cur;
+        cur = cost + (cur == cost ? LEARN_SHIFTS : 0);
+    }
+
+    best = INFINITY;
+    d = LEARN_MAX_SHIFT;
+    for (k = 0; k < LEARN_SHIFTS; k++) {
+        if (prev[k] < best) {
+            best = prev[k];
+            d = k;
+        }
+    }
+
+    total = 0;
+    for (i = n - 1; i >= 0; i--) {
+        m->shift[i] = d - LEARN_MAX_SHIFT;
+        m->fit[i] = score[i * LEARN_SHIFTS + d];
+        total += m->fit[i];
+        if (i) d = back[i * LEARN_SHIFTS + d];
+    }
+
+    free(cost);
+    free(score);
+    free(back);
+
+    return total / n;
+}
+
+const char* layout_learn_describe(unsigned short r) {
+    if (r & LEARN_TYPICAL_TEMP && r & LEARN_RANGE_TEMP) return "temperature-like";
+    if (r & LEARN_TYPICAL_VOLTAGE) return "voltage-like";
+    if (r & LEARN_TYPICAL_MHZ) return "MHz-like";
+    if (r & LEARN_TYPICAL_GHZ && r & LEARN_RANGE_GHZ) return "GHz-like";
+    if (r & LEARN_RANGE_PERCENT) return "0..100";
+    if (r & LEARN_RANGE_POWER) return "power-like";
+    return "unclassified";
+}
+
+//Runs of max_cores consecutive dynamic slots with the same value ranges
+static void print_core_runs(const layout_learner *l, int max_cores, FILE *out) {
+    unsigned int j, k, found = 0;
+
+    if (max_cores < 2) return;
+    fprintf(out, "# Runs of %d dynamic slots with the same value range (per core arrays?):\n", max_cores);
+    for (j = 0; j + max_cores <= l->num_slots; ) {
+        for (k = 0; k < (unsigned int)max_cores; k++)
+            if (l->cls[j + k] != LEARN_SLOT_DYNAMIC || l->ranges[j + k] != l->ranges[j]) break;
+        if (k < (unsigned int)max_cores) {
+            j++;
+            continue;
+        }
+        fprintf(out, "#   %u..%u %s\n", j, j + max_cores - 1, layout_learn_describe(l->ranges[j]));
+        j += max_cores;
+        found++;
+    }
+    if (!found) fprintf(out, "#   none\n");
+}
+
+//Looks for a slot that follows the sum of CORE_POWER, like SOCKET_POWER does.
+//Returns the slot or -1. Its correlation is stored in corr_out.
+static int find_power_total(layout_learner *l, learn_match *m, float *corr_out) {
+    float *ref, *corr, core_mean, best;
+    int i, j, slot, best_slot, num_core;
+
+    ref = calloc(l->num_samples, sizeof(float));
+    corr = aligned_alloc(32, l->stride * sizeof(float));
+    if (!ref || !corr) {
+        free(ref);
+        free(corr);
+        return -1;
+    }
+
+    core_mean = 0;
+    num_core = 0;
+    for (j = 0; j < m->num_elements; j++) {
+        if (m->elements[j].field != PMT_ID_CORE_POWER) continue;
+        slot = m->elements[j].index + m->shift[j];
+        if (slot < 0 || slot >= (int)l->num_slots || l->cls[slot] != LEARN_SLOT_DYNAMIC) continue;
+        for (i = 0; i < (int)l->num_samples; i++) ref[i] += l->data[(size_t)i * l->stride + slot];
+        core_mean += l->mean[slot];
+        num_core++;
+    }
+
+    best_slot = -1;
+    best = LEARN_MIN_CORR;
+    if (num_core) {
+        layout_learn_correlate(l, ref, corr);
+        for (j = 0; j < (int)l->num_slots; j++) {
+            if (l->cls[j] != LEARN_SLOT_DYNAMIC || l->mean[j] < core_mean || !(l->ranges[j] & LEARN_RANGE_POWER)) continue;
+            if (corr[j] > best) {
+                best = corr[j];
+                best_slot = j;
+            }
+        }
+    }
+    *corr_out = best;
+
+    free(ref);
+    free(corr);
+    return best_slot;
+}
+
+static void print_field(const layout_learner *l, learn_match *m, int f, FILE *out) {
+    int idx[256], n, i, j, len, complete;
+    float fit;
+
+    len = pm_field_length(&m->meta, f);
+    if (len > 256) return;
+    for (i = 0; i < len; i++) idx[i] = -1;
+
+    n = 0;
+    fit = 0;
+    for (j = 0; j < m->num_elements; j++) {
+        if (m->elements[j].field != f) continue;
+        i = m->elements[j].index + m->shift[j];
+        if (i < 0 || i >= (int)l->num_slots) continue;
+        idx[m->elements[j].element] = i;
+        fit += m->fit[j];
+        n++;
+    }
+    if (!n) return;
+    fit /= n;
+
+    complete = n == len;
+    if (pm_fields[f].kind == PMT_FIELD_SCALAR) fprintf(out, "%-26s %d", pm_fields[f].name, idx[0]);
+    else if (complete) {
+        //Ranges and single indices in element order
+        fprintf(out, "%-26s", pm_fields[f].name);
+        for (i = 0; i < len; i = j) {
+            for (j = i + 1; j < len && idx[j] == idx[j - 1] + 1; j++);
+            if (j - i > 1) fprintf(out, " %d..%d", idx[i], idx[j - 1]);
+            else fprintf(out, " %d", idx[i]);
+        }
+    }
+    else {
+        for (i = 0, j = 0; i < len; i++) {
+            if (idx[i] < 0) continue;
+            if (j++) fprintf(out, "\n");
+            fprintf(out, "%s[%d]%*s %d", pm_fields[f].name, i, (int)(24 - strlen(pm_fields[f].name) - (i > 9 ? 2 : 1)), "", idx[i]);
+        }
+    }
+    if (fit < LEARN_LOW_FIT) fprintf(out, "    # low confidence");
+    fprintf(out, "\n");
+}
+
+unsigned int layout_learn_propose(layout_learner *l, unsigned int version, FILE *out) {
+    static const unsigned int versions[] = {
+#define LEARN_VERSION(v) v,
+        PM_TABLE_VERSIONS(LEARN_VERSION)
+    };
+    learn_match best, cur;
+    float second, corr;
+    unsigned int i, second_version, count[4] = {0};
+    int f, j, socket;
+
+    memset(&best, 0, sizeof(learn_match));
+    best.score = second = -INFINITY;
+    second_version = 0;
+    for (i = 0; i < sizeof(versions) / sizeof(versions[0]); i++) {
+        if (!known_elements(versions[i], &cur)) {
+            free_match(&cur);
+            continue;
+        }
+        cur.score = align(l, &cur);
+        if (cur.score > best.score) {
+            second = best.score;
+            second_version = best.version;
+            free_match(&best);
+            best = cur;
+        }
+        else {
+            if (cur.score > second) {
+                second = cur.score;
+                second_version = cur.version;
+            }
+            free_match(&cur);
+        }
+    }
+    if (!best.version) return 0;
+
+    for (i = 0; i < l->num_slots; i++) count[l->cls[i]]++;
+
+    fprintf(out, "# Proposed by ryzen_monitor -L from %u samples. Check every field before trusting it.\n", l->num_samples);
+    fprintf(out, "# Slots: %u zero, %u static, %u dynamic, %u not float\n",
+        count[LEARN_SLOT_ZERO], count[LEARN_SLOT_STATIC], count[LEARN_SLOT_DYNAMIC], count[LEARN_SLOT_INVALID]);
+    fprintf(out, "# Aligned with 0x%06x (fit %.2f)", best.version, best.score);
+    if (second_version) fprintf(out, ", next best 0x%06x (fit %.2f)", second_version, second);
+    fprintf(out, "\n");
+    print_core_runs(l, best.meta.max_cores, out);
+
+    //SOCKET_POWER has to follow the sum of the core powers. Take the best correlated total
+    //if the aligned slot doesn't.
+    socket = find_power_total(l, &best, &corr);
+    if (socket >= 0) {
+        fprintf(out, "# Slot %d follows the sum of CORE_POWER (r=%.3f)\n", socket, corr);
+        for (j = 0; j < best.num_elements; j++) {
+            if (best.elements[j].field != PMT_ID_SOCKET_POWER) continue;
+            if (best.elements[j].index + best.shift[j] != socket) {
+                fprintf(out, "# SOCKET_POWER moved from %d to it\n", best.elements[j].index + best.shift[j]);
+                best.shift[j] = socket - best.elements[j].index;
+            }
+        }
+    }
+    fprintf(out, "\n");
+
+    fprintf(out, "version          0x%06x\n", version);
+    fprintf(out, "max_cores        %d\n", best.meta.max_cores);
+    fprintf(out, "max_l3           %d\n", best.meta.max_l3);
+    fprintf(out, "zen_version      %d\n", best.meta.zen_version);
+    fprintf(out, "min_size         0x%x\n", l->num_slots * (unsigned int)sizeof(float));
+    fprintf(out, "experimental     1\n");
+    fprintf(out, "powersum_unclear %d\n", best.meta.powersum_unclear);
+    fprintf(out, "has_graphics     %d\n\n", best.meta.has_graphics);
+    for (f = 0; f < PMT_NUM_FIELDS; f++) print_field(l, &best, f, out);
+
+    i = best.version;
+    free_match(&best);
+
+    return i;
+}
+
+int run_layout_learning(smu_obj_t *obj, unsigned int version, unsigned int num_samples, double interval_s, FILE *out) {
+    struct timespec t0, t1;
+    layout_learner l;
+    unsigned char *pm_buf;
+    unsigned int failed = 0;
+
+    pm_buf = calloc(obj->pm_table_size, sizeof(unsigned char));
+    if (!pm_buf || !layout_learn_init(&l, obj->pm_table_size, num_samples)) {
+        fprintf(stderr, "Could not allocate memory for learning the PM Table layout.\n");
+        exit(0);
+    }
+
+    fprintf(stderr, "Sampling PM Table version 0x%x (%d bytes) %u times. Keep the system busy with varying load.\n",
+        version, obj->pm_table_size, num_samples);
+    while (l.num_samples < num_samples) {
+        if (smu_read_pm_table(obj, pm_buf, obj->pm_table_size) == SMU_Return_OK) {
+            layout_learn_add(&l, pm_buf);
+            failed = 0;
+        }
+        else if (++failed > 100) {
+            fprintf(stderr, "Could not read the PM Table.\n");
+            exit(0);
+        }
+        sleep_seconds(interval_s, NULL);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    layout_learn_analyze(&l);
+    if (!layout_learn_propose(&l, version, out)) fprintf(stderr, "No known PM Table layout to align with.\n");
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    fprintf(stderr, "Analyzed %u samples in %.0f ms.\n", l.num_samples,
+        (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) * 1e-6);
+
+    layout_learn_free(&l);
+    free(pm_buf);
+
+    return 0;
+}
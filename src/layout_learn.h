@@ -0,0 +1,81 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef LAYOUT_LEARN_H
+#define LAYOUT_LEARN_H
+
+#include <stdio.h>
+#include <libsmu.h>
+
+enum {
+    LEARN_SLOT_ZERO,        //0 in every sample
+    LEARN_SLOT_STATIC,      //Same value in every sample
+    LEARN_SLOT_DYNAMIC,
+    LEARN_SLOT_INVALID      //NaN, Inf or too large to be a sensor value. Probably not a float.
+};
+
+//Plausible value ranges of a slot (min and max over all samples)
+#define LEARN_RANGE_VOLTAGE (1 << 0)    //0..2 V
+#define LEARN_RANGE_GHZ     (1 << 1)    //0..7 GHz
+#define LEARN_RANGE_PERCENT (1 << 2)    //0..100 %
+#define LEARN_RANGE_TEMP    (1 << 3)    //10..120 C
+#define LEARN_RANGE_POWER   (1 << 4)    //0..600 W or A
+#define LEARN_RANGE_MHZ     (1 << 5)    //100..8000 MHz
+//Typical values. Narrower than the plausible ranges, so they tell the quantities apart.
+#define LEARN_TYPICAL_VOLTAGE (1 << 8)  //Mean 0.5..1.6 V
+#define LEARN_TYPICAL_TEMP    (1 << 9)  //Mean 25..100 C
+#define LEARN_TYPICAL_GHZ     (1 << 10) //Mean 0.4..6 GHz
+#define LEARN_TYPICAL_MHZ     (1 << 11) //Mean 300..7000 MHz
+
+typedef struct {
+    unsigned int num_slots;     //Floats per PM table
+    unsigned int stride;        //num_slots padded to the SIMD width
+    unsigned int num_samples, max_samples;
+    float *data;                //num_samples rows of stride floats
+
+    //Per slot results of layout_learn_analyze
+    unsigned char *invalid;     //Seen a value that is not a plausible float
+    unsigned char *cls;         //LEARN_SLOT_*
+    unsigned short *ranges;     //LEARN_RANGE_* and LEARN_TYPICAL_*
+    float *min, *max, *mean, *stddev;
+} layout_learner;
+
+int layout_learn_init(layout_learner *l, unsigned int table_size, unsigned int max_samples);
+void layout_learn_free(layout_learner *l);
+
+//Adds one sample. Ignored once max_samples are collected.
+void layout_learn_add(layout_learner *l, const unsigned char *pm_buf);
+
+//Classifies every slot. Needs at least two samples.
+void layout_learn_analyze(layout_learner *l);
+
+//Pearson correlation of every slot with ref (num_samples values). Constant slots get 0.
+void layout_learn_correlate(layout_learner *l, const float *ref, float *corr);
+
+//Short description of the LEARN_RANGE_* / LEARN_TYPICAL_* bits of a slot, like "temperature-like"
+const char* layout_learn_describe(unsigned short ranges);
+
+//Aligns the slots with each known PM table version, picks the best match and writes the proposed
+//layout for the given version in the format of pm_layout.c to out. Returns the matched version.
+unsigned int layout_learn_propose(layout_learner *l, unsigned int version, FILE *out);
+
+//Samples the PM table num_samples times, interval_s seconds apart, and writes the proposal to out.
+int run_layout_learning(smu_obj_t *obj, unsigned int version, unsigned int num_samples, double interval_s, FILE *out);
+
+#endif
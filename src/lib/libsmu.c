@@ -20,6 +20,7 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <fcntl.h>
+#include <time.h>
 
 #include "libsmu.h"
 
@@ -45,6 +46,123 @@
 /* Maximum is defined as: "255.255.255.255\n" */
 #define LIBSMU_MAX_SMU_VERSION_LEN      16
 
+static uint64_t smu_clock_ns() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static unsigned int smu_hist_bucket(uint64_t ns) {
+    unsigned int msb;
+
+    if (ns < SMU_HIST_SUB_BUCKETS)
+        return ns;
+
+    msb = 63 - __builtin_clzll(ns);
+    if (msb >= SMU_HIST_MAX_BITS)
+        return SMU_HIST_BUCKETS - 1;
+
+    // The top SMU_HIST_SUB_BITS below the leading one select the sub bucket.
+    return (msb - SMU_HIST_SUB_BITS + 1) * SMU_HIST_SUB_BUCKETS +
+        ((ns >> (msb - SMU_HIST_SUB_BITS)) & (SMU_HIST_SUB_BUCKETS - 1));
+}
+
+// Highest value that falls into the bucket.
+static uint64_t smu_hist_bucket_value(unsigned int bucket) {
+    unsigned int range, sub;
+
+    if (bucket < SMU_HIST_SUB_BUCKETS)
+        return bucket;
+
+    range = bucket / SMU_HIST_SUB_BUCKETS + SMU_HIST_SUB_BITS - 1;
+    sub = bucket % SMU_HIST_SUB_BUCKETS;
+
+    return ((uint64_t)(SMU_HIST_SUB_BUCKETS + sub + 1) << (range - SMU_HIST_SUB_BITS)) - 1;
+}
+
+static unsigned int smu_return_index(unsigned int ret) {
+    if (ret == SMU_Return_OK)
+        return 0;
+    if (ret >= SMU_Return_DriverVersion && ret <= SMU_Return_Failed)
+        return ret - SMU_Return_DriverVersion + 1;
+
+    return SMU_STATS_RETURN_CODES - 1;
+}
+
+// Must be called with the lock of the mailbox held.
+static void smu_hist_record(smu_obj_t* obj, unsigned int mailbox, unsigned int op,
+    unsigned int ret, uint64_t start_ns) {
+    uint64_t ns = smu_clock_ns() - start_ns;
+    smu_histogram* hist;
+
+    if (op >= SMU_STATS_OPCODES)
+        op = SMU_STATS_OPCODES - 1;
+
+    hist = obj->hist[mailbox][op];
+    if (!hist) {
+        hist = calloc(1, sizeof(smu_histogram));
+        if (!hist)
+            return;
+        hist->min_ns = UINT64_MAX;
+        obj->hist[mailbox][op] = hist;
+    }
+
+    hist->count++;
+    hist->total_ns += ns;
+    if (ns < hist->min_ns)
+        hist->min_ns = ns;
+    if (ns > hist->max_ns)
+        hist->max_ns = ns;
+    hist->returns[smu_return_index(ret)]++;
+    hist->buckets[smu_hist_bucket(ns)]++;
+}
+
+static void smu_lock(smu_obj_t* obj, int id) {
+    smu_lock_stats* st = &obj->lock_stats[id];
+    uint64_t start_ns, now_ns;
+
+    if (!obj->lock_stats_enabled) {
+        pthread_mutex_lock(&obj->lock[id]);
+        return;
+    }
+
+    // Uncontended locks only cost one clock read.
+    if (!pthread_mutex_trylock(&obj->lock[id])) {
+        st->acquired_ns = smu_clock_ns();
+        st->acquisitions++;
+        return;
+    }
+
+    start_ns = smu_clock_ns();
+    pthread_mutex_lock(&obj->lock[id]);
+    now_ns = smu_clock_ns();
+
+    st->acquired_ns = now_ns;
+    st->acquisitions++;
+    st->contended++;
+    st->wait_ns += now_ns - start_ns;
+    if (now_ns - start_ns > st->wait_max_ns)
+        st->wait_max_ns = now_ns - start_ns;
+}
+
+static void smu_unlock(smu_obj_t* obj, int id) {
+    smu_lock_stats* st = &obj->lock_stats[id];
+    uint64_t hold_ns;
+
+    // acquired_ns is 0 if statistics were enabled while the lock was held.
+    if (obj->lock_stats_enabled && st->acquired_ns) {
+        hold_ns = smu_clock_ns() - st->acquired_ns;
+        st->hold_ns += hold_ns;
+        if (hold_ns > st->hold_max_ns)
+            st->hold_max_ns = hold_ns;
+        st->acquired_ns = 0;
+    }
+
+    pthread_mutex_unlock(&obj->lock[id]);
+}
+
 int try_open_path(const char* pathname, int mode, int* fd) {
     int ret = 1;
 
@@ -173,15 +291,41 @@ smu_return_val smu_init_parse(smu_obj_t* obj) {
     return SMU_Return_OK;
 }
 
-int smu_init(smu_obj_t* obj) {
-    int i, ret;
+/** SYSFS BACKEND OF THE RYZEN_SMU DRIVER **/
 
-    memset(obj, 0, sizeof(*obj));
+// The driver directory is created when the module is loaded, its change time tells
+// different instances of the driver apart.
+static int64_t sysfs_driver_stamp() {
+    struct stat st;
+
+    if (stat(DRIVER_CLASS_PATH, &st))
+        return 0;
+
+    return (int64_t)st.st_ctim.tv_sec * 1000000000 + st.st_ctim.tv_nsec;
+}
+
+static smu_return_val sysfs_init(smu_obj_t* obj, const char* config) {
+    int64_t stamp;
+    int ret;
+
+    // The driver needs no configuration.
+    (void)config;
+
+    stamp = sysfs_driver_stamp();
+    if (!stamp)
+        return SMU_Return_DriverNotPresent;
 
     // Parse constants: SMU Version, Processor Codename, PM Table Size/Version
-    ret = smu_init_parse(obj);
-    if (ret != SMU_Return_OK)
-        return ret;
+    // They are already set when initialized from static information of the same driver.
+    if (!obj->driver_stamp) {
+        ret = smu_init_parse(obj);
+        if (ret != SMU_Return_OK)
+            return ret;
+    }
+    else if (obj->driver_stamp != stamp)
+        return SMU_Return_DriverVersion;
+
+    obj->driver_stamp = stamp;
 
     // The driver must provide access to these files.
     if (!try_open_path(SMN_PATH, O_RDWR, &obj->fd_smn) ||
@@ -197,17 +341,10 @@ int smu_init(smu_obj_t* obj) {
             return SMU_Return_RWError;
     }
 
-    for (i = 0; i < SMU_MUTEX_COUNT; i++)
-        pthread_mutex_init(&obj->lock[i], NULL);
-
-    obj->init = 1;
-
     return SMU_Return_OK;
 }
 
-void smu_free(smu_obj_t* obj) {
-    int i;
-
+static void sysfs_free(smu_obj_t* obj) {
     if (obj->fd_smn)
         close(obj->fd_smn);
 
@@ -222,146 +359,457 @@ void smu_free(smu_obj_t* obj) {
 
     if (obj->fd_pm_table)
         close(obj->fd_pm_table);
+}
 
-    for (i = 0; i < SMU_MUTEX_COUNT; i++)
-        pthread_mutex_destroy(&obj->lock[i]);
+// The driver keeps a single SMN address for all open files of the smn attribute, so the
+// address write and the value read must not be interleaved with other readers. SMU_MUTEX_SMN
+// only covers callers sharing one smu_obj_t, this lock covers all contexts of the process.
+static pthread_mutex_t sysfs_smn_lock = PTHREAD_MUTEX_INITIALIZER;
 
-    memset(obj, 0, sizeof(*obj));
+static smu_return_val sysfs_read_smn(smu_obj_t* obj, unsigned int address, unsigned int* result) {
+    smu_return_val ret = SMU_Return_OK;
+
+    pthread_mutex_lock(&sysfs_smn_lock);
+    if (pwrite(obj->fd_smn, &address, sizeof(address), 0) != sizeof(address) ||
+        pread(obj->fd_smn, result, sizeof(*result), 0) != sizeof(*result))
+        ret = SMU_Return_RWError;
+    pthread_mutex_unlock(&sysfs_smn_lock);
+
+    return ret;
 }
 
-const char* smu_get_fw_version(smu_obj_t* obj) {
-    static char fw[32] = { 0 };
+static smu_return_val sysfs_write_smn(smu_obj_t* obj, unsigned int address, unsigned int value) {
+    smu_return_val ret = SMU_Return_OK;
+    unsigned int buffer[2];
 
-    if (!obj->init)
-        return "Uninitialized";
+    buffer[0] = address;
+    buffer[1] = value;
+
+    pthread_mutex_lock(&sysfs_smn_lock);
+    if (pwrite(obj->fd_smn, buffer, sizeof(buffer), 0) != sizeof(buffer))
+        ret = SMU_Return_RWError;
+    pthread_mutex_unlock(&sysfs_smn_lock);
+
+    return ret;
+}
+
+// smu_args and the command files are single mailboxes of the driver as well. Without a
+// process-wide lock, another context could run its command with our arguments.
+static pthread_mutex_t sysfs_cmd_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static smu_return_val sysfs_mailbox_command(smu_obj_t* obj, unsigned int fd_smu_cmd, unsigned int op,
+    smu_arg_t* args) {
+    unsigned int ret, status;
+
+    lseek(obj->fd_smu_args, 0, SEEK_SET);
+    ret = write(obj->fd_smu_args, args->args, sizeof(*args));
+
+    if (ret != sizeof(*args))
+        return SMU_Return_RWError;
+
+    lseek(fd_smu_cmd, 0, SEEK_SET);
+    ret = write(fd_smu_cmd, &op, sizeof(op));
+
+    if (ret != sizeof(op))
+        return SMU_Return_RWError;
+
+    lseek(fd_smu_cmd, 0, SEEK_SET);
+    ret = read(fd_smu_cmd, &status, sizeof(status));
+
+    if (ret != sizeof(status))
+        return SMU_Return_RWError;
+
+    if (status == SMU_Return_OK) {
+        lseek(obj->fd_smu_args, 0, SEEK_SET);
+        ret = read(obj->fd_smu_args, args->args, sizeof(args->args));
+
+        if (ret != sizeof(args->args))
+            return SMU_Return_RWError;
+    }
+
+    return status;
+}
+
+static smu_return_val sysfs_send_command(smu_obj_t* obj, unsigned int op, smu_arg_t* args,
+    enum smu_mailbox mailbox) {
+    unsigned int fd_smu_cmd;
+    smu_return_val ret;
+
+    fd_smu_cmd = mailbox == TYPE_RSMU ? obj->fd_rsmu_cmd : obj->fd_mp1_smu_cmd;
+
+    // Check if fd is valid
+    if (!fd_smu_cmd)
+        return SMU_Return_Unsupported;
+
+    pthread_mutex_lock(&sysfs_cmd_lock);
+    ret = sysfs_mailbox_command(obj, fd_smu_cmd, op, args);
+    pthread_mutex_unlock(&sysfs_cmd_lock);
+
+    return ret;
+}
+
+static smu_return_val sysfs_read_pm_table(smu_obj_t* obj, unsigned char* dst, size_t dst_len) {
+    // The driver always returns the whole table.
+    if (dst_len < (size_t)obj->pm_table_size)
+        return SMU_Return_InsufficientSize;
+
+    lseek(obj->fd_pm_table, 0, SEEK_SET);
+    if (read(obj->fd_pm_table, dst, obj->pm_table_size) != obj->pm_table_size)
+        return SMU_Return_RWError;
+
+    return SMU_Return_OK;
+}
+
+// A driver that ignores the offset returns data past the end of the table, too. Checked
+// once before the first partial read, the offset must then land within the table.
+static smu_return_val sysfs_read_pm_table_range(smu_obj_t* obj, unsigned char* dst, size_t offset,
+    size_t len) {
+    unsigned char probe;
+
+    if (obj->pm_range_state == SMU_PM_RANGE_UNKNOWN &&
+        pread(obj->fd_pm_table, &probe, 1, obj->pm_table_size) != 0)
+        return SMU_Return_Unsupported;
+
+    if (pread(obj->fd_pm_table, dst, len, offset) != len)
+        return SMU_Return_RWError;
+
+    return SMU_Return_OK;
+}
+
+const smu_backend smu_sysfs_backend = {
+    .name           = "ryzen_smu",
+    .init           = sysfs_init,
+    .free           = sysfs_free,
+    .read_smn       = sysfs_read_smn,
+    .write_smn      = sysfs_write_smn,
+    .send_command   = sysfs_send_command,
+    .read_pm_table  = sysfs_read_pm_table,
+    .read_pm_table_range = sysfs_read_pm_table_range,
+};
+
+/** GENERIC PART **/
+
+int smu_init(smu_obj_t* obj) {
+    return smu_init_backend(obj, &smu_sysfs_backend, NULL);
+}
+
+static int smu_init_common(smu_obj_t* obj, const smu_backend* backend, const char* config,
+    const smu_static_info* info) {
+    int i, ret;
+
+    memset(obj, 0, sizeof(*obj));
+    obj->backend = backend;
+
+    if (info) {
+        obj->driver_version = info->driver_version;
+        obj->codename = info->codename;
+        obj->smu_if_version = info->smu_if_version;
+        obj->smu_version = info->smu_version;
+        obj->pm_table_size = info->pm_table_size;
+        obj->pm_table_version = info->pm_table_version;
+        obj->driver_stamp = info->driver_stamp;
+    }
+
+    ret = backend->init(obj, config);
+    if (ret != SMU_Return_OK)
+        return ret;
+
+    for (i = 0; i < SMU_MUTEX_COUNT; i++)
+        pthread_mutex_init(&obj->lock[i], NULL);
 
     if (obj->smu_version & 0xff000000) {
-        sprintf(fw, "%d.%d.%d.%d",
+        snprintf(obj->fw_version, sizeof(obj->fw_version), "%d.%d.%d.%d",
             (obj->smu_version >> 24) & 0xff, (obj->smu_version >> 16) & 0xff,
             (obj->smu_version >> 8) & 0xff, obj->smu_version & 0xff);
     }
     else
-        sprintf(fw, "%d.%d.%d",
+        snprintf(obj->fw_version, sizeof(obj->fw_version), "%d.%d.%d",
             (obj->smu_version >> 16) & 0xff, (obj->smu_version >> 8) & 0xff,
             obj->smu_version & 0xff);
 
-    return fw;
+    obj->init = 1;
+
+    return SMU_Return_OK;
 }
 
-unsigned int smu_read_smn_addr(smu_obj_t* obj, unsigned int address, unsigned int* result) {
-    unsigned int ret;
+int smu_init_backend(smu_obj_t* obj, const smu_backend* backend, const char* config) {
+    return smu_init_common(obj, backend, config, NULL);
+}
+
+int smu_init_static(smu_obj_t* obj, const smu_static_info* info) {
+    int ret;
+
+    ret = smu_init_common(obj, &smu_sysfs_backend, NULL, info);
+
+    // Don't leave open files behind, callers retry with smu_init.
+    if (ret != SMU_Return_OK)
+        sysfs_free(obj);
+
+    return ret;
+}
 
-    pthread_mutex_lock(&obj->lock[SMU_MUTEX_SMN]);
+void smu_get_static_info(smu_obj_t* obj, smu_static_info* info) {
+    memset(info, 0, sizeof(*info));
+    info->driver_version = obj->driver_version;
+    info->codename = obj->codename;
+    info->smu_if_version = obj->smu_if_version;
+    info->smu_version = obj->smu_version;
+    info->pm_table_size = obj->pm_table_size;
+    info->pm_table_version = obj->pm_table_version;
+    info->driver_stamp = obj->driver_stamp;
+}
+
+void smu_free(smu_obj_t* obj) {
+    int i;
 
-    lseek(obj->fd_smn, 0, SEEK_SET);
-    ret = write(obj->fd_smn, &address, sizeof(address));
+    if (obj->backend && obj->backend->free)
+        obj->backend->free(obj);
 
-    if (ret != sizeof(address))
-        goto BREAK_OUT;
+    for (i = 0; i < SMU_MUTEX_COUNT; i++)
+        pthread_mutex_destroy(&obj->lock[i]);
 
-    lseek(obj->fd_smn, 0, SEEK_SET);
-    ret = read(obj->fd_smn, result, sizeof(*result));
+    for (i = 0; i < SMU_STATS_MAILBOXES * SMU_STATS_OPCODES; i++)
+        free(obj->hist[i / SMU_STATS_OPCODES][i % SMU_STATS_OPCODES]);
 
-BREAK_OUT:
-    pthread_mutex_unlock(&obj->lock[SMU_MUTEX_SMN]);
+    free(obj->pm_scratch);
 
-    return ret == sizeof(unsigned int) ? SMU_Return_OK : SMU_Return_RWError;
+    memset(obj, 0, sizeof(*obj));
 }
 
-smu_return_val smu_write_smn_addr(smu_obj_t* obj, unsigned int address, unsigned int value) {
-    unsigned int buffer[2], ret;
+const char* smu_get_fw_version(smu_obj_t* obj) {
+    if (!obj->init)
+        return "Uninitialized";
 
-    buffer[0] = address;
-    buffer[1] = value;
+    return obj->fw_version;
+}
 
-    pthread_mutex_lock(&obj->lock[SMU_MUTEX_SMN]);
+unsigned int smu_read_smn_addr(smu_obj_t* obj, unsigned int address, unsigned int* result) {
+    smu_return_val ret;
 
-    lseek(obj->fd_smn, 0, SEEK_SET);
-    ret = write(obj->fd_smn, buffer, sizeof(buffer));
+    smu_lock(obj, SMU_MUTEX_SMN);
+    ret = obj->backend->read_smn(obj, address, result);
+    smu_unlock(obj, SMU_MUTEX_SMN);
 
-    pthread_mutex_unlock(&obj->lock[SMU_MUTEX_SMN]);
+    return ret;
+}
+
+smu_return_val smu_read_smn_addrs(smu_obj_t* obj, const unsigned int* addresses,
+    unsigned int* results, unsigned int count) {
+    smu_return_val ret = SMU_Return_OK;
+    unsigned int i;
 
-    return ret == sizeof(buffer) ? SMU_Return_OK : SMU_Return_RWError;
+    smu_lock(obj, SMU_MUTEX_SMN);
+    for (i = 0; i < count && ret == SMU_Return_OK; i++)
+        ret = obj->backend->read_smn(obj, addresses[i], &results[i]);
+    smu_unlock(obj, SMU_MUTEX_SMN);
+
+    return ret;
+}
+
+smu_return_val smu_write_smn_addr(smu_obj_t* obj, unsigned int address, unsigned int value) {
+    smu_return_val ret;
+
+    smu_lock(obj, SMU_MUTEX_SMN);
+    ret = obj->backend->write_smn(obj, address, value);
+    smu_unlock(obj, SMU_MUTEX_SMN);
+
+    return ret;
 }
 
 smu_return_val smu_send_command(smu_obj_t* obj, unsigned int op, smu_arg_t args,
     enum smu_mailbox mailbox) {
-    unsigned int ret, status, fd_smu_cmd;
+    return smu_send_command_args(obj, op, &args, mailbox);
+}
 
-    switch (mailbox) {
-        case TYPE_RSMU:
-            fd_smu_cmd = obj->fd_rsmu_cmd;
-            break;
-        case TYPE_MP1:
-            fd_smu_cmd = obj->fd_mp1_smu_cmd;
-            break;
-        default:
-            return SMU_Return_Unsupported;
-    }
+smu_return_val smu_send_command_args(smu_obj_t* obj, unsigned int op, smu_arg_t* args,
+    enum smu_mailbox mailbox) {
+    smu_return_val ret;
+    uint64_t start_ns;
 
-    // Check if fd is valid
-    if (!fd_smu_cmd)
+    if (mailbox != TYPE_RSMU && mailbox != TYPE_MP1)
         return SMU_Return_Unsupported;
 
-    pthread_mutex_lock(&obj->lock[SMU_MUTEX_CMD]);
+    smu_lock(obj, SMU_MUTEX_CMD);
 
-    lseek(obj->fd_smu_args, 0, SEEK_SET);
-    ret = write(obj->fd_smu_args, args.args, sizeof(args));
+    start_ns = smu_clock_ns();
+    ret = obj->backend->send_command(obj, op, args, mailbox);
+    smu_hist_record(obj, mailbox, op, ret, start_ns);
 
-    if (ret != sizeof(args)) {
-        ret = SMU_Return_RWError;
-        goto BREAK_OUT;
-    }
+    smu_unlock(obj, SMU_MUTEX_CMD);
 
-    lseek(fd_smu_cmd, 0, SEEK_SET);
-    ret = write(fd_smu_cmd, &op, sizeof(op));
+    return ret;
+}
 
-    if (ret != sizeof(op)) {
-        ret = SMU_Return_RWError;
-        goto BREAK_OUT;
-    }
+smu_return_val smu_read_pm_table(smu_obj_t* obj, unsigned char* dst, size_t dst_len) {
+    smu_return_val ret;
+    uint64_t start_ns;
 
-    lseek(fd_smu_cmd, 0, SEEK_SET);
-    ret = read(fd_smu_cmd, &status, sizeof(status));
+    if (dst_len != obj->pm_table_size)
+        return SMU_Return_InsufficientSize;
 
-    if (ret != sizeof(status))
-        ret = SMU_Return_RWError;
-    else
-        ret = status;
+    smu_lock(obj, SMU_MUTEX_PM);
 
-    if (ret == SMU_Return_OK) {
-        lseek(obj->fd_smu_args, 0, SEEK_SET);
-        ret = read(obj->fd_smu_args, args.args, sizeof(args.args));
+    start_ns = smu_clock_ns();
+    ret = obj->backend->read_pm_table(obj, dst, dst_len);
+    smu_hist_record(obj, SMU_STATS_PM_TABLE, 0, ret, start_ns);
+
+    smu_unlock(obj, SMU_MUTEX_PM);
 
-        if (ret != sizeof(args.args))
-            ret = SMU_Return_RWError;
+    return ret;
+}
+
+smu_return_val smu_read_pm_table_range(smu_obj_t* obj, unsigned char* dst, size_t offset, size_t len) {
+    smu_return_val ret = SMU_Return_Unsupported;
+    uint64_t start_ns;
+
+    if (offset > obj->pm_table_size || len > obj->pm_table_size - offset)
+        return SMU_Return_InvalidArgument;
+
+    if (offset == 0 && len == obj->pm_table_size)
+        return smu_read_pm_table(obj, dst, len);
+
+    smu_lock(obj, SMU_MUTEX_PM);
+
+    start_ns = smu_clock_ns();
+
+    if (obj->pm_range_state != SMU_PM_RANGE_UNSUPPORTED && obj->backend->read_pm_table_range) {
+        ret = obj->backend->read_pm_table_range(obj, dst, offset, len);
+        if (ret == SMU_Return_OK)
+            obj->pm_range_state = SMU_PM_RANGE_SUPPORTED;
     }
 
-BREAK_OUT:
-    pthread_mutex_unlock(&obj->lock[SMU_MUTEX_CMD]);
+    // Not supported by the backend: Read everything and copy the range out of it.
+    if (ret == SMU_Return_Unsupported) {
+        obj->pm_range_state = SMU_PM_RANGE_UNSUPPORTED;
+        if (!obj->pm_scratch)
+            obj->pm_scratch = malloc(obj->pm_table_size);
+
+        if (!obj->pm_scratch)
+            ret = SMU_Return_InsufficientSize;
+        else {
+            ret = obj->backend->read_pm_table(obj, obj->pm_scratch, obj->pm_table_size);
+            if (ret == SMU_Return_OK)
+                memcpy(dst, obj->pm_scratch + offset, len);
+        }
+    }
+
+    smu_hist_record(obj, SMU_STATS_PM_TABLE, 0, ret, start_ns);
+
+    smu_unlock(obj, SMU_MUTEX_PM);
 
     return ret;
 }
 
-smu_return_val smu_read_pm_table(smu_obj_t* obj, unsigned char* dst, size_t dst_len) {
-    int ret;
+const smu_histogram* smu_get_histogram(smu_obj_t* obj, unsigned int mailbox, unsigned int op) {
+    if (mailbox >= SMU_STATS_MAILBOXES)
+        return NULL;
+    if (op >= SMU_STATS_OPCODES)
+        op = SMU_STATS_OPCODES - 1;
 
-    if (dst_len != obj->pm_table_size)
-        return SMU_Return_InsufficientSize;
+    return obj->hist[mailbox][op];
+}
 
-    pthread_mutex_lock(&obj->lock[SMU_MUTEX_PM]);
+uint64_t smu_histogram_percentile(const smu_histogram* hist, double fraction) {
+    uint64_t target, seen = 0, value;
+    unsigned int i;
 
-    lseek(obj->fd_pm_table, 0, SEEK_SET);
-    ret = read(obj->fd_pm_table, dst, obj->pm_table_size);
+    if (!hist || !hist->count)
+        return 0;
 
-    if (ret != obj->pm_table_size)
-        ret = SMU_Return_RWError;
-    else
-        ret = SMU_Return_OK;
+    target = fraction * hist->count + 0.5;
+    if (target < 1)
+        target = 1;
 
-    pthread_mutex_unlock(&obj->lock[SMU_MUTEX_PM]);
+    for (i = 0; i < SMU_HIST_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen >= target)
+            break;
+    }
 
-    return ret;
+    // Never report more than was measured, the last bucket is open ended.
+    value = i < SMU_HIST_BUCKETS ? smu_hist_bucket_value(i) : hist->max_ns;
+    if (value > hist->max_ns)
+        value = hist->max_ns;
+    if (value < hist->min_ns)
+        value = hist->min_ns;
+
+    return value;
+}
+
+void smu_print_histograms(smu_obj_t* obj, FILE* out) {
+    static const char* mailboxes[SMU_STATS_MAILBOXES] = { "RSMU", "MP1", "PM table" };
+    const smu_histogram* hist;
+    unsigned int mb, op, i;
+    int header = 0;
+
+    for (mb = 0; mb < SMU_STATS_MAILBOXES; mb++) {
+        for (op = 0; op < SMU_STATS_OPCODES; op++) {
+            hist = obj->hist[mb][op];
+            if (!hist || !hist->count)
+                continue;
+
+            if (!header) {
+                fprintf(out, "%-8s %6s %10s %10s %10s %10s %10s %10s %10s  %s\n", "mailbox", "op",
+                    "count", "min us", "mean us", "p50 us", "p99 us", "p99.9 us", "max us", "failures");
+                header = 1;
+            }
+
+            if (op == SMU_STATS_OPCODES - 1)
+                fprintf(out, "%-8s %6s", mailboxes[mb], ">0xff");
+            else
+                fprintf(out, "%-8s %#6x", mailboxes[mb], op);
+
+            fprintf(out, " %10llu %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f ",
+                (unsigned long long)hist->count, hist->min_ns / 1e3,
+                (double)hist->total_ns / hist->count / 1e3,
+                smu_histogram_percentile(hist, 0.5) / 1e3, smu_histogram_percentile(hist, 0.99) / 1e3,
+                smu_histogram_percentile(hist, 0.999) / 1e3, hist->max_ns / 1e3);
+
+            for (i = 1; i < SMU_STATS_RETURN_CODES; i++) {
+                if (!hist->returns[i])
+                    continue;
+                if (i == SMU_STATS_RETURN_CODES - 1)
+                    fprintf(out, " %u x other", hist->returns[i]);
+                else
+                    fprintf(out, " %u x %s", hist->returns[i],
+                        smu_return_to_str(SMU_Return_DriverVersion + i - 1));
+            }
+            fprintf(out, "\n");
+        }
+    }
+}
+
+void smu_lock_stats_enable(smu_obj_t* obj, int enable) {
+    obj->lock_stats_enabled = enable;
+}
+
+void smu_get_lock_stats(smu_obj_t* obj, smu_lock_stats* stats) {
+    int i;
+
+    // Taken without statistics, so reading them doesn't count as contention.
+    for (i = 0; i < SMU_MUTEX_COUNT; i++) {
+        pthread_mutex_lock(&obj->lock[i]);
+        stats[i] = obj->lock_stats[i];
+        pthread_mutex_unlock(&obj->lock[i]);
+        stats[i].acquired_ns = 0;
+    }
+}
+
+void smu_print_lock_stats(smu_obj_t* obj, FILE* out) {
+    static const char* names[SMU_MUTEX_COUNT] = { "SMN", "CMD", "PM" };
+    smu_lock_stats stats[SMU_MUTEX_COUNT];
+    int i;
+
+    smu_get_lock_stats(obj, stats);
+
+    fprintf(out, "%-5s %10s %10s %12s %12s %12s %12s\n", "lock", "acquired", "contended",
+        "wait us", "max wait us", "hold us", "max hold us");
+    for (i = 0; i < SMU_MUTEX_COUNT; i++) {
+        fprintf(out, "%-5s %10llu %10llu %12.1f %12.1f %12.1f %12.1f\n", names[i],
+            (unsigned long long)stats[i].acquisitions, (unsigned long long)stats[i].contended,
+            stats[i].wait_ns / 1e3, stats[i].wait_max_ns / 1e3,
+            stats[i].hold_ns / 1e3, stats[i].hold_max_ns / 1e3);
+    }
 }
 
 const char* smu_return_to_str(smu_return_val val) {
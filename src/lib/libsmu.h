@@ -20,6 +20,7 @@
 #define __LIB_SMU_H__
 
 #include <stdio.h>
+#include <stdint.h>
 #include <string.h>
 #include <pthread.h>
 
@@ -112,6 +113,15 @@ typedef enum {
     IF_VERSION_COUNT
 } smu_if_version;
 
+/**
+ * Whether the backend can read parts of the PM table, known after the first partial read.
+ */
+enum SMU_PM_RANGE_STATE {
+    SMU_PM_RANGE_UNKNOWN,
+    SMU_PM_RANGE_SUPPORTED,
+    SMU_PM_RANGE_UNSUPPORTED
+};
+
 /**
  * Mutex lock enumeration for specific components.
  */
@@ -122,6 +132,52 @@ enum SMU_MUTEX_LOCK {
     SMU_MUTEX_COUNT
 };
 
+/**
+ * Latency statistics of SMU commands.
+ * Every command is timed from the argument write to the final read and goes into a
+ *  histogram per mailbox and opcode. Reads of the PM table are tracked as a third
+ *  mailbox with opcode 0, the driver sends a table transfer command for each of them.
+ *
+ * Histograms are log-linear like HDR histograms: every power of two of nanoseconds is
+ *  split into SMU_HIST_SUB_BUCKETS buckets, so values are kept with ~6% precision
+ *  from 1 ns up to several minutes.
+ */
+#define SMU_HIST_SUB_BITS           4
+#define SMU_HIST_SUB_BUCKETS        (1 << SMU_HIST_SUB_BITS)
+#define SMU_HIST_MAX_BITS           40
+#define SMU_HIST_BUCKETS            ((SMU_HIST_MAX_BITS - SMU_HIST_SUB_BITS + 1) * SMU_HIST_SUB_BUCKETS)
+
+#define SMU_STATS_PM_TABLE          2
+#define SMU_STATS_MAILBOXES         3
+#define SMU_STATS_OPCODES           257 // Opcodes above 0xFF share the last slot.
+
+// SMU_Return_OK, 0xF4..0xFF and anything else.
+#define SMU_STATS_RETURN_CODES      14
+
+typedef struct {
+    uint64_t                    count;
+    uint64_t                    total_ns;
+    uint64_t                    min_ns;
+    uint64_t                    max_ns;
+    unsigned int                returns[SMU_STATS_RETURN_CODES];
+    unsigned int                buckets[SMU_HIST_BUCKETS];
+} smu_histogram;
+
+/**
+ * Contention of the smu_obj_t locks. Only collected after smu_lock_stats_enable.
+ * Wait is the time from the request of a lock until it was acquired, hold the time
+ *  until it was released again.
+ */
+typedef struct {
+    uint64_t                    acquisitions;
+    uint64_t                    contended;      // Acquisitions that had to wait
+    uint64_t                    wait_ns;
+    uint64_t                    wait_max_ns;
+    uint64_t                    hold_ns;
+    uint64_t                    hold_max_ns;
+    uint64_t                    acquired_ns;    // Internal: Start of the current hold
+} smu_lock_stats;
+
 typedef struct {
     /* Accessible To Users */
     int                         init;
@@ -132,8 +188,17 @@ typedef struct {
     int                         smu_version;
     int                         pm_table_size;
     int                         pm_table_version;
+    char                        fw_version[32];
 
     /* Internal Library Use Only */
+    const struct smu_backend*   backend;
+    void*                       backend_data;
+    int64_t                     driver_stamp;
+
+    // Partial PM table reads. The scratch buffer holds whole tables if they are not supported.
+    int                         pm_range_state;
+    unsigned char*              pm_scratch;
+
     int                         fd_smn;
     int                         fd_rsmu_cmd;
     int                         fd_mp1_smu_cmd;
@@ -141,6 +206,11 @@ typedef struct {
     int                         fd_pm_table;
 
     pthread_mutex_t             lock[SMU_MUTEX_COUNT];
+    int                         lock_stats_enabled;
+    smu_lock_stats              lock_stats[SMU_MUTEX_COUNT];
+
+    // Allocated on the first use of an opcode. Updated under the lock of the mailbox.
+    smu_histogram*              hist[SMU_STATS_MAILBOXES][SMU_STATS_OPCODES];
 } smu_obj_t;
 
 typedef union {
@@ -165,6 +235,33 @@ typedef union {
     float                       args_f[6];
 } smu_arg_t;
 
+/**
+ * Source of the SMU data. The default backend talks to the ryzen_smu driver,
+ *  others can serve recorded or synthetic data for testing without the hardware.
+ *
+ * init fills codename, smu_version, pm_table_size and pm_table_version and may keep
+ *  its state in backend_data. config is passed through from smu_init_backend.
+ * The access functions are called with the lock of their mailbox held, so they
+ *  don't need to be thread safe themselves. These locks are per smu_obj_t, a backend
+ *  whose device state is shared by all contexts must serialize it process-wide.
+ * read_pm_table_range is optional. It returns SMU_Return_Unsupported if the source
+ *  can't serve partial reads, the whole table is read from then on.
+ */
+typedef struct smu_backend {
+    const char*                 name;
+    smu_return_val              (*init)(smu_obj_t* obj, const char* config);
+    void                        (*free)(smu_obj_t* obj);
+    smu_return_val              (*read_smn)(smu_obj_t* obj, unsigned int address, unsigned int* result);
+    smu_return_val              (*write_smn)(smu_obj_t* obj, unsigned int address, unsigned int value);
+    smu_return_val              (*send_command)(smu_obj_t* obj, unsigned int op, smu_arg_t* args,
+                                    enum smu_mailbox mailbox);
+    smu_return_val              (*read_pm_table)(smu_obj_t* obj, unsigned char* dst, size_t dst_len);
+    smu_return_val              (*read_pm_table_range)(smu_obj_t* obj, unsigned char* dst, size_t offset,
+                                    size_t len);
+} smu_backend;
+
+extern const smu_backend smu_sysfs_backend;
+
 /**
  * Initializes or frees the userspace library for use.
  * Upon successful initialization, users are allowed to access
@@ -176,8 +273,38 @@ typedef union {
 int smu_init(smu_obj_t* obj);
 void smu_free(smu_obj_t* obj);
 
+/**
+ * Like smu_init, but gets the data from the given backend instead of the driver.
+ */
+int smu_init_backend(smu_obj_t* obj, const smu_backend* backend, const char* config);
+
+/**
+ * Static facts of the platform that don't change while the driver stays loaded.
+ * driver_stamp identifies the loaded instance of the driver.
+ */
+typedef struct {
+    int                         driver_version;
+    smu_processor_codename      codename;
+    smu_if_version              smu_if_version;
+    int                         smu_version;
+    int                         pm_table_size;
+    int                         pm_table_version;
+    int64_t                     driver_stamp;
+} smu_static_info;
+
+/**
+ * Like smu_init, but takes the static facts from a previous smu_get_static_info()
+ *  instead of parsing them from the driver. Only the files needed for access are opened.
+ * Returns SMU_Return_DriverVersion if the driver was reloaded since, callers should then
+ *  fall back to smu_init. The facts are not checked otherwise, so they must come from
+ *  the same boot.
+ */
+int smu_init_static(smu_obj_t* obj, const smu_static_info* info);
+void smu_get_static_info(smu_obj_t* obj, smu_static_info* info);
+
 /**
  * Returns the string representation of the SMU FW version.
+ * It is stored in the object, so it stays valid until smu_free.
  */
 const char* smu_get_fw_version(smu_obj_t* obj);
 
@@ -187,6 +314,15 @@ const char* smu_get_fw_version(smu_obj_t* obj);
 unsigned int smu_read_smn_addr(smu_obj_t* obj, unsigned int address, unsigned int* result);
 smu_return_val smu_write_smn_addr(smu_obj_t* obj, unsigned int address, unsigned int value);
 
+/**
+ * Reads count words from the SMN address space while taking the SMN lock only once.
+ * Stops at the first error.
+ *
+ * Returns SMU_Return_OK if all words were read.
+ */
+smu_return_val smu_read_smn_addrs(smu_obj_t* obj, const unsigned int* addresses,
+    unsigned int* results, unsigned int count);
+
 /**
  * Sends a command to the SMU.
  * Arguments are sent in the args buffer and are also returned in it.
@@ -196,6 +332,12 @@ smu_return_val smu_write_smn_addr(smu_obj_t* obj, unsigned int address, unsigned
 smu_return_val smu_send_command(smu_obj_t* obj, unsigned int op, smu_arg_t args,
     enum smu_mailbox mailbox);
 
+/**
+ * Like smu_send_command, but the arguments returned by the SMU are written back to args.
+ */
+smu_return_val smu_send_command_args(smu_obj_t* obj, unsigned int op, smu_arg_t* args,
+    enum smu_mailbox mailbox);
+
 /**
  * Reads the PM table into the destination buffer.
  * 
@@ -203,6 +345,45 @@ smu_return_val smu_send_command(smu_obj_t* obj, unsigned int op, smu_arg_t args,
  */
 smu_return_val smu_read_pm_table(smu_obj_t* obj, unsigned char* dst, size_t dst_len);
 
+/**
+ * Reads len bytes of the PM table starting at offset into the destination buffer.
+ * Falls back to reading the whole table where the backend can't read parts of it.
+ *
+ * Returns SMU_Return_InvalidArgument if the range is outside of the table.
+ */
+smu_return_val smu_read_pm_table_range(smu_obj_t* obj, unsigned char* dst, size_t offset, size_t len);
+
+/**
+ * Returns the latency histogram of an opcode on a mailbox (TYPE_RSMU, TYPE_MP1 or
+ *  SMU_STATS_PM_TABLE) or NULL if it was never sent.
+ */
+const smu_histogram* smu_get_histogram(smu_obj_t* obj, unsigned int mailbox, unsigned int op);
+
+/**
+ * Returns the latency in ns below which the given fraction (0..1) of the commands completed.
+ */
+uint64_t smu_histogram_percentile(const smu_histogram* hist, double fraction);
+
+/**
+ * Prints count, percentiles and failed return codes of every opcode that was sent.
+ */
+void smu_print_histograms(smu_obj_t* obj, FILE* out);
+
+/**
+ * Starts or stops collecting lock statistics. Enable before other threads use the object.
+ */
+void smu_lock_stats_enable(smu_obj_t* obj, int enable);
+
+/**
+ * Copies the statistics of all SMU_MUTEX_COUNT locks to stats.
+ */
+void smu_get_lock_stats(smu_obj_t* obj, smu_lock_stats* stats);
+
+/**
+ * Prints acquisitions, contention, wait and hold times of every lock.
+ */
+void smu_print_lock_stats(smu_obj_t* obj, FILE* out);
+
 /** HELPER METHODS **/
 
 /**
@@ -0,0 +1,243 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+
+#include "libsmu_async.h"
+
+struct smu_async_waiter {
+    smu_async_callback          cb;
+    void*                       data;
+    smu_future_t*               future;
+    smu_async_waiter*           next;
+};
+
+struct smu_async_cmd {
+    unsigned int                op;
+    enum smu_mailbox            mailbox;
+    unsigned int                flags;
+    smu_arg_t                   args;
+    smu_async_waiter*           waiters;    // Everyone to complete, coalesced submitters included
+    smu_async_cmd*              next;
+};
+
+static void smu_async_sleep_us(unsigned int us) {
+    struct timespec ts;
+
+    ts.tv_sec = us / 1000000;
+    ts.tv_nsec = (us % 1000000) * 1000L;
+    while (nanosleep(&ts, &ts) && errno == EINTR);
+}
+
+static smu_return_val smu_async_send(smu_async_t* q, smu_async_cmd* cmd) {
+    unsigned int backoff = SMU_ASYNC_BACKOFF_US;
+    smu_arg_t args;
+    int attempt;
+    smu_return_val ret;
+
+    for (attempt = 0; ; attempt++) {
+        // A rejected command may have changed the arguments.
+        args = cmd->args;
+        ret = smu_send_command_args(q->obj, cmd->op, &args, cmd->mailbox);
+        if (ret != SMU_Return_CmdRejectedBusy || attempt == SMU_ASYNC_MAX_RETRIES)
+            break;
+
+        pthread_mutex_lock(&q->lock);
+        q->retries++;
+        pthread_mutex_unlock(&q->lock);
+
+        smu_async_sleep_us(backoff);
+        backoff = backoff * 2 > SMU_ASYNC_BACKOFF_MAX_US ? SMU_ASYNC_BACKOFF_MAX_US : backoff * 2;
+    }
+    cmd->args = args;
+
+    return ret;
+}
+
+static void* smu_async_worker(void* arg) {
+    smu_async_t* q = arg;
+    smu_async_waiter *w, *next;
+    smu_async_cmd* cmd;
+    smu_return_val ret;
+    int futures;
+
+    pthread_mutex_lock(&q->lock);
+    while (1) {
+        while (!q->head && !q->stop)
+            pthread_cond_wait(&q->work, &q->lock);
+        if (!q->head)
+            break;
+
+        // Once taken off the queue, a command can't be coalesced into anymore.
+        cmd = q->head;
+        q->head = cmd->next;
+        if (!q->head)
+            q->tail = NULL;
+        q->sent++;
+        pthread_mutex_unlock(&q->lock);
+
+        ret = smu_async_send(q, cmd);
+
+        futures = 0;
+        for (w = cmd->waiters; w; w = next) {
+            next = w->next;
+            if (w->cb)
+                w->cb(ret, &cmd->args, w->data);
+            if (w->future) {
+                pthread_mutex_lock(&q->lock);
+                w->future->ret = ret;
+                w->future->args = cmd->args;
+                w->future->done = 1;
+                pthread_mutex_unlock(&q->lock);
+                futures = 1;
+            }
+            free(w);
+        }
+        free(cmd);
+        if (futures)
+            pthread_cond_broadcast(&q->done);
+
+        pthread_mutex_lock(&q->lock);
+    }
+    pthread_mutex_unlock(&q->lock);
+
+    return NULL;
+}
+
+smu_return_val smu_async_init(smu_async_t* q, smu_obj_t* obj) {
+    memset(q, 0, sizeof(*q));
+    q->obj = obj;
+
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->work, NULL);
+    pthread_cond_init(&q->done, NULL);
+
+    if (pthread_create(&q->worker, NULL, smu_async_worker, q)) {
+        pthread_cond_destroy(&q->done);
+        pthread_cond_destroy(&q->work);
+        pthread_mutex_destroy(&q->lock);
+        return SMU_Return_Failed;
+    }
+
+    return SMU_Return_OK;
+}
+
+void smu_async_free(smu_async_t* q) {
+    pthread_mutex_lock(&q->lock);
+    q->stop = 1;
+    pthread_cond_signal(&q->work);
+    pthread_mutex_unlock(&q->lock);
+
+    pthread_join(q->worker, NULL);
+
+    pthread_cond_destroy(&q->done);
+    pthread_cond_destroy(&q->work);
+    pthread_mutex_destroy(&q->lock);
+    memset(q, 0, sizeof(*q));
+}
+
+static smu_return_val smu_async_queue(smu_async_t* q, unsigned int op, smu_arg_t args,
+    enum smu_mailbox mailbox, unsigned int flags, smu_async_waiter* w) {
+    smu_async_waiter** last;
+    smu_async_cmd* cmd;
+
+    if (!w)
+        return SMU_Return_Failed;
+
+    pthread_mutex_lock(&q->lock);
+
+    if (q->stop) {
+        pthread_mutex_unlock(&q->lock);
+        free(w);
+        return SMU_Return_Failed;
+    }
+    q->submitted++;
+
+    if (flags & SMU_ASYNC_COALESCE) {
+        for (cmd = q->head; cmd; cmd = cmd->next) {
+            if (cmd->op == op && cmd->mailbox == mailbox && (cmd->flags & SMU_ASYNC_COALESCE)) {
+                cmd->args = args;
+                // Completed in the order of submission.
+                for (last = &cmd->waiters; *last; last = &(*last)->next);
+                *last = w;
+                q->coalesced++;
+                pthread_mutex_unlock(&q->lock);
+                return SMU_Return_OK;
+            }
+        }
+    }
+
+    cmd = calloc(1, sizeof(smu_async_cmd));
+    if (!cmd) {
+        q->submitted--;
+        pthread_mutex_unlock(&q->lock);
+        free(w);
+        return SMU_Return_Failed;
+    }
+    cmd->op = op;
+    cmd->mailbox = mailbox;
+    cmd->flags = flags;
+    cmd->args = args;
+    cmd->waiters = w;
+
+    if (q->tail)
+        q->tail->next = cmd;
+    else
+        q->head = cmd;
+    q->tail = cmd;
+
+    pthread_cond_signal(&q->work);
+    pthread_mutex_unlock(&q->lock);
+
+    return SMU_Return_OK;
+}
+
+smu_return_val smu_async_submit(smu_async_t* q, unsigned int op, smu_arg_t args,
+    enum smu_mailbox mailbox, unsigned int flags, smu_async_callback cb, void* data) {
+    smu_async_waiter* w = calloc(1, sizeof(smu_async_waiter));
+
+    if (w) {
+        w->cb = cb;
+        w->data = data;
+    }
+
+    return smu_async_queue(q, op, args, mailbox, flags, w);
+}
+
+smu_return_val smu_async_submit_future(smu_async_t* q, unsigned int op, smu_arg_t args,
+    enum smu_mailbox mailbox, unsigned int flags, smu_future_t* future) {
+    smu_async_waiter* w = calloc(1, sizeof(smu_async_waiter));
+
+    memset(future, 0, sizeof(*future));
+    if (w)
+        w->future = future;
+
+    return smu_async_queue(q, op, args, mailbox, flags, w);
+}
+
+smu_return_val smu_future_wait(smu_async_t* q, smu_future_t* future) {
+    pthread_mutex_lock(&q->lock);
+    while (!future->done)
+        pthread_cond_wait(&q->done, &q->lock);
+    pthread_mutex_unlock(&q->lock);
+
+    return future->ret;
+}
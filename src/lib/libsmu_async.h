@@ -0,0 +1,108 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef __LIB_SMU_ASYNC_H__
+#define __LIB_SMU_ASYNC_H__
+
+#include "libsmu.h"
+
+/**
+ * Asynchronous SMU commands.
+ * A worker thread owns the mailbox and sends the queued commands in order, so the
+ *  submitting thread never blocks on SMU_MUTEX_CMD or the sysfs round trip.
+ *
+ * Commands submitted with SMU_ASYNC_COALESCE replace a queued, not yet sent command
+ *  with the same mailbox and opcode that was also submitted with it. Only the latest
+ *  arguments are sent, every submitter is completed with the result.
+ *
+ * Busy rejections are retried by the worker with exponential backoff, starting at
+ *  SMU_ASYNC_BACKOFF_US and doubling up to SMU_ASYNC_BACKOFF_MAX_US, at most
+ *  SMU_ASYNC_MAX_RETRIES times.
+ */
+#define SMU_ASYNC_COALESCE          0x01
+
+#define SMU_ASYNC_MAX_RETRIES       8
+#define SMU_ASYNC_BACKOFF_US        100
+#define SMU_ASYNC_BACKOFF_MAX_US    10000
+
+/**
+ * Called from the worker thread once a command completed.
+ * args holds the arguments returned by the SMU if ret is SMU_Return_OK.
+ */
+typedef void (*smu_async_callback)(smu_return_val ret, const smu_arg_t* args, void* data);
+
+/**
+ * Completion of a command for callers that rather wait than get called back.
+ * Owned by the caller and must stay valid until smu_future_wait returned.
+ */
+typedef struct {
+    int                         done;
+    smu_return_val              ret;
+    smu_arg_t                   args;
+} smu_future_t;
+
+typedef struct smu_async_cmd smu_async_cmd;
+typedef struct smu_async_waiter smu_async_waiter;
+
+typedef struct {
+    smu_obj_t*                  obj;
+
+    pthread_t                   worker;
+    pthread_mutex_t             lock;
+    pthread_cond_t              work;       // Queue not empty or stop
+    pthread_cond_t              done;       // A future completed
+    smu_async_cmd*              head;
+    smu_async_cmd*              tail;
+    int                         stop;
+
+    /* Statistics. Read under lock. */
+    unsigned long long          submitted;
+    unsigned long long          coalesced;  // Submissions merged into a queued command
+    unsigned long long          sent;       // Commands sent, retries not counted
+    unsigned long long          retries;    // Resends after busy rejections
+} smu_async_t;
+
+/**
+ * Starts or stops the worker. smu_async_free completes all queued commands first.
+ *
+ * Returns SMU_Return_OK on success.
+ */
+smu_return_val smu_async_init(smu_async_t* q, smu_obj_t* obj);
+void smu_async_free(smu_async_t* q);
+
+/**
+ * Queues a command. cb may be NULL for fire and forget.
+ *
+ * Returns SMU_Return_OK if the command was queued.
+ */
+smu_return_val smu_async_submit(smu_async_t* q, unsigned int op, smu_arg_t args,
+    enum smu_mailbox mailbox, unsigned int flags, smu_async_callback cb, void* data);
+
+/**
+ * Queues a command that completes the future.
+ */
+smu_return_val smu_async_submit_future(smu_async_t* q, unsigned int op, smu_arg_t args,
+    enum smu_mailbox mailbox, unsigned int flags, smu_future_t* future);
+
+/**
+ * Blocks until the future completed and returns the result of its command.
+ */
+smu_return_val smu_future_wait(smu_async_t* q, smu_future_t* future);
+
+#endif /* __LIB_SMU_ASYNC_H__ */
@@ -0,0 +1,146 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#define _GNU_SOURCE
+#include <math.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+
+#include "low_perturbation.h"
+#include "timing.h"
+
+int low_perturbation_pick_core(pm_frame *frame, system_info *sysinfo) {
+    int i, best = -1;
+
+    if (!pm_frame_valid(frame, PMF_CORE_CC6)) return -1;
+    for (i = 0; i < frame->num_cores; i++) {
+        if (core_disabled(sysinfo, i) || isnan(frame->core_cc6[i])) continue;
+        if (best < 0 || frame->core_cc6[i] < frame->core_cc6[best]) best = i;
+    }
+
+    return best;
+}
+
+int low_perturbation_init(low_perturbation *lp, int cpu, int core, cpu_topology *topo, double interval_s) {
+    cpu_set_t set;
+    double slack;
+    int ok = 1;
+
+    memset(lp, 0, sizeof(low_perturbation));
+    if (cpu < 0 && core >= 0 && topo) cpu = cpu_topology_core_cpu(topo, core, 0);
+    if (cpu < 0) cpu = sched_getcpu();
+    lp->cpu = cpu;
+    lp->core = cpu >= 0 && topo && cpu < topo->num_cpus ? topo->cpu_to_core[cpu] : -1;
+
+    if (cpu >= 0) {
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set)) {
+            lp->cpu = lp->core = -1;
+            ok = 0;
+        }
+    }
+
+    //A wakeup a bit late doesn't matter for the readings, merging it with other timers does
+    slack = interval_s * LOWPERT_SLACK_FRACTION;
+    if (slack > LOWPERT_MAX_SLACK_S) slack = LOWPERT_MAX_SLACK_S;
+    prctl(PR_SET_TIMERSLACK, (unsigned long)(slack * 1e9), 0, 0, 0);
+
+    //One write per frame instead of one per line on a terminal
+    setvbuf(stdout, NULL, _IOFBF, LOWPERT_OUTPUT_BUFFER);
+
+    lp->start_time = lp->last_time = monotonic_s();
+    process_usage(&lp->start_cpu_time, &lp->start_wakeups);
+    lp->last_cpu_time = lp->start_cpu_time;
+    lp->last_wakeups = lp->start_wakeups;
+    lp->core_power = lp->others_power = NAN;
+
+    return ok;
+}
+
+int low_perturbation_watched() {
+    pid_t fg;
+
+    if (!isatty(STDOUT_FILENO)) return 1;
+    fg = tcgetpgrp(STDOUT_FILENO);
+
+    return fg >= 0 && fg == getpgrp();
+}
+
+void low_perturbation_update(low_perturbation *lp, pm_frame *frame, system_info *sysinfo) {
+    double now, cpu_time, dt, sum;
+    long wakeups;
+    int i, n;
+
+    now = monotonic_s();
+    process_usage(&cpu_time, &wakeups);
+    dt = now - lp->last_time;
+    if (dt > 0) {
+        lp->cpu_percent = (cpu_time - lp->last_cpu_time) * 100. / dt;
+        lp->wakeups_per_s = (wakeups - lp->last_wakeups) / dt;
+    }
+    lp->last_time = now;
+    lp->last_cpu_time = cpu_time;
+    lp->last_wakeups = wakeups;
+
+    if (!frame || lp->core < 0 || lp->core >= frame->num_cores || !pm_frame_valid(frame, PMF_CORE_POWER))
+        return;
+    lp->core_power = frame->core_power[lp->core];
+    for (i = 0, n = 0, sum = 0; i < frame->num_cores; i++) {
+        if (i == lp->core || core_disabled(sysinfo, i) || isnan(frame->core_power[i])) continue;
+        sum += frame->core_power[i];
+        n++;
+    }
+    lp->others_power = n ? sum / n : NAN;
+}
+
+static const char* cpu_name(low_perturbation *lp, char *buf, size_t size) {
+    if (lp->cpu < 0) return "no fixed CPU";
+    snprintf(buf, size, "CPU %d", lp->cpu);
+    return buf;
+}
+
+void low_perturbation_print(low_perturbation *lp, FILE *out) {
+    char buf[32];
+
+    fprintf(out, "Monitor on %s: %.3f%% CPU, %.1f wakeups/s", cpu_name(lp, buf, sizeof(buf)),
+        lp->cpu_percent, lp->wakeups_per_s);
+    if (!isnan(lp->core_power) && !isnan(lp->others_power))
+        fprintf(out, ", core %d %.3f W (%+.3f W to the other cores)", lp->core, lp->core_power,
+            lp->core_power - lp->others_power);
+    fprintf(out, "\n");
+}
+
+void low_perturbation_summary(low_perturbation *lp, FILE *out) {
+    double now, cpu_time, dt;
+    long wakeups;
+    char buf[32];
+
+    now = monotonic_s();
+    process_usage(&cpu_time, &wakeups);
+    dt = now - lp->start_time;
+    if (dt <= 0) return;
+    fprintf(out, "Monitor overhead over %.1fs on %s: %.3f%% CPU (%.3fs), %.1f wakeups/s\n", dt,
+        cpu_name(lp, buf, sizeof(buf)),
+        (cpu_time - lp->start_cpu_time) * 100. / dt, cpu_time - lp->start_cpu_time,
+        (wakeups - lp->start_wakeups) / dt);
+}
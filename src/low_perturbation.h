@@ -0,0 +1,71 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef LOW_PERTURBATION_H
+#define LOW_PERTURBATION_H
+
+#include <stdio.h>
+
+#include "pm_frame.h"
+#include "readinfo.h"
+#include "cpu_topology.h"
+
+/**
+ * Low-perturbation sampling. The monitor's own wakeups keep the core it runs
+ * on out of C6, which skews the residencies it shows. This keeps them on one
+ * core, lets the kernel coalesce the timer with others and writes each frame
+ * with a single write. It also measures what the monitor still costs.
+ **/
+
+#define LOWPERT_SLACK_FRACTION 0.1          //Timer slack as a fraction of the update interval
+#define LOWPERT_MAX_SLACK_S    0.1
+#define LOWPERT_OUTPUT_BUFFER  (256 * 1024) //Holds a whole screen
+
+typedef struct {
+    int cpu;                        //Linux CPU the monitor is pinned to. -1 if not pinned
+    int core;                       //PM table core of that CPU. -1 if unknown
+    double start_time, start_cpu_time;
+    long start_wakeups;
+    double last_time, last_cpu_time;
+    long last_wakeups;
+
+    //Last interval
+    double cpu_percent;             //Own CPU time in % of one CPU
+    double wakeups_per_s;           //Voluntary context switches, each is a sleep and a wakeup
+    float core_power;               //Of the monitor's core. NAN if unknown
+    float others_power;             //Mean of the other enabled cores
+} low_perturbation;
+
+//Enabled core with the least C6 residency in the frame. It is awake most anyway. -1 if unknown.
+int low_perturbation_pick_core(pm_frame *frame, system_info *sysinfo);
+
+//Pins the monitor to cpu (-1: the first thread of core, or the current CPU), sets the timer
+//slack for the update interval and buffers stdout. Returns 0 if pinning failed.
+int low_perturbation_init(low_perturbation *lp, int cpu, int core, cpu_topology *topo, double interval_s);
+
+//Nobody watches if stdout is a terminal that belongs to another process group, e.g. in the background.
+int low_perturbation_watched();
+
+//Measures the last interval. frame may be NULL if no frame is decoded.
+void low_perturbation_update(low_perturbation *lp, pm_frame *frame, system_info *sysinfo);
+void low_perturbation_print(low_perturbation *lp, FILE *out);
+//Totals since init
+void low_perturbation_summary(low_perturbation *lp, FILE *out);
+
+#endif
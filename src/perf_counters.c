@@ -0,0 +1,195 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/**
+ * Per CPU hardware counters via perf_event_open.
+ *
+ * The counters of a CPU form one group, so all of them are read with a single
+ * read() of the group leader (PERF_FORMAT_GROUP) at the same instant.
+ **/
+
+#define _GNU_SOURCE
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "perf_counters.h"
+
+//Layout of a group read: nr, time_enabled, time_running, values[nr]
+#define PERF_READ_HEADER 3
+
+static const unsigned long long perf_event_configs[PERF_EV_COUNT] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES
+};
+
+//fds of one CPU in event_fd
+#define perf_group_fds(pc, cpu) ((pc)->event_fd + (cpu) * (pc)->num_events)
+
+static void close_group(int *fds, int n) {
+    int i;
+
+    for (i = 0; i < n; i++) {
+        if (fds[i] >= 0) close(fds[i]);
+        fds[i] = -1;
+    }
+}
+
+static int perf_event_open(struct perf_event_attr *attr, int cpu, int group_fd) {
+    return syscall(__NR_perf_event_open, attr, -1, cpu, group_fd, 0);
+}
+
+//Opens the events of one CPU into fds. Returns 0 and leaves fds at -1 if any of them fails.
+static int open_group(int cpu, int num_events, int *fds) {
+    struct perf_event_attr attr;
+    int i;
+
+    for (i = 0; i < num_events; i++) {
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = perf_event_configs[i];
+        attr.disabled = (i == 0);
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        //Every member is an fd of its own, closing the leader doesn't release them
+        fds[i] = perf_event_open(&attr, cpu, i ? fds[0] : -1);
+        if (fds[i] < 0) {
+            close_group(fds, i);
+            return 0;
+        }
+    }
+
+    ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+
+    return 1;
+}
+
+int perf_counters_init(perf_counters *pc, cpu_topology *topo, int with_cache_misses) {
+    int cpu, i, opened = 0;
+
+    memset(pc, 0, sizeof(perf_counters));
+    pc->num_cpus = topo->num_cpus;
+    pc->num_events = with_cache_misses ? 3 : 2;
+
+    pc->event_fd = malloc(pc->num_cpus * pc->num_events * sizeof(int));
+    if (pc->event_fd)
+        for (i = 0; i < pc->num_cpus * pc->num_events; i++) pc->event_fd[i] = -1;
+    pc->buf = malloc((PERF_READ_HEADER + pc->num_events) * sizeof(unsigned long long));
+    pc->prev = calloc(pc->num_cpus * (2 + pc->num_events), sizeof(unsigned long long));
+    pc->delta = calloc(pc->num_cpus * (1 + pc->num_events), sizeof(double));
+    if (!pc->event_fd || !pc->buf || !pc->prev || !pc->delta) {
+        perf_counters_free(pc);
+        return 0;
+    }
+
+    for (cpu = 0; cpu < pc->num_cpus; cpu++) {
+        if (topo->cpu_to_core[cpu] < 0) continue;
+        opened += open_group(cpu, pc->num_events, perf_group_fds(pc, cpu));
+    }
+
+    if (opened) perf_counters_read(pc); //Reference for the first interval
+
+    return opened;
+}
+
+void perf_counters_free(perf_counters *pc) {
+    int cpu;
+
+    if (pc->event_fd) {
+        for (cpu = 0; cpu < pc->num_cpus; cpu++) close_group(perf_group_fds(pc, cpu), pc->num_events);
+    }
+    free(pc->event_fd);
+    free(pc->buf);
+    free(pc->prev);
+    free(pc->delta);
+    memset(pc, 0, sizeof(perf_counters));
+}
+
+int perf_counters_read(perf_counters *pc) {
+    unsigned long long *prev, enabled, running;
+    ssize_t len;
+    double *delta, scale;
+    int cpu, i, ok = 0;
+
+    len = (PERF_READ_HEADER + pc->num_events) * sizeof(unsigned long long);
+
+    for (cpu = 0; cpu < pc->num_cpus; cpu++) {
+        if (perf_group_fds(pc, cpu)[0] < 0) continue;
+        if (read(perf_group_fds(pc, cpu)[0], pc->buf, len) != len) continue;
+
+        prev = pc->prev + cpu * (2 + pc->num_events);
+        delta = pc->delta + cpu * (1 + pc->num_events);
+
+        enabled = pc->buf[1] - prev[0];
+        running = pc->buf[2] - prev[1];
+        //Scale up if the counters were multiplexed with other users of the PMU
+        scale = running ? (double)enabled / running : 0;
+
+        delta[0] = enabled * 1e-9;
+        for (i = 0; i < pc->num_events; i++) {
+            delta[1 + i] = (pc->buf[PERF_READ_HEADER + i] - prev[2 + i]) * scale;
+            prev[2 + i] = pc->buf[PERF_READ_HEADER + i];
+        }
+        prev[0] = pc->buf[1];
+        prev[1] = pc->buf[2];
+        ok++;
+    }
+
+    return ok;
+}
+
+int perf_counters_core_metrics(perf_counters *pc, cpu_topology *topo, int core, float core_power,
+    perf_core_metrics *m) {
+    double cycles, instructions, misses, seconds, freq, *delta;
+    int i, cpu, n;
+
+    cycles = instructions = misses = seconds = freq = 0;
+    n = 0;
+    for (i = 0; i < topo->threads_per_core; i++) {
+        cpu = cpu_topology_core_cpu(topo, core, i);
+        if (cpu < 0 || cpu >= pc->num_cpus || perf_group_fds(pc, cpu)[0] < 0) continue;
+
+        delta = pc->delta + cpu * (1 + pc->num_events);
+        if (delta[0] <= 0) continue;
+
+        seconds = delta[0];
+        cycles += delta[1 + PERF_EV_CYCLES];
+        instructions += delta[1 + PERF_EV_INSTRUCTIONS];
+        if (pc->num_events > PERF_EV_CACHE_MISSES) misses += delta[1 + PERF_EV_CACHE_MISSES];
+        if (freq < delta[1 + PERF_EV_CYCLES] / delta[0]) freq = delta[1 + PERF_EV_CYCLES] / delta[0];
+        n++;
+    }
+    if (!n) return 0;
+
+    m->ipc = cycles > 0 ? instructions / cycles : 0;
+    m->instr_per_joule = core_power > 0 ? instructions / (core_power * seconds) : NAN;
+    m->cycle_freq = freq / 1e6;
+    m->mpki = pc->num_events > PERF_EV_CACHE_MISSES && instructions > 0 ? misses / instructions * 1000 : NAN;
+
+    return 1;
+}
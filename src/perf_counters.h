@@ -0,0 +1,61 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include "cpu_topology.h"
+
+enum {
+    PERF_EV_CYCLES,
+    PERF_EV_INSTRUCTIONS,
+    PERF_EV_CACHE_MISSES,
+    PERF_EV_COUNT
+};
+
+typedef struct {
+    int num_cpus;
+    int num_events;             //2, or 3 with cache misses
+    int *event_fd;              //num_events per Linux CPU, the group leader first. -1 if not open
+    unsigned long long *buf;    //Read buffer for one group
+    unsigned long long *prev;   //Last raw values per CPU: time_enabled, time_running, events...
+    double *delta;              //Per CPU: seconds, then the scaled event deltas of the last interval
+} perf_counters;
+
+typedef struct {
+    float ipc;                  //Instructions per cycle of the core: all instructions / all cycles of its threads
+    float instr_per_joule;      //Using the core power from the PM table
+    float cycle_freq;           //MHz. Unhalted cycles per second of the busiest thread
+    float mpki;                 //Cache misses per 1000 instructions. NAN if not counted
+} perf_core_metrics;
+
+//Opens one counter group (cycles, instructions and optionally cache misses) per online CPU.
+//Returns the number of CPUs with working counters.
+int perf_counters_init(perf_counters *pc, cpu_topology *topo, int with_cache_misses);
+void perf_counters_free(perf_counters *pc);
+
+//Reads all groups with one read() per CPU. Call right after reading the PM table, so both cover
+//the same interval.
+int perf_counters_read(perf_counters *pc);
+
+//Derives the metrics of a PM table core from the last interval. Returns 0 if there is no data.
+int perf_counters_core_metrics(perf_counters *pc, cpu_topology *topo, int core, float core_power,
+    perf_core_metrics *m);
+
+#endif
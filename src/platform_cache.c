@@ -0,0 +1,140 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "platform_cache.h"
+
+#define BOOT_ID_PATH "/proc/sys/kernel/random/boot_id"
+
+static int read_boot_id(char *boot_id) {
+    ssize_t len;
+    int fd;
+
+    memset(boot_id, 0, PLATFORM_CACHE_BOOT_ID);
+    fd = open(BOOT_ID_PATH, O_RDONLY);
+    if (fd < 0) return 0;
+    len = read(fd, boot_id, PLATFORM_CACHE_BOOT_ID - 1);
+    close(fd);
+    if (len <= 0) return 0;
+    if (boot_id[len - 1] == '\n') boot_id[len - 1] = 0;
+
+    return 1;
+}
+
+int platform_cache_load(platform_cache *c) {
+    char boot_id[PLATFORM_CACHE_BOOT_ID];
+    int fd, ok;
+
+    ok = read_boot_id(boot_id);
+    fd = open(PLATFORM_CACHE_PATH, O_RDONLY);
+    if (ok && fd >= 0) {
+        ok = read(fd, c, sizeof(platform_cache)) == sizeof(platform_cache) &&
+            !memcmp(c->magic, PLATFORM_CACHE_MAGIC, sizeof(PLATFORM_CACHE_MAGIC)) &&
+            c->format == PLATFORM_CACHE_FORMAT && !memcmp(c->boot_id, boot_id, sizeof(boot_id));
+    }
+    else ok = 0;
+    if (fd >= 0) close(fd);
+    if (ok) return 1;
+
+    memset(c, 0, sizeof(platform_cache));
+    strcpy(c->magic, PLATFORM_CACHE_MAGIC);
+    c->format = PLATFORM_CACHE_FORMAT;
+    memcpy(c->boot_id, boot_id, sizeof(boot_id));
+
+    return 0;
+}
+
+void platform_cache_save(platform_cache *c) {
+    char tmp[sizeof(PLATFORM_CACHE_PATH) + 16];
+    int fd, ok;
+
+    //Without a boot id the cache could never be validated
+    if (!c->boot_id[0]) return;
+
+    //Written to a temporary file and renamed, so concurrent launches never see half a cache
+    snprintf(tmp, sizeof(tmp), "%s.%d", PLATFORM_CACHE_PATH, (int)getpid());
+    fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return;
+    ok = write(fd, c, sizeof(platform_cache)) == sizeof(platform_cache);
+    close(fd);
+    if (!ok || rename(tmp, PLATFORM_CACHE_PATH)) unlink(tmp);
+}
+
+void platform_cache_set_smu(platform_cache *c, smu_obj_t *obj) {
+    smu_get_static_info(obj, &c->smu);
+}
+
+void platform_cache_set_topology(platform_cache *c, system_info *sysinfo, unsigned int pm_table_version,
+    unsigned int zen_version) {
+    unsigned int words;
+
+    words = (sysinfo->core_disable_map_size + 31) / 32;
+    if (words > PLATFORM_CACHE_MAP_WORDS) {
+        c->has_topology = 0;
+        return;
+    }
+    c->has_topology = 1;
+    c->pm_table_version = pm_table_version;
+    c->zen_version = zen_version;
+    memcpy(c->cpu_name, sysinfo->cpu_name, sizeof(c->cpu_name));
+    c->cores = sysinfo->cores;
+    c->ccds = sysinfo->ccds;
+    c->ccxs = sysinfo->ccxs;
+    c->cores_per_ccx = sysinfo->cores_per_ccx;
+    memset(c->core_disable_map, 0, sizeof(c->core_disable_map));
+    if (words) memcpy(c->core_disable_map, sysinfo->core_disable_map, words * sizeof(unsigned int));
+    c->core_disable_map_size = sysinfo->core_disable_map_size;
+    c->core_disable_map_pmt = sysinfo->core_disable_map_pmt;
+    c->enabled_cores_count = sysinfo->enabled_cores_count;
+}
+
+int platform_cache_get_topology(platform_cache *c, system_info *sysinfo, unsigned int pm_table_version,
+    unsigned int zen_version) {
+    unsigned int words;
+
+    if (!c->has_topology || c->pm_table_version != pm_table_version || c->zen_version != zen_version)
+        return 0;
+
+    //A corrupted cache must not make us read past core_disable_map
+    if (c->core_disable_map_size > PLATFORM_CACHE_MAP_WORDS * 32) return 0;
+    words = (c->core_disable_map_size + 31) / 32;
+    free_core_disable_map(sysinfo);
+    if (words) {
+        sysinfo->core_disable_map = malloc(words * sizeof(unsigned int));
+        if (!sysinfo->core_disable_map) return 0;
+        memcpy(sysinfo->core_disable_map, c->core_disable_map, words * sizeof(unsigned int));
+    }
+    sysinfo->core_disable_map_size = c->core_disable_map_size;
+    memcpy(sysinfo->cpu_name, c->cpu_name, sizeof(sysinfo->cpu_name));
+    sysinfo->cpu_name[sizeof(sysinfo->cpu_name) - 1] = 0;
+    sysinfo->cores = c->cores;
+    sysinfo->ccds = c->ccds;
+    sysinfo->ccxs = c->ccxs;
+    sysinfo->cores_per_ccx = c->cores_per_ccx;
+    sysinfo->core_disable_map_pmt = c->core_disable_map_pmt;
+    sysinfo->enabled_cores_count = c->enabled_cores_count;
+    sysinfo->available = 1;
+
+    return 1;
+}
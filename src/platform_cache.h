@@ -0,0 +1,76 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef PLATFORM_CACHE_H
+#define PLATFORM_CACHE_H
+
+#include <stdint.h>
+#include <libsmu.h>
+
+#include "readinfo.h"
+
+/**
+ * Cache of the static platform information, so a launch doesn't have to parse
+ * the driver files, run CPUID and read the fuses over SMN again. Everything in
+ * it is fixed until the next boot, so it is keyed by the boot id. libsmu checks
+ * that the driver was not reloaded in between.
+ **/
+
+#define PLATFORM_CACHE_PATH      "/run/ryzen_monitor.cache"
+#define PLATFORM_CACHE_MAGIC     "RYZMPC"
+#define PLATFORM_CACHE_FORMAT    1
+#define PLATFORM_CACHE_MAP_WORDS 8      //Up to 256 cores
+#define PLATFORM_CACHE_BOOT_ID   40
+
+typedef struct {
+    char magic[8];
+    uint32_t format;
+    char boot_id[PLATFORM_CACHE_BOOT_ID];
+    smu_static_info smu;
+
+    //Topology, valid if has_topology. It depends on the PM table the monitor uses.
+    uint32_t has_topology;
+    uint32_t pm_table_version;
+    uint32_t zen_version;
+    char cpu_name[PROCESSOR_NAME_LEN];
+    uint32_t cores;
+    uint32_t ccds;
+    uint32_t ccxs;
+    uint32_t cores_per_ccx;
+    uint32_t core_disable_map[PLATFORM_CACHE_MAP_WORDS];
+    uint32_t core_disable_map_size;
+    uint32_t core_disable_map_pmt;
+    uint32_t enabled_cores_count;
+} platform_cache;
+
+//Returns 1 if the cache exists and belongs to this boot. Otherwise c is cleared
+//and set up to be filled for this boot.
+int platform_cache_load(platform_cache *c);
+//Writes the cache. Failures are ignored, the cache only saves time.
+void platform_cache_save(platform_cache *c);
+
+void platform_cache_set_smu(platform_cache *c, smu_obj_t *obj);
+//Topology of sysinfo as set up by get_processor_topology for this PM table.
+void platform_cache_set_topology(platform_cache *c, system_info *sysinfo, unsigned int pm_table_version,
+    unsigned int zen_version);
+//Fills the topology into sysinfo. Returns 0 if the cache has none for this PM table.
+int platform_cache_get_topology(platform_cache *c, system_info *sysinfo, unsigned int pm_table_version,
+    unsigned int zen_version);
+
+#endif
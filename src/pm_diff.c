@@ -0,0 +1,425 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/**
+ * Field level diff of PM table dumps and recordings.
+ *
+ * Each side is reduced to per slot statistics first: a dump is one frame, a
+ * recording range is averaged over all of its frames. The frames of a
+ * recording are contiguous in the mapped file, so the accumulation runs
+ * with AVX2 or SSE2 over one frame at a time and is bound by the memory
+ * bandwidth rather than by the number of frames. The means of both sides
+ * are then compared slot by slot. Slots are named through the layout of
+ * the recording or of -f where it has a field, raw offsets are shown
+ * otherwise.
+ **/
+
+#include <math.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/stat.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "pm_diff.h"
+#include "pm_tables.h"
+#include "pm_selection.h"
+#include "recording.h"
+
+#define DIFF_ALIGN      32
+#define DIFF_NAME_LEN   48
+#define DIFF_PROBE_SLOTS 16384  //Larger than every layout, so select_pm_table_version never points outside
+
+typedef struct {
+    unsigned int slot;
+    double a, b;            //Means
+    double sd_a, sd_b;
+    double delta, rel;      //rel is NAN if a is 0
+    int not_float;
+} diff_entry;
+
+static void* alloc_aligned(size_t size) {
+    void *p;
+
+    if (posix_memalign(&p, DIFF_ALIGN, size)) return NULL;
+    memset(p, 0, size);
+    return p;
+}
+
+int diff_side_init(diff_side *s, unsigned int num_slots) {
+    size_t n = num_slots;
+
+    memset(s, 0, sizeof(diff_side));
+    s->num_slots = num_slots;
+    s->sum = alloc_aligned(n * sizeof(double));
+    s->sq  = alloc_aligned(n * sizeof(double));
+    s->ref = alloc_aligned(n * sizeof(double));
+    s->raw = malloc(n * sizeof(uint32_t));
+
+    return s->sum && s->sq && s->ref && s->raw;
+}
+
+void diff_side_free(diff_side *s) {
+    free(s->sum);
+    free(s->sq);
+    free(s->ref);
+    free(s->raw);
+    memset(s, 0, sizeof(diff_side));
+}
+
+//The kernels add one frame to the accumulators and return the number of slots done. The rest is
+//left to the scalar loop. Frames in a recording are only 4 byte aligned.
+#if defined(__AVX2__)
+static unsigned int accumulate_kernel(const float *frame, diff_side *s) {
+    __m256 x;
+    __m256d lo, hi;
+    unsigned int j;
+
+    for (j = 0; j + 8 <= s->num_slots; j += 8) {
+        x = _mm256_loadu_ps(frame + j);
+        lo = _mm256_sub_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(x)), _mm256_load_pd(s->ref + j));
+        hi = _mm256_sub_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(x, 1)), _mm256_load_pd(s->ref + j + 4));
+        _mm256_store_pd(s->sum + j,     _mm256_add_pd(_mm256_load_pd(s->sum + j), lo));
+        _mm256_store_pd(s->sum + j + 4, _mm256_add_pd(_mm256_load_pd(s->sum + j + 4), hi));
+        _mm256_store_pd(s->sq + j,      _mm256_add_pd(_mm256_load_pd(s->sq + j), _mm256_mul_pd(lo, lo)));
+        _mm256_store_pd(s->sq + j + 4,  _mm256_add_pd(_mm256_load_pd(s->sq + j + 4), _mm256_mul_pd(hi, hi)));
+    }
+
+    return j;
+}
+#elif defined(__SSE2__)
+static unsigned int accumulate_kernel(const float *frame, diff_side *s) {
+    __m128 x;
+    __m128d lo, hi;
+    unsigned int j;
+
+    for (j = 0; j + 4 <= s->num_slots; j += 4) {
+        x = _mm_loadu_ps(frame + j);
+        lo = _mm_sub_pd(_mm_cvtps_pd(x), _mm_load_pd(s->ref + j));
+        hi = _mm_sub_pd(_mm_cvtps_pd(_mm_movehl_ps(x, x)), _mm_load_pd(s->ref + j + 2));
+        _mm_store_pd(s->sum + j,     _mm_add_pd(_mm_load_pd(s->sum + j), lo));
+        _mm_store_pd(s->sum + j + 2, _mm_add_pd(_mm_load_pd(s->sum + j + 2), hi));
+        _mm_store_pd(s->sq + j,      _mm_add_pd(_mm_load_pd(s->sq + j), _mm_mul_pd(lo, lo)));
+        _mm_store_pd(s->sq + j + 2,  _mm_add_pd(_mm_load_pd(s->sq + j + 2), _mm_mul_pd(hi, hi)));
+    }
+
+    return j;
+}
+#else
+static unsigned int accumulate_kernel(const float *frame, diff_side *s) {
+    return 0;
+}
+#endif
+
+void diff_side_add(diff_side *s, const unsigned char *frame) {
+    const float *f = (const float*)frame;
+    unsigned int j;
+    double x;
+
+    if (!s->frames) {
+        memcpy(s->raw, frame, s->num_slots * sizeof(uint32_t));
+        for (j = 0; j < s->num_slots; j++) s->ref[j] = isfinite(f[j]) ? f[j] : 0;
+    }
+
+    for (j = accumulate_kernel(f, s); j < s->num_slots; j++) {
+        x = f[j] - s->ref[j];
+        s->sum[j] += x;
+        s->sq[j] += x * x;
+    }
+    s->frames++;
+}
+
+static int load_dump(diff_side *s, const char *path) {
+    unsigned char *buf;
+    struct stat st;
+    int fd, ok;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) || st.st_size < (off_t)sizeof(float)) {
+        if (fd >= 0) close(fd);
+        return 0;
+    }
+    buf = malloc(st.st_size);
+    ok = buf && read(fd, buf, st.st_size) == st.st_size;
+    close(fd);
+    if (ok) ok = diff_side_init(s, st.st_size / sizeof(float));
+    if (ok) diff_side_add(s, buf);
+    free(buf);
+
+    return ok;
+}
+
+int diff_side_load(diff_side *s, const char *path, double start_s, double end_s) {
+    uint64_t first, last, i;
+    recording r;
+
+    memset(s, 0, sizeof(diff_side));
+    if (!recording_open(&r, path)) {
+        if (start_s >= 0 || end_s >= 0) {
+            fprintf(stderr, "\"%s\" is no recording. Time ranges only work with recordings.\n", path);
+            return 0;
+        }
+        return load_dump(s, path);
+    }
+
+    first = start_s >= 0 ? recording_find(&r, r.header.start_ns + (uint64_t)(start_s * 1e9)) : 0;
+    last = end_s >= 0 ? recording_find(&r, r.header.start_ns + (uint64_t)(end_s * 1e9)) : r.frames;
+    if (first >= last) {
+        fprintf(stderr, "\"%s\" has no frames in the given time range.\n", path);
+        recording_free(&r);
+        return 0;
+    }
+    if (!diff_side_init(s, r.header.pm_table_size / sizeof(float))) {
+        recording_free(&r);
+        return 0;
+    }
+    s->version = r.header.pm_table_version;
+    for (i = first; i < last; i++) diff_side_add(s, recording_table(&r, i));
+    recording_free(&r);
+
+    return 1;
+}
+
+//"file", "file@start:end", "file@start:" or "file@:end" with seconds since the start of the recording.
+//A file that exists under the full name wins, so names containing @ still work.
+int diff_side_load_spec(diff_side *s, const char *spec) {
+    double start_s = -1, end_s = -1;
+    char path[4096], *at, *colon;
+    struct stat st;
+
+    snprintf(path, sizeof(path), "%s", spec);
+    at = strrchr(path, '@');
+    if (at && stat(path, &st)) {
+        *at++ = 0;
+        colon = strchr(at, ':');
+        if (!colon) {
+            fprintf(stderr, "Invalid time range \"%s\". Use <start>:<end> in seconds.\n", at);
+            return 0;
+        }
+        *colon++ = 0;
+        if (*at) start_s = atof(at);
+        if (*colon) end_s = atof(colon);
+    }
+
+    if (!diff_side_load(s, path, start_s, end_s)) {
+        fprintf(stderr, "Could not read \"%s\".\n", spec);
+        return 0;
+    }
+
+    return 1;
+}
+
+//Names of the slots the layout of version has a field for. NULL where it has none.
+static char** slot_names(unsigned int version, unsigned int num_slots) {
+    char **names, name[DIFF_NAME_LEN];
+    const float *p;
+    float *probe;
+    pm_table pmt;
+    int f, e, n;
+
+    probe = calloc(num_slots > DIFF_PROBE_SLOTS ? num_slots : DIFF_PROBE_SLOTS, sizeof(float));
+    names = calloc(num_slots, sizeof(char*));
+    if (!probe || !names || !select_pm_table_version(version, &pmt, (unsigned char*)probe)) {
+        free(probe);
+        free(names);
+        return NULL;
+    }
+
+    for (f = 0; f < PMT_NUM_FIELDS; f++) {
+        n = pm_field_length(&pmt, f);
+        for (e = 0; e < n; e++) {
+            p = pm_field_element(&pmt, f, e);
+            if (!p || p < probe || p - probe >= num_slots || names[p - probe]) continue;
+            if (pm_fields[f].kind == PMT_FIELD_SCALAR) snprintf(name, sizeof(name), "%s", pm_fields[f].name);
+            else snprintf(name, sizeof(name), "%s[%d]", pm_fields[f].name, e);
+            names[p - probe] = strdup(name);
+        }
+    }
+    pm_table_free(&pmt);
+    free(probe);
+
+    return names;
+}
+
+static void side_stats(const diff_side *s, unsigned int j, double *mean, double *sd) {
+    double var;
+
+    *mean = s->sum[j] / s->frames;
+    var = s->sq[j] / s->frames - *mean * *mean;
+    *sd = var > 0 ? sqrt(var) : 0;
+    *mean += s->ref[j];
+}
+
+void diff_side_mean(const diff_side *s, float *out) {
+    double mean, sd;
+    unsigned int j;
+
+    for (j = 0; j < s->num_slots; j++) {
+        side_stats(s, j, &mean, &sd);
+        if (isfinite(mean)) out[j] = mean;
+        else memcpy(&out[j], &s->raw[j], sizeof(float));
+    }
+}
+
+static int compare_rel(const void *a, const void *b) {
+    const diff_entry *x = a, *y = b;
+    double rx = isnan(x->rel) ? INFINITY : fabs(x->rel);
+    double ry = isnan(y->rel) ? INFINITY : fabs(y->rel);
+
+    if (x->not_float != y->not_float) return x->not_float - y->not_float;
+    if (rx != ry) return rx < ry ? 1 : -1;
+    if (fabs(x->delta) != fabs(y->delta)) return fabs(x->delta) < fabs(y->delta) ? 1 : -1;
+    return x->slot - y->slot;
+}
+
+static void print_entry(FILE *out, const diff_entry *d, char **names, int show_sd) {
+    char a[32], b[32];
+
+    fprintf(out, "0x%04x %5u  %-28s", d->slot * 4, d->slot, names && names[d->slot] ? names[d->slot] : "-");
+    if (d->not_float) {
+        fprintf(out, " %14s %14s  not a float\n", "", "");
+        return;
+    }
+    snprintf(a, sizeof(a), "%.6g", d->a);
+    snprintf(b, sizeof(b), "%.6g", d->b);
+    fprintf(out, " %14s %14s %+14.6g", a, b, d->delta);
+    if (isnan(d->rel)) fprintf(out, " %9s", "-");
+    else fprintf(out, " %+8.2f%%", d->rel * 100);
+    if (show_sd) fprintf(out, " %12.4g %12.4g", d->sd_a, d->sd_b);
+    fprintf(out, "\n");
+}
+
+static void print_usage(FILE *out) {
+    fprintf(out,
+        "Usage: ryzen_monitor [-f<hex-value>] [-l<path>] diff [-e<delta>] [-E<percent>] [-s] [-n<N>] <a> <b>\n\n"
+        "a and b are raw dumps or recordings made with -r. A recording can be limited to a time range\n"
+        "in seconds since its start with file@start:end, either end may be left out.\n\n"
+        "\t-e<delta>   - Only report slots whose mean changed by more than this. Defaults to 0.\n"
+        "\t-E<percent> - Only report slots whose mean changed by more than this percentage.\n"
+        "\t-s          - Sort by relative change instead of by offset.\n"
+        "\t-n<N>       - Only report the first N slots.\n");
+}
+
+int run_diff(int argc, char **argv, unsigned int version, FILE *out) {
+    double min_delta = 0, min_rel = 0, sum_abs = 0, sum_rel = 0;
+    unsigned int j, num_slots, changed = 0, up = 0, down = 0, not_float = 0, named = 0, rel_count = 0;
+    int c, sort_rel = 0, limit = -1, show_sd, k;
+    diff_entry *entries, d;
+    diff_side a, b;
+    char **names;
+
+    optind = 1;
+    while ((c = getopt(argc, argv, "+e:E:sn:h")) != -1) {
+        switch (c) {
+            case 'e': min_delta = fabs(atof(optarg)); break;
+            case 'E': min_rel = fabs(atof(optarg)) / 100; break;
+            case 's': sort_rel = 1; break;
+            case 'n': limit = atoi(optarg); break;
+            case 'h': print_usage(stdout); return 0;
+            default:  print_usage(stderr); return 1;
+        }
+    }
+    if (argc - optind != 2) {
+        print_usage(stderr);
+        return 1;
+    }
+
+    if (!diff_side_load_spec(&a, argv[optind]) || !diff_side_load_spec(&b, argv[optind + 1])) return 1;
+
+    num_slots = a.num_slots < b.num_slots ? a.num_slots : b.num_slots;
+    if (a.num_slots != b.num_slots)
+        fprintf(stderr, "The tables differ in size (%u and %u bytes). Comparing the first %u bytes.\n",
+            a.num_slots * 4, b.num_slots * 4, num_slots * 4);
+    if (a.version && b.version && a.version != b.version)
+        fprintf(stderr, "The recordings have different PM Table versions (0x%x and 0x%x).\n", a.version, b.version);
+
+    if (!version) version = a.version ? a.version : b.version;
+    names = version ? slot_names(version, num_slots) : NULL;
+    if (version && !names) fprintf(stderr, "PM Table version 0x%x is not supported. Showing raw offsets only.\n", version);
+
+    entries = malloc(num_slots * sizeof(diff_entry));
+    if (!entries) {
+        fprintf(stderr, "Could not allocate memory for the diff.\n");
+        exit(0);
+    }
+
+    for (j = 0, k = 0; j < num_slots; j++) {
+        memset(&d, 0, sizeof(diff_entry));
+        d.slot = j;
+        side_stats(&a, j, &d.a, &d.sd_a);
+        side_stats(&b, j, &d.b, &d.sd_b);
+
+        //Integers, flags and garbage that don't make a finite float are compared bitwise
+        if (!isfinite(d.a) || !isfinite(d.b)) {
+            if (a.raw[j] == b.raw[j]) continue;
+            d.not_float = 1;
+            not_float++;
+        }
+        else {
+            d.delta = d.b - d.a;
+            d.rel = d.a != 0 ? d.delta / fabs(d.a) : NAN;
+            if (d.delta == 0 || fabs(d.delta) <= min_delta) continue;
+            if (min_rel > 0 && !isnan(d.rel) && fabs(d.rel) <= min_rel) continue;
+            if (d.delta > 0) up++;
+            else down++;
+            sum_abs += fabs(d.delta);
+            if (!isnan(d.rel)) {
+                sum_rel += fabs(d.rel);
+                rel_count++;
+            }
+        }
+        if (names && names[j]) named++;
+        entries[k++] = d;
+    }
+    changed = k;
+    if (sort_rel) qsort(entries, changed, sizeof(diff_entry), compare_rel);
+
+    show_sd = a.frames > 1 || b.frames > 1;
+    fprintf(out, "# a: %s, %llu frame%s\n", argv[optind], (unsigned long long)a.frames, a.frames == 1 ? "" : "s");
+    fprintf(out, "# b: %s, %llu frame%s\n", argv[optind + 1], (unsigned long long)b.frames, b.frames == 1 ? "" : "s");
+    if (names) fprintf(out, "# Named with PM Table version 0x%x\n", version);
+    fprintf(out, "# %u of %u slots changed (%u named): %u up, %u down, %u not a float\n",
+        changed, num_slots, named, up, down, not_float);
+    if (up + down)
+        fprintf(out, "# Mean |delta| %.6g, mean |relative delta| %.2f%%\n",
+            sum_abs / (up + down), rel_count ? sum_rel / rel_count * 100 : 0.);
+    if (changed) {
+        fprintf(out, "%-6s %5s  %-28s %14s %14s %14s %9s", "offset", "index", "field", "a", "b", "delta", "relative");
+        if (show_sd) fprintf(out, " %12s %12s", "sd a", "sd b");
+        fprintf(out, "\n");
+    }
+    for (j = 0; j < changed && (limit < 0 || j < (unsigned int)limit); j++)
+        print_entry(out, &entries[j], names, show_sd);
+
+    if (names) {
+        for (j = 0; j < num_slots; j++) free(names[j]);
+        free(names);
+    }
+    free(entries);
+    diff_side_free(&a);
+    diff_side_free(&b);
+
+    return 0;
+}
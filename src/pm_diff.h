@@ -0,0 +1,52 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef PM_DIFF_H
+#define PM_DIFF_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+typedef struct {
+    unsigned int version;       //PM table version of a recording. 0 for dumps
+    unsigned int num_slots;
+    uint64_t frames;
+    double *sum, *sq;           //Sums over all frames, relative to ref
+    double *ref;                //First frame. Keeps the variance of static slots from cancelling out.
+    uint32_t *raw;              //First frame as is. Compared for slots that are no float.
+} diff_side;
+
+int diff_side_init(diff_side *s, unsigned int num_slots);
+//Adds one raw PM table of num_slots floats
+void diff_side_add(diff_side *s, const unsigned char *frame);
+//Per slot means. Slots that are no float get the raw value of the first frame.
+void diff_side_mean(const diff_side *s, float *out);
+
+//Reads a dump or the frames of a recording between start_s and end_s (seconds since the
+//start of the recording, negative for open ends). Returns 0 on errors.
+int diff_side_load(diff_side *s, const char *path, double start_s, double end_s);
+//Like diff_side_load for "file" or "file@start:end". Reports errors to stderr.
+int diff_side_load_spec(diff_side *s, const char *spec);
+void diff_side_free(diff_side *s);
+
+//The diff subcommand. argv[0] is "diff". version names the slots if not 0, otherwise
+//the version of the recordings is used.
+int run_diff(int argc, char **argv, unsigned int version, FILE *out);
+
+#endif
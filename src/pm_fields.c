@@ -0,0 +1,49 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <stddef.h>
+#include <string.h>
+
+#include "pm_tables.h"
+
+#define PMT_FIELD_ENTRY(name, kind, count, unit, category) \
+    { #name, unit, offsetof(pm_table, name), PMT_FIELD_##kind, PMT_CAT_##category, count },
+
+const pm_field pm_fields[PMT_NUM_FIELDS] = {
+    PM_TABLE_FIELDS(PMT_FIELD_ENTRY)
+};
+
+const char * const pm_field_category_names[PMT_NUM_CATEGORIES] = {
+    "limits", "power", "voltage", "current", "temperature", "clock", "residency", "core", "l3", "graphics", "other"
+};
+
+int pm_field_lookup_len(const char *name, unsigned int len) {
+    unsigned int seed;
+    int i;
+
+    seed = pm_field_hash_seeds[pm_field_hash(name, len, 0) % PMT_HASH_BUCKETS];
+    i = pm_field_hash_slots[pm_field_hash(name, len, seed) % PMT_HASH_SLOTS];
+    if (i < 0 || strncmp(pm_fields[i].name, name, len) || pm_fields[i].name[len]) return -1;
+
+    return i;
+}
+
+int pm_field_lookup(const char *name) {
+    return pm_field_lookup_len(name, strlen(name));
+}
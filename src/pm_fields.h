@@ -0,0 +1,427 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef pm_fields_h
+#define pm_fields_h
+
+// All fields of pm_table in struct order. This is the only place where they are listed:
+// pm_tables.h declares the struct from it, pm_tables.c allocates the per core and L3 arrays
+// from it and pm_fields.c builds the registry used for lookups by name and field selection.
+//
+// X(name, kind, count, unit, category)
+//   kind:     SCALAR = float *, FIXED = float *[count],
+//             CORE = float ** with max_cores elements, L3 = float ** with max_l3 elements
+//   count:    Number of elements of FIXED arrays. 1 for scalars, 0 for CORE and L3.
+//   unit:     Unit of the value as far as known. Empty if not.
+//   category: Rough grouping for the exporters, see pm_field_category
+#define PM_TABLE_FIELDS(X) \
+    X(STAPM_LIMIT,               SCALAR, 1,                "W",   LIMITS) \
+    X(STAPM_VALUE,               SCALAR, 1,                "W",   LIMITS) \
+    X(PPT_LIMIT,                 SCALAR, 1,                "W",   LIMITS) \
+    X(PPT_VALUE,                 SCALAR, 1,                "W",   LIMITS) \
+    X(PPT_LIMIT_FAST,            SCALAR, 1,                "W",   LIMITS) \
+    X(PPT_VALUE_FAST,            SCALAR, 1,                "W",   LIMITS) \
+    X(PPT_LIMIT_APU,             SCALAR, 1,                "W",   LIMITS) \
+    X(PPT_VALUE_APU,             SCALAR, 1,                "W",   LIMITS) \
+    X(TDC_LIMIT,                 SCALAR, 1,                "A",   LIMITS) \
+    X(TDC_VALUE,                 SCALAR, 1,                "A",   LIMITS) \
+    X(TDC_LIMIT_SOC,             SCALAR, 1,                "A",   LIMITS) \
+    X(TDC_VALUE_SOC,             SCALAR, 1,                "A",   LIMITS) \
+    X(THM_LIMIT,                 SCALAR, 1,                "C",   LIMITS) \
+    X(THM_VALUE,                 SCALAR, 1,                "C",   LIMITS) \
+    X(THM_LIMIT_SOC,             SCALAR, 1,                "C",   LIMITS) \
+    X(THM_VALUE_SOC,             SCALAR, 1,                "C",   LIMITS) \
+    X(THM_LIMIT_GFX,             SCALAR, 1,                "C",   LIMITS) \
+    X(THM_VALUE_GFX,             SCALAR, 1,                "C",   LIMITS) \
+    X(STT_LIMIT_APU,             SCALAR, 1,                "",    LIMITS) \
+    X(STT_VALUE_APU,             SCALAR, 1,                "",    LIMITS) \
+    X(STT_LIMIT_DGPU,            SCALAR, 1,                "",    LIMITS) \
+    X(STT_VALUE_DGPU,            SCALAR, 1,                "",    LIMITS) \
+    X(FIT_LIMIT,                 SCALAR, 1,                "",    LIMITS) \
+    X(FIT_VALUE,                 SCALAR, 1,                "",    LIMITS) \
+    X(EDC_LIMIT,                 SCALAR, 1,                "A",   LIMITS) \
+    X(EDC_VALUE,                 SCALAR, 1,                "A",   LIMITS) \
+    X(EDC_LIMIT_SOC,             SCALAR, 1,                "A",   LIMITS) \
+    X(EDC_VALUE_SOC,             SCALAR, 1,                "A",   LIMITS) \
+    X(VID_LIMIT,                 SCALAR, 1,                "V",   LIMITS) \
+    X(VID_VALUE,                 SCALAR, 1,                "V",   LIMITS) \
+    X(PSI0_LIMIT_VDD,            SCALAR, 1,                "",    LIMITS) \
+    X(PSI0_RESIDENCY_VDD,        SCALAR, 1,                "%",   RESIDENCY) \
+    X(PSI0_LIMIT_SOC,            SCALAR, 1,                "",    LIMITS) \
+    X(PSI0_RESIDENCY_SOC,        SCALAR, 1,                "%",   RESIDENCY) \
+    X(PPT_WC,                    SCALAR, 1,                "W",   LIMITS) \
+    X(PPT_ACTUAL,                SCALAR, 1,                "W",   LIMITS) \
+    X(TDC_WC,                    SCALAR, 1,                "A",   LIMITS) \
+    X(TDC_ACTUAL,                SCALAR, 1,                "A",   LIMITS) \
+    X(THM_WC,                    SCALAR, 1,                "C",   LIMITS) \
+    X(THM_ACTUAL,                SCALAR, 1,                "C",   LIMITS) \
+    X(FIT_WC,                    SCALAR, 1,                "",    LIMITS) \
+    X(FIT_ACTUAL,                SCALAR, 1,                "",    LIMITS) \
+    X(EDC_WC,                    SCALAR, 1,                "A",   LIMITS) \
+    X(EDC_ACTUAL,                SCALAR, 1,                "A",   LIMITS) \
+    X(VID_WC,                    SCALAR, 1,                "V",   LIMITS) \
+    X(VID_ACTUAL,                SCALAR, 1,                "V",   LIMITS) \
+    X(VDDCR_CPU_POWER,           SCALAR, 1,                "W",   POWER) \
+    X(VDDCR_SOC_POWER,           SCALAR, 1,                "W",   POWER) \
+    X(VDDIO_MEM_POWER,           SCALAR, 1,                "W",   POWER) \
+    X(VDD18_POWER,               SCALAR, 1,                "W",   POWER) \
+    X(ROC_POWER,                 SCALAR, 1,                "W",   POWER) \
+    X(SOCKET_POWER,              SCALAR, 1,                "W",   POWER) \
+    X(CCLK_GLOBAL_FREQ,          SCALAR, 1,                "MHz", CLOCK) \
+    X(GLOB_FREQUENCY,            SCALAR, 1,                "MHz", CLOCK) \
+    X(STAPM_FREQUENCY,           SCALAR, 1,                "MHz", CLOCK) \
+    X(PPT_FREQUENCY,             SCALAR, 1,                "MHz", CLOCK) \
+    X(PPT_FREQUENCY_FAST,        SCALAR, 1,                "MHz", CLOCK) \
+    X(PPT_FREQUENCY_APU,         SCALAR, 1,                "MHz", CLOCK) \
+    X(TDC_FREQUENCY,             SCALAR, 1,                "A",   CLOCK) \
+    X(THM_FREQUENCY,             SCALAR, 1,                "C",   CLOCK) \
+    X(HTFMAX_FREQUENCY,          SCALAR, 1,                "MHz", CLOCK) \
+    X(PROCHOT_FREQUENCY,         SCALAR, 1,                "MHz", CLOCK) \
+    X(VOLTAGE_FREQUENCY,         SCALAR, 1,                "V",   VOLTAGE) \
+    X(CCA_FREQUENCY,             SCALAR, 1,                "MHz", CLOCK) \
+    X(FIT_VOLTAGE,               SCALAR, 1,                "V",   VOLTAGE) \
+    X(FIT_PRE_VOLTAGE,           SCALAR, 1,                "V",   VOLTAGE) \
+    X(LATCHUP_VOLTAGE,           SCALAR, 1,                "V",   VOLTAGE) \
+    X(CPU_SET_VOLTAGE,           SCALAR, 1,                "V",   VOLTAGE) \
+    X(CPU_TELEMETRY_VOLTAGE,     SCALAR, 1,                "V",   VOLTAGE) \
+    X(CPU_TELEMETRY_VOLTAGE2,    SCALAR, 1,                "V",   VOLTAGE) \
+    X(CPU_TELEMETRY_CURRENT,     SCALAR, 1,                "A",   CURRENT) \
+    X(CPU_TELEMETRY_POWER,       SCALAR, 1,                "W",   POWER) \
+    X(SOC_SET_VOLTAGE,           SCALAR, 1,                "V",   VOLTAGE) \
+    X(SOC_TELEMETRY_VOLTAGE,     SCALAR, 1,                "V",   VOLTAGE) \
+    X(SOC_TELEMETRY_CURRENT,     SCALAR, 1,                "A",   CURRENT) \
+    X(SOC_TELEMETRY_POWER,       SCALAR, 1,                "W",   POWER) \
+    X(FCLK_FREQ,                 SCALAR, 1,                "MHz", CLOCK) \
+    X(FCLK_FREQ_EFF,             SCALAR, 1,                "MHz", CLOCK) \
+    X(UCLK_FREQ,                 SCALAR, 1,                "MHz", CLOCK) \
+    X(UCLK_FREQ_EFF,             SCALAR, 1,                "MHz", CLOCK) \
+    X(MEMCLK_FREQ,               SCALAR, 1,                "MHz", CLOCK) \
+    X(MEMCLK_FREQ_EFF,           SCALAR, 1,                "MHz", CLOCK) \
+    X(FCLK_DRAM_SETPOINT,        SCALAR, 1,                "",    CLOCK) \
+    X(FCLK_DRAM_BUSY,            SCALAR, 1,                "%",   RESIDENCY) \
+    X(FCLK_GMI_SETPOINT,         SCALAR, 1,                "",    CLOCK) \
+    X(FCLK_GMI_BUSY,             SCALAR, 1,                "%",   RESIDENCY) \
+    X(FCLK_IOHC_SETPOINT,        SCALAR, 1,                "",    CLOCK) \
+    X(FCLK_IOHC_BUSY,            SCALAR, 1,                "%",   RESIDENCY) \
+    X(FCLK_MEM_LATENCY_SETPOINT, SCALAR, 1,                "",    CLOCK) \
+    X(FCLK_MEM_LATENCY,          SCALAR, 1,                "MHz", CLOCK) \
+    X(FCLK_CCLK_SETPOINT,        SCALAR, 1,                "",    CLOCK) \
+    X(FCLK_CCLK_FREQ,            SCALAR, 1,                "MHz", CLOCK) \
+    X(FCLK_XGMI_SETPOINT,        SCALAR, 1,                "",    CLOCK) \
+    X(FCLK_XGMI_BUSY,            SCALAR, 1,                "%",   RESIDENCY) \
+    X(FCLK_GFX_SETPOINT,         SCALAR, 1,                "",    CLOCK) \
+    X(FCLK_GFX_BUSY,             SCALAR, 1,                "%",   RESIDENCY) \
+    X(CCM_READS,                 SCALAR, 1,                "",    OTHER) \
+    X(CCM_WRITES,                SCALAR, 1,                "",    OTHER) \
+    X(IOMS,                      SCALAR, 1,                "",    OTHER) \
+    X(XGMI,                      SCALAR, 1,                "",    OTHER) \
+    X(CS_UMC_READS,              SCALAR, 1,                "",    OTHER) \
+    X(CS_UMC_WRITES,             SCALAR, 1,                "",    OTHER) \
+    X(FCLK_RESIDENCY,            FIXED,  4,                "%",   RESIDENCY) \
+    X(FCLK_FREQ_TABLE,           FIXED,  4,                "MHz", CLOCK) \
+    X(UCLK_FREQ_TABLE,           FIXED,  4,                "MHz", CLOCK) \
+    X(MEMCLK_FREQ_TABLE,         FIXED,  4,                "MHz", CLOCK) \
+    X(FCLK_VOLTAGE,              FIXED,  4,                "V",   VOLTAGE) \
+    X(LCLK_SETPOINT,             FIXED,  4,                "",    CLOCK) \
+    X(LCLK_BUSY,                 FIXED,  4,                "%",   RESIDENCY) \
+    X(LCLK_FREQ,                 FIXED,  4,                "MHz", CLOCK) \
+    X(LCLK_FREQ_EFF,             FIXED,  4,                "MHz", CLOCK) \
+    X(LCLK_MAX_DPM,              FIXED,  4,                "MHz", CLOCK) \
+    X(LCLK_MIN_DPM,              FIXED,  4,                "MHz", CLOCK) \
+    X(SOCCLK_FREQ_EFF,           FIXED,  4,                "MHz", CLOCK) \
+    X(SHUBCLK_FREQ_EFF,          FIXED,  4,                "MHz", CLOCK) \
+    X(XGMI_SETPOINT,             SCALAR, 1,                "",    OTHER) \
+    X(XGMI_BUSY,                 SCALAR, 1,                "%",   RESIDENCY) \
+    X(XGMI_LANE_WIDTH,           SCALAR, 1,                "",    OTHER) \
+    X(XGMI_DATA_RATE,            SCALAR, 1,                "",    OTHER) \
+    X(SOC_POWER,                 SCALAR, 1,                "W",   POWER) \
+    X(SOC_TEMP,                  SCALAR, 1,                "C",   TEMP) \
+    X(DDR_VDDP_POWER,            SCALAR, 1,                "W",   POWER) \
+    X(DDR_VDDIO_MEM_POWER,       SCALAR, 1,                "W",   POWER) \
+    X(GMI2_VDDG_POWER,           SCALAR, 1,                "W",   POWER) \
+    X(IO_VDDCR_SOC_POWER,        SCALAR, 1,                "W",   POWER) \
+    X(IOD_VDDIO_MEM_POWER,       SCALAR, 1,                "W",   POWER) \
+    X(IO_VDD18_POWER,            SCALAR, 1,                "W",   POWER) \
+    X(TDP,                       SCALAR, 1,                "",    OTHER) \
+    X(DETERMINISM,               SCALAR, 1,                "",    OTHER) \
+    X(V_VDDM,                    SCALAR, 1,                "V",   VOLTAGE) \
+    X(V_VDDP,                    SCALAR, 1,                "V",   VOLTAGE) \
+    X(V_VDDG,                    SCALAR, 1,                "V",   VOLTAGE) \
+    X(V_VDDG_IOD,                SCALAR, 1,                "V",   VOLTAGE) \
+    X(V_VDDG_CCD,                SCALAR, 1,                "V",   VOLTAGE) \
+    X(PEAK_TEMP,                 SCALAR, 1,                "C",   TEMP) \
+    X(PEAK_VOLTAGE,              SCALAR, 1,                "V",   VOLTAGE) \
+    X(PEAK_CCLK_FREQ,            SCALAR, 1,                "MHz", CLOCK) \
+    X(unk_power,                 SCALAR, 1,                "",    OTHER) \
+    X(AVG_CORE_COUNT,            SCALAR, 1,                "",    OTHER) \
+    X(CCLK_LIMIT,                SCALAR, 1,                "MHz", CLOCK) \
+    X(MAX_SOC_VOLTAGE,           SCALAR, 1,                "V",   VOLTAGE) \
+    X(DVO_VOLTAGE,               SCALAR, 1,                "V",   VOLTAGE) \
+    X(APML_POWER,                SCALAR, 1,                "W",   POWER) \
+    X(CPU_DC_BTC,                SCALAR, 1,                "",    OTHER) \
+    X(SOC_DC_BTC,                SCALAR, 1,                "",    OTHER) \
+    X(DC_BTC,                    SCALAR, 1,                "",    OTHER) \
+    X(PACKAGE_POWER,             SCALAR, 1,                "W",   POWER) \
+    X(CSTATE_BOOST,              SCALAR, 1,                "",    OTHER) \
+    X(PROCHOT,                   SCALAR, 1,                "",    OTHER) \
+    X(PC6,                       SCALAR, 1,                "%",   RESIDENCY) \
+    X(SELF_REFRESH,              SCALAR, 1,                "",    OTHER) \
+    X(PWM,                       SCALAR, 1,                "",    OTHER) \
+    X(SOCCLK,                    SCALAR, 1,                "MHz", CLOCK) \
+    X(SHUBCLK,                   SCALAR, 1,                "MHz", CLOCK) \
+    X(SMNCLK,                    SCALAR, 1,                "MHz", CLOCK) \
+    X(SMNCLK_EFF,                SCALAR, 1,                "MHz", CLOCK) \
+    X(MP0CLK,                    SCALAR, 1,                "MHz", CLOCK) \
+    X(MP0CLK_EFF,                SCALAR, 1,                "MHz", CLOCK) \
+    X(MP1CLK,                    SCALAR, 1,                "MHz", CLOCK) \
+    X(MP1CLK_EFF,                SCALAR, 1,                "MHz", CLOCK) \
+    X(MP2CLK,                    SCALAR, 1,                "MHz", CLOCK) \
+    X(MP2CLK_EFF,                SCALAR, 1,                "MHz", CLOCK) \
+    X(MP5CLK,                    SCALAR, 1,                "MHz", CLOCK) \
+    X(TWIXCLK,                   SCALAR, 1,                "MHz", CLOCK) \
+    X(WAFLCLK,                   SCALAR, 1,                "MHz", CLOCK) \
+    X(DPM_BUSY,                  SCALAR, 1,                "%",   RESIDENCY) \
+    X(MP1_BUSY,                  SCALAR, 1,                "%",   RESIDENCY) \
+    X(DPM_Skipped,               SCALAR, 1,                "",    OTHER) \
+    X(CORE_SETPOINT,             SCALAR, 1,                "",    OTHER) \
+    X(CORE_BUSY,                 SCALAR, 1,                "%",   RESIDENCY) \
+    /* Per core and per L3 arrays. Their length is max_cores or max_l3 respectively. */ \
+    /* They are allocated by pm_table_alloc_arrays(...) in each PM table function. */ \
+    X(CORE_POWER,                CORE,   0,                "W",   CORE) \
+    X(CORE_VOLTAGE,              CORE,   0,                "V",   CORE) \
+    X(CORE_TEMP,                 CORE,   0,                "C",   CORE) \
+    X(CORE_FIT,                  CORE,   0,                "",    CORE) \
+    X(CORE_IDDMAX,               CORE,   0,                "A",   CORE) \
+    X(CORE_FREQ,                 CORE,   0,                "GHz", CORE) \
+    X(CORE_FREQEFF,              CORE,   0,                "GHz", CORE) \
+    X(CORE_C0,                   CORE,   0,                "%",   CORE) \
+    X(CORE_CC1,                  CORE,   0,                "%",   CORE) \
+    X(CORE_CC6,                  CORE,   0,                "%",   CORE) \
+    X(CORE_CKS_FDD,              CORE,   0,                "",    CORE) \
+    X(CORE_CI_FDD,               CORE,   0,                "",    CORE) \
+    X(CORE_IRM,                  CORE,   0,                "",    CORE) \
+    X(CORE_PSTATE,               CORE,   0,                "",    CORE) \
+    X(CORE_FREQ_LIM_MAX,         CORE,   0,                "MHz", CORE) \
+    X(CORE_FREQ_LIM_MIN,         CORE,   0,                "MHz", CORE) \
+    X(CORE_CPPC_MAX,             CORE,   0,                "",    CORE) \
+    X(CORE_CPPC_MIN,             CORE,   0,                "",    CORE) \
+    X(CORE_CPPC_EPP,             CORE,   0,                "",    CORE) \
+    X(CORE_unk,                  CORE,   0,                "",    CORE) \
+    X(CORE_SC_LIMIT,             CORE,   0,                "",    CORE) \
+    X(CORE_SC_CAC,               CORE,   0,                "",    CORE) \
+    X(CORE_SC_RESIDENCY,         CORE,   0,                "%",   CORE) \
+    X(CORE_UOPS_CLK,             CORE,   0,                "MHz", CORE) \
+    X(CORE_UOPS,                 CORE,   0,                "",    CORE) \
+    X(CORE_MEM_LATECY,           CORE,   0,                "",    CORE) \
+    X(L3_LOGIC_POWER,            L3,     0,                "W",   L3) \
+    X(L3_VDDM_POWER,             L3,     0,                "W",   L3) \
+    X(L3_TEMP,                   L3,     0,                "C",   L3) \
+    X(L3_FIT,                    L3,     0,                "",    L3) \
+    X(L3_IDDMAX,                 L3,     0,                "A",   L3) \
+    X(L3_FREQ,                   L3,     0,                "GHz", L3) \
+    X(L3_FREQ_EFF,               L3,     0,                "GHz", L3) \
+    X(L3_CKS_FDD,                L3,     0,                "",    L3) \
+    X(L3_CCA_THRESHOLD,          L3,     0,                "",    L3) \
+    X(L3_CCA_CAC,                L3,     0,                "",    L3) \
+    X(L3_CCA_ACTIVATION,         L3,     0,                "",    L3) \
+    X(L3_EDC_LIMIT,              L3,     0,                "A",   L3) \
+    X(L3_EDC_CAC,                L3,     0,                "A",   L3) \
+    X(L3_EDC_RESIDENCY,          L3,     0,                "%",   L3) \
+    X(L3_FLL_BTC,                L3,     0,                "",    L3) \
+    /* MP5_BUSY seems to be always at the end of the table */ \
+    /* It can be an array from 1 up to 4 values */ \
+    /* What is currently assigned to MP5_BUSY seems to be called DPM_Skipped */ \
+    X(MP5_BUSY,                  FIXED,  PMT_MAX_NUM_MP5,  "%",   RESIDENCY) \
+    X(GFX_GLOB_FREQUENCY,        SCALAR, 1,                "MHz", GFX) \
+    X(GFX_STAPM_FREQUENCY,       SCALAR, 1,                "MHz", GFX) \
+    X(GFX_PPT_FREQUENCY_FAST,    SCALAR, 1,                "MHz", GFX) \
+    X(GFX_PPT_FREQUENCY,         SCALAR, 1,                "MHz", GFX) \
+    X(GFX_PPT_FREQUENCY_APU,     SCALAR, 1,                "MHz", GFX) \
+    X(GFX_TDC_FREQUENCY,         SCALAR, 1,                "MHz", GFX) \
+    X(GFX_THM_FREQUENCY,         SCALAR, 1,                "MHz", GFX) \
+    X(GFX_HTFMAX_FREQUENCY,      SCALAR, 1,                "MHz", GFX) \
+    X(GFX_PROCHOT_FREQUENCY,     SCALAR, 1,                "MHz", GFX) \
+    X(GFX_VOLTAGE_FREQUENCY,     SCALAR, 1,                "V",   GFX) \
+    X(GFX_CCA_FREQUENCY,         SCALAR, 1,                "MHz", GFX) \
+    X(GFX_DEM_FREQUENCY,         SCALAR, 1,                "MHz", GFX) \
+    X(GFX_VOLTAGE,               SCALAR, 1,                "V",   GFX) \
+    X(GFX_TEMP,                  SCALAR, 1,                "C",   GFX) \
+    X(GFX_IDDMAX,                SCALAR, 1,                "A",   GFX) \
+    X(GFX_FREQ,                  SCALAR, 1,                "MHz", GFX) \
+    X(GFX_FREQEFF,               SCALAR, 1,                "MHz", GFX) \
+    X(GFX_SETPOINT,              SCALAR, 1,                "",    GFX) \
+    X(GFX_BUSY,                  SCALAR, 1,                "%",   GFX) \
+    X(GFX_CGPG,                  SCALAR, 1,                "",    GFX) \
+    X(GFX_EDC_LIM,               SCALAR, 1,                "A",   GFX) \
+    X(GFX_EDC_RESIDENCY,         SCALAR, 1,                "%",   GFX) \
+    X(GFX_DEM_RESIDENCY,         SCALAR, 1,                "%",   GFX) \
+    X(DF_BUSY,                   SCALAR, 1,                "%",   RESIDENCY) \
+    X(IOHC_BUSY,                 SCALAR, 1,                "%",   RESIDENCY) \
+    X(MMHUB_BUSY,                SCALAR, 1,                "%",   RESIDENCY) \
+    X(ATHUB_BUSY,                SCALAR, 1,                "%",   RESIDENCY) \
+    X(OSSSYS_BUSY,               SCALAR, 1,                "%",   RESIDENCY) \
+    X(HDP_BUSY,                  SCALAR, 1,                "%",   RESIDENCY) \
+    X(SDMA_BUSY,                 SCALAR, 1,                "%",   RESIDENCY) \
+    X(SHUB_BUSY,                 SCALAR, 1,                "%",   RESIDENCY) \
+    X(BIF_BUSY,                  SCALAR, 1,                "%",   RESIDENCY) \
+    X(ACP_BUSY,                  SCALAR, 1,                "%",   RESIDENCY) \
+    X(SST0_BUSY,                 SCALAR, 1,                "%",   RESIDENCY) \
+    X(SST1_BUSY,                 SCALAR, 1,                "%",   RESIDENCY) \
+    X(USB0_BUSY,                 SCALAR, 1,                "%",   RESIDENCY) \
+    X(USB1_BUSY,                 SCALAR, 1,                "%",   RESIDENCY) \
+    X(GCM_64B_READS,             SCALAR, 1,                "",    OTHER) \
+    X(GCM_64B_WRITES,            SCALAR, 1,                "",    OTHER) \
+    X(GCM_32B_READS_WRITES,      SCALAR, 1,                "",    OTHER) \
+    X(MMHUB_READS,               SCALAR, 1,                "",    OTHER) \
+    X(MMHUB_WRITES,              SCALAR, 1,                "",    OTHER) \
+    X(DCE_READS,                 SCALAR, 1,                "",    OTHER) \
+    X(IO_READS_WRITES,           SCALAR, 1,                "",    OTHER) \
+    X(MAX_DRAM_BANDWIDTH,        SCALAR, 1,                "",    OTHER) \
+    X(VCN_BUSY,                  SCALAR, 1,                "%",   GFX) \
+    X(VCN_DECODE,                SCALAR, 1,                "",    GFX) \
+    X(VCN_ENCODE_GEN,            SCALAR, 1,                "",    GFX) \
+    X(VCN_ENCODE_LOW,            SCALAR, 1,                "",    GFX) \
+    X(VCN_ENCODE_REAL,           SCALAR, 1,                "",    GFX) \
+    X(VCN_PG,                    SCALAR, 1,                "",    GFX) \
+    X(VCN_JPEG,                  SCALAR, 1,                "",    GFX) \
+    X(VCLK_FREQ,                 SCALAR, 1,                "MHz", CLOCK) \
+    X(VCLK_FREQ_EFF,             SCALAR, 1,                "MHz", CLOCK) \
+    X(DCLK_FREQ,                 SCALAR, 1,                "MHz", CLOCK) \
+    X(DCLK_FREQ_EFF,             SCALAR, 1,                "MHz", CLOCK) \
+    X(DCF_FREQ,                  SCALAR, 1,                "MHz", CLOCK) \
+    X(DCF_FREQ_EFF,              SCALAR, 1,                "MHz", CLOCK) \
+    X(VCLK_STATE,                FIXED,  PMT_MAX_NUM_CLKS, "MHz", CLOCK) \
+    X(DCLK_STATE,                FIXED,  PMT_MAX_NUM_CLKS, "MHz", CLOCK) \
+    X(SOCCLK_STATE,              FIXED,  PMT_MAX_NUM_CLKS, "MHz", CLOCK) \
+    X(LCLK_STATE,                FIXED,  PMT_MAX_NUM_CLKS, "MHz", CLOCK) \
+    X(SHUB_STATE,                FIXED,  PMT_MAX_NUM_CLKS, "MHz", CLOCK) \
+    X(MP0_STATE,                 FIXED,  PMT_MAX_NUM_CLKS, "MHz", CLOCK) \
+    X(DCFCLK_STATE,              FIXED,  PMT_MAX_NUM_CLKS, "MHz", CLOCK) \
+    X(VCN_STATE_RESIDENCY,       FIXED,  PMT_MAX_NUM_CLKS, "%",   GFX) \
+    X(SOCCLK_STATE_RESIDENCY,    FIXED,  PMT_MAX_NUM_CLKS, "%",   RESIDENCY) \
+    X(LCLK_STATE_RESIDENCY,      FIXED,  PMT_MAX_NUM_CLKS, "%",   RESIDENCY) \
+    X(SHUB_STATE_RESIDENCY,      FIXED,  PMT_MAX_NUM_CLKS, "%",   RESIDENCY) \
+    X(MP0CLK_STATE_RESIDENCY,    FIXED,  PMT_MAX_NUM_CLKS, "%",   RESIDENCY) \
+    X(DCFCLK_STATE_RESIDENCY,    FIXED,  PMT_MAX_NUM_CLKS, "%",   RESIDENCY) \
+    X(VDDCR_SOC_VOLTAGE,         FIXED,  PMT_MAX_NUM_CLKS, "V",   VOLTAGE) \
+    X(CPUOFF,                    SCALAR, 1,                "",    OTHER) \
+    X(CPUOFF_CNT,                SCALAR, 1,                "",    OTHER) \
+    X(GFXOFF,                    SCALAR, 1,                "",    OTHER) \
+    X(GFXOFF_CNT,                SCALAR, 1,                "",    OTHER) \
+    X(VDDOFF,                    SCALAR, 1,                "",    OTHER) \
+    X(VDDOFF_CNT,                SCALAR, 1,                "",    OTHER) \
+    X(ULV,                       SCALAR, 1,                "",    OTHER) \
+    X(ULV_CNT,                   SCALAR, 1,                "",    OTHER) \
+    X(ULV_VOLTAGE,               SCALAR, 1,                "V",   VOLTAGE) \
+    X(S0i2,                      SCALAR, 1,                "",    OTHER) \
+    X(S0i2_CNT,                  SCALAR, 1,                "",    OTHER) \
+    X(WHISPER,                   SCALAR, 1,                "",    OTHER) \
+    X(WHISPER_CNT,               SCALAR, 1,                "",    OTHER) \
+    X(SELFREFRESH0,              SCALAR, 1,                "",    OTHER) \
+    X(SELFREFRESH1,              SCALAR, 1,                "",    OTHER) \
+    X(PLL_POWERDOWN_0,           SCALAR, 1,                "",    OTHER) \
+    X(PLL_POWERDOWN_1,           SCALAR, 1,                "",    OTHER) \
+    X(PLL_POWERDOWN_2,           SCALAR, 1,                "",    OTHER) \
+    X(PLL_POWERDOWN_3,           SCALAR, 1,                "",    OTHER) \
+    X(PLL_POWERDOWN_4,           SCALAR, 1,                "",    OTHER) \
+    X(DGPU_POWER,                SCALAR, 1,                "W",   GFX) \
+    X(DGPU_GFX_BUSY,             SCALAR, 1,                "%",   GFX) \
+    X(DGPU_FREQ_TARGET,          SCALAR, 1,                "MHz", GFX) \
+    X(DISPLAY_COUNT,             SCALAR, 1,                "",    GFX) \
+    X(FPS,                       SCALAR, 1,                "",    GFX) \
+    X(IO_DISPLAY_POWER,          SCALAR, 1,                "W",   POWER) \
+    X(IO_USB_POWER,              SCALAR, 1,                "W",   POWER) \
+    X(DDR_PHY_POWER,             SCALAR, 1,                "W",   POWER) \
+    X(MAX_CORE_VOLTAGE,          SCALAR, 1,                "V",   VOLTAGE) \
+    X(StapmTimeConstant,         SCALAR, 1,                "",    OTHER) \
+    X(SlowPPTTimeConstant,       SCALAR, 1,                "",    OTHER) \
+    X(ACLK,                      SCALAR, 1,                "MHz", CLOCK) \
+    X(DISPCLK,                   SCALAR, 1,                "MHz", CLOCK) \
+    X(DPREFCLK,                  SCALAR, 1,                "MHz", CLOCK) \
+    X(DPPCLK,                    SCALAR, 1,                "MHz", CLOCK) \
+    X(SMU_BUSY,                  SCALAR, 1,                "%",   RESIDENCY) \
+    X(SMU_SKIP_COUNTER,          SCALAR, 1,                "",    OTHER)
+
+typedef enum {
+    PMT_FIELD_SCALAR,
+    PMT_FIELD_FIXED,
+    PMT_FIELD_CORE,
+    PMT_FIELD_L3
+} pm_field_kind;
+
+typedef enum {
+    PMT_CAT_LIMITS,
+    PMT_CAT_POWER,
+    PMT_CAT_VOLTAGE,
+    PMT_CAT_CURRENT,
+    PMT_CAT_TEMP,
+    PMT_CAT_CLOCK,
+    PMT_CAT_RESIDENCY,
+    PMT_CAT_CORE,
+    PMT_CAT_L3,
+    PMT_CAT_GFX,
+    PMT_CAT_OTHER,
+    PMT_NUM_CATEGORIES
+} pm_field_category;
+
+//Index of each field in pm_fields
+enum {
+#define PMT_FIELD_ID(name, kind, count, unit, category) PMT_ID_##name,
+    PM_TABLE_FIELDS(PMT_FIELD_ID)
+    PMT_NUM_FIELDS
+};
+
+typedef struct {
+    const char *name;
+    const char *unit;
+    unsigned short offset;  //Byte offset of the member in pm_table
+    unsigned char kind;     //pm_field_kind
+    unsigned char category; //pm_field_category
+    unsigned char count;    //Number of elements of FIXED arrays
+} pm_field;
+
+extern const pm_field pm_fields[PMT_NUM_FIELDS];
+extern const char * const pm_field_category_names[PMT_NUM_CATEGORIES];
+
+//Perfect hash of the field names. pm_fields_gen picks a seed per bucket at build time so
+//that every name lands in its own slot (pm_fields_hash.c). A lookup costs two hashes and one strcmp.
+#define PMT_HASH_BUCKETS 128
+#define PMT_HASH_SLOTS   512
+
+extern const unsigned short pm_field_hash_seeds[PMT_HASH_BUCKETS];
+extern const short pm_field_hash_slots[PMT_HASH_SLOTS];
+
+//FNV-1a with the seed folded into the offset basis
+static inline unsigned int pm_field_hash(const char *s, unsigned int len, unsigned int seed) {
+    unsigned int h = 2166136261u ^ (seed * 0x9e3779b9u);
+
+    while (len--) {
+        h ^= (unsigned char)*s++;
+        h *= 16777619u;
+    }
+
+    return h ^ (h >> 15);
+}
+
+//Index into pm_fields of the field with the given name. -1 if there is none.
+//Names are case sensitive like the members of pm_table.
+int pm_field_lookup(const char *name);
+int pm_field_lookup_len(const char *name, unsigned int len);
+
+#endif
@@ -0,0 +1,100 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+//Builds the perfect hash of the field names in pm_fields.h and prints it as C source.
+//Hash and displace: the names are spread over PMT_HASH_BUCKETS buckets with seed 0. Starting
+//with the largest bucket, each bucket gets the first seed that moves all of its names to
+//free slots. Runs at build time, see the Makefile.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pm_fields.h"
+
+#define MAX_SEED 65535
+
+#define PMT_FIELD_NAME(name, kind, count, unit, category) #name,
+static const char *names[PMT_NUM_FIELDS] = {
+    PM_TABLE_FIELDS(PMT_FIELD_NAME)
+};
+
+static unsigned int bucket_of[PMT_NUM_FIELDS];
+static unsigned int bucket_size[PMT_HASH_BUCKETS];
+static unsigned short seeds[PMT_HASH_BUCKETS];
+static short slots[PMT_HASH_SLOTS];
+
+static int compare_bucket(const void *a, const void *b) {
+    return (int)bucket_size[*(const unsigned int*)b] - (int)bucket_size[*(const unsigned int*)a];
+}
+
+//Tries to place all names of bucket b with the given seed. Undoes a partial placement.
+static int place_bucket(unsigned int b, unsigned int seed) {
+    unsigned int i, j, slot;
+
+    for (i = 0; i < PMT_NUM_FIELDS; i++) {
+        if (bucket_of[i] != b) continue;
+        slot = pm_field_hash(names[i], strlen(names[i]), seed) % PMT_HASH_SLOTS;
+        if (slots[slot] < 0) {
+            slots[slot] = i;
+            continue;
+        }
+        for (j = 0; j < i; j++) {
+            if (bucket_of[j] != b) continue;
+            slot = pm_field_hash(names[j], strlen(names[j]), seed) % PMT_HASH_SLOTS;
+            if (slots[slot] == (short)j) slots[slot] = -1;
+        }
+        return 0;
+    }
+
+    return 1;
+}
+
+int main() {
+    unsigned int order[PMT_HASH_BUCKETS];
+    unsigned int i, seed;
+
+    for (i = 0; i < PMT_HASH_SLOTS; i++) slots[i] = -1;
+    for (i = 0; i < PMT_NUM_FIELDS; i++) {
+        bucket_of[i] = pm_field_hash(names[i], strlen(names[i]), 0) % PMT_HASH_BUCKETS;
+        bucket_size[bucket_of[i]]++;
+    }
+    for (i = 0; i < PMT_HASH_BUCKETS; i++) order[i] = i;
+    qsort(order, PMT_HASH_BUCKETS, sizeof(unsigned int), compare_bucket);
+
+    for (i = 0; i < PMT_HASH_BUCKETS && bucket_size[order[i]]; i++) {
+        for (seed = 1; seed <= MAX_SEED && !place_bucket(order[i], seed); seed++);
+        if (seed > MAX_SEED) {
+            fprintf(stderr, "pm_fields_gen: No seed found for bucket %u. Increase PMT_HASH_SLOTS.\n", order[i]);
+            return 1;
+        }
+        seeds[order[i]] = seed;
+    }
+
+    printf("//Generated by pm_fields_gen from pm_fields.h. Do not edit.\n\n");
+    printf("#include \"pm_fields.h\"\n\n");
+    printf("const unsigned short pm_field_hash_seeds[PMT_HASH_BUCKETS] = {");
+    for (i = 0; i < PMT_HASH_BUCKETS; i++) printf("%s%5u,", i % 12 ? "" : "\n   ", seeds[i]);
+    printf("\n};\n\n");
+    printf("const short pm_field_hash_slots[PMT_HASH_SLOTS] = {");
+    for (i = 0; i < PMT_HASH_SLOTS; i++) printf("%s%4d,", i % 16 ? "" : "\n   ", slots[i]);
+    printf("\n};\n");
+
+    return 0;
+}
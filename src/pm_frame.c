@@ -0,0 +1,181 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/**
+ * Once per sample the active layout is decoded into a pm_frame: dense,
+ * aligned per core arrays and a vector of scalars. The renderer, the
+ * workload summary and the energy attribution all read the frame, so the
+ * pointer chasing through pm_table and derived values like the core voltage
+ * estimate happen once per sample.
+ *
+ * The built-in layouts have decoders with constant offsets, generated at
+ * build time by pm_frame_gen. Other layouts go through the source pointers.
+ **/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pm_frame.h"
+
+//Arrays are padded to whole 32 byte vectors
+#define PMF_ALIGN_FLOATS 8
+#define PMF_PAD(n) (((n) + PMF_ALIGN_FLOATS - 1) / PMF_ALIGN_FLOATS * PMF_ALIGN_FLOATS)
+
+#define PMF_COUNT_ARRAY(member, name) +1
+
+static void set_valid(pm_frame *frame, int field) {
+    frame->valid[field / 32] |= 1u << (field % 32);
+}
+
+//Returns 1 if all elements are in the layout. Remembers consecutive runs for a plain copy.
+static int init_array(pm_frame *frame, int field, float **arr, int n) {
+    int i;
+
+    frame->src[field] = core_stats_contiguous(arr, n);
+    for (i = 0; i < n; i++)
+        if (!arr[i]) return 0;
+
+    return 1;
+}
+
+static void extract_array(float *dst, const float *run, float **arr, int n) {
+    int i;
+
+    if (run) {
+        memcpy(dst, run, n * sizeof(float));
+        return;
+    }
+    for (i = 0; i < n; i++) dst[i] = arr[i] ? *arr[i] : NAN;
+}
+
+static void fill_nan(float *p, int n) {
+    int i;
+
+    for (i = 0; i < n; i++) p[i] = NAN;
+}
+
+int pm_frame_init(pm_frame *frame, const pm_table *pmt, system_info *sysinfo, const unsigned char *pm_buf) {
+    int i, core_pad, l3_pad, num_core_arrays, num_l3_arrays;
+    float *p;
+
+    memset(frame, 0, sizeof(pm_frame));
+    frame->pmt = pmt;
+    frame->pm_buf = (const float*)pm_buf;
+    frame->num_cores = pmt->max_cores;
+    frame->num_l3 = pmt->max_l3;
+
+    core_pad = PMF_PAD(frame->num_cores);
+    l3_pad = PMF_PAD(frame->num_l3);
+    num_core_arrays = 0 PM_FRAME_CORE_ARRAYS(PMF_COUNT_ARRAY);
+    num_l3_arrays = 0 PM_FRAME_L3_ARRAYS(PMF_COUNT_ARRAY);
+
+    //+1 for core_voltage_est
+    frame->pool_size = (num_core_arrays + 1) * core_pad + num_l3_arrays * l3_pad;
+    frame->pool = aligned_alloc(PMF_ALIGN_FLOATS * sizeof(float), frame->pool_size * sizeof(float));
+    if (!frame->pool || !core_mask_init(&frame->mask, pmt, sysinfo)) {
+        pm_frame_free(frame);
+        return 0;
+    }
+
+    //Elements are NAN until decoded. Specialized decoders never write the ones their layout lacks.
+    //The padding stays 0.
+    memset(frame->pool, 0, frame->pool_size * sizeof(float));
+    p = frame->pool;
+#define PMF_ASSIGN_CORE(member, name) frame->member = p; fill_nan(p, frame->num_cores); p += core_pad;
+#define PMF_ASSIGN_L3(member, name)   frame->member = p; fill_nan(p, frame->num_l3); p += l3_pad;
+    PM_FRAME_CORE_ARRAYS(PMF_ASSIGN_CORE)
+    PM_FRAME_L3_ARRAYS(PMF_ASSIGN_L3)
+    frame->core_voltage_est = p;
+
+#define PMF_INIT_SCALAR(name) \
+    frame->src[PMF_##name] = pmt->name; \
+    if (pmt->name) set_valid(frame, PMF_##name);
+#define PMF_INIT_CORE(member, name) \
+    if (init_array(frame, PMF_##name, pmt->name, frame->num_cores)) set_valid(frame, PMF_##name);
+#define PMF_INIT_L3(member, name) \
+    if (init_array(frame, PMF_##name, pmt->name, frame->num_l3)) set_valid(frame, PMF_##name);
+    PM_FRAME_SCALARS(PMF_INIT_SCALAR)
+    PM_FRAME_CORE_ARRAYS(PMF_INIT_CORE)
+    PM_FRAME_L3_ARRAYS(PMF_INIT_L3)
+
+    //Specialized decoders only write the fields their layout has
+    for (i = 0; i < PMF_NUM_SCALARS; i++) frame->scalars[i] = NAN;
+    for (i = 0; !pmt->from_file && pm_frame_decoders[i].version; i++) {
+        if (pm_frame_decoders[i].version == pmt->version) {
+            frame->decode = pm_frame_decoders[i].decode;
+            break;
+        }
+    }
+
+    return 1;
+}
+
+void pm_frame_free(pm_frame *frame) {
+    free(frame->pool);
+    core_mask_free(&frame->mask);
+    memset(frame, 0, sizeof(pm_frame));
+}
+
+void pm_frame_extract(pm_frame *frame) {
+    const pm_table *pmt = frame->pmt;
+    float package_sleep_time, core_sleep_time;
+    int i;
+
+    if (frame->decode) {
+        frame->decode(frame, frame->pm_buf);
+    }
+    else {
+        for (i = 0; i < PMF_NUM_SCALARS; i++)
+            frame->scalars[i] = frame->src[i] ? *frame->src[i] : NAN;
+
+#define PMF_EXTRACT_CORE(member, name) \
+        extract_array(frame->member, frame->src[PMF_##name], pmt->name, frame->num_cores);
+#define PMF_EXTRACT_L3(member, name) \
+        extract_array(frame->member, frame->src[PMF_##name], pmt->name, frame->num_l3);
+        PM_FRAME_CORE_ARRAYS(PMF_EXTRACT_CORE)
+        PM_FRAME_L3_ARRAYS(PMF_EXTRACT_L3)
+    }
+
+    //The telemetry voltage includes the time the package spent in C6 at about 0.2 V
+    if (pmf_valid(PC6)) {
+        package_sleep_time = pmf(PC6) / 100.f;
+        frame->average_voltage = (pmf(CPU_TELEMETRY_VOLTAGE) - (0.2 * package_sleep_time)) / (1.0 - package_sleep_time);
+    }
+    else {
+        frame->average_voltage = pmf(CPU_TELEMETRY_VOLTAGE);
+    }
+
+    // Rumours say this is how AMD calculates core voltage
+    for (i = 0; i < frame->num_cores; i++) {
+        core_sleep_time = frame->core_cc6[i] / 100.f;
+        frame->core_voltage_est[i] = ((1.0 - core_sleep_time) * frame->average_voltage) + (0.2 * core_sleep_time);
+    }
+}
+
+void pm_frame_subtract(pm_frame *frame, const pm_frame *base) {
+    unsigned int i;
+
+    for (i = 0; i < PMF_NUM_SCALARS; i++) frame->scalars[i] -= base->scalars[i];
+    //All arrays and the voltage estimate share the pool, padding included
+    for (i = 0; i < frame->pool_size; i++) frame->pool[i] -= base->pool[i];
+
+    frame->average_voltage -= base->average_voltage;
+}
@@ -0,0 +1,121 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef PM_FRAME_H
+#define PM_FRAME_H
+
+#include <math.h>
+
+#include "pm_tables.h"
+#include "readinfo.h"
+#include "core_stats.h"
+
+//PM table values decoded once per sample. Name of the pm_table field.
+#define PM_FRAME_SCALARS(X) \
+    X(STAPM_LIMIT) X(STAPM_VALUE) X(PPT_LIMIT) X(PPT_VALUE) X(PPT_LIMIT_APU) X(PPT_VALUE_APU) \
+    X(TDC_LIMIT) X(TDC_VALUE) X(TDC_LIMIT_SOC) X(TDC_VALUE_SOC) X(THM_LIMIT) X(THM_VALUE) \
+    X(THM_LIMIT_SOC) X(THM_VALUE_SOC) X(THM_LIMIT_GFX) X(THM_VALUE_GFX) X(STT_LIMIT_APU) \
+    X(STT_VALUE_APU) X(STT_LIMIT_DGPU) X(STT_VALUE_DGPU) X(FIT_LIMIT) X(FIT_VALUE) X(EDC_LIMIT) \
+    X(EDC_VALUE) X(EDC_LIMIT_SOC) X(EDC_VALUE_SOC) X(VID_LIMIT) X(VID_VALUE) X(TDC_ACTUAL) \
+    X(VDDCR_CPU_POWER) X(VDDCR_SOC_POWER) X(VDDIO_MEM_POWER) X(VDD18_POWER) X(ROC_POWER) \
+    X(SOCKET_POWER) X(CPU_TELEMETRY_VOLTAGE) X(CPU_TELEMETRY_CURRENT) X(CPU_TELEMETRY_POWER) \
+    X(SOC_SET_VOLTAGE) X(SOC_TELEMETRY_VOLTAGE) X(SOC_TELEMETRY_CURRENT) X(SOC_TELEMETRY_POWER) \
+    X(FCLK_FREQ) X(FCLK_FREQ_EFF) X(UCLK_FREQ) X(MEMCLK_FREQ) X(SOC_TEMP) X(DDR_VDDP_POWER) \
+    X(GMI2_VDDG_POWER) X(IO_VDDCR_SOC_POWER) X(IOD_VDDIO_MEM_POWER) X(IO_VDD18_POWER) X(V_VDDM) \
+    X(V_VDDP) X(V_VDDG) X(V_VDDG_IOD) X(V_VDDG_CCD) X(PEAK_TEMP) X(PACKAGE_POWER) X(PC6) \
+    X(GFX_VOLTAGE) X(GFX_TEMP) X(GFX_FREQ) X(GFX_FREQEFF) X(GFX_BUSY) X(GFX_EDC_LIM) \
+    X(GFX_EDC_RESIDENCY) X(DGPU_POWER) X(DGPU_GFX_BUSY) X(DGPU_FREQ_TARGET) X(DISPLAY_COUNT) X(FPS) \
+    X(IO_DISPLAY_POWER) X(IO_USB_POWER) X(DDR_PHY_POWER)
+
+//Per core and per L3 arrays: frame member, pm_table field
+#define PM_FRAME_CORE_ARRAYS(X) \
+    X(core_power, CORE_POWER) X(core_voltage, CORE_VOLTAGE) X(core_temp, CORE_TEMP) X(core_fit, CORE_FIT) \
+    X(core_iddmax, CORE_IDDMAX) X(core_freq, CORE_FREQ) X(core_freqeff, CORE_FREQEFF) X(core_c0, CORE_C0) \
+    X(core_cc1, CORE_CC1) X(core_cc6, CORE_CC6) X(core_irm, CORE_IRM)
+#define PM_FRAME_L3_ARRAYS(X) \
+    X(l3_logic_power, L3_LOGIC_POWER) X(l3_vddm_power, L3_VDDM_POWER)
+
+#define PMF_ENUM_SCALAR(name) PMF_##name,
+#define PMF_ENUM_ARRAY(member, name) PMF_##name,
+enum {
+    PM_FRAME_SCALARS(PMF_ENUM_SCALAR)
+    PMF_NUM_SCALARS,
+    PM_FRAME_CORE_ARRAYS(PMF_ENUM_ARRAY)
+    PM_FRAME_L3_ARRAYS(PMF_ENUM_ARRAY)
+    PMF_NUM_FIELDS
+};
+
+#define PMF_MEMBER(member, name) float *member;
+
+typedef struct pm_frame pm_frame;
+
+//Decoder of one PM table version with constant offsets. Generated by pm_frame_gen.
+typedef void (*pm_frame_decode_fn)(pm_frame *frame, const float *pm);
+
+typedef struct {
+    unsigned int version;
+    pm_frame_decode_fn decode;
+} pm_frame_decoder;
+
+extern const pm_frame_decoder pm_frame_decoders[]; //Terminated by version 0
+
+struct pm_frame {
+    const pm_table *pmt;            //Layout the frame is decoded from
+    int num_cores;
+    int num_l3;
+
+    float scalars[PMF_NUM_SCALARS]; //NAN if the layout does not have the value
+    PM_FRAME_CORE_ARRAYS(PMF_MEMBER) //num_cores entries each, 32 byte aligned. NAN if missing.
+    PM_FRAME_L3_ARRAYS(PMF_MEMBER)   //num_l3 entries each
+    unsigned int valid[(PMF_NUM_FIELDS + 31) / 32]; //Field is in the layout. Arrays only if all elements are.
+
+    //Derived values
+    float average_voltage;          //Average voltage of the active cores, corrected for package C6
+    float *core_voltage_est;        //Voltage estimate from CC6 residency, like Ryzen Master does it
+
+    core_mask mask;                 //Enabled cores for core_stats_array()
+
+    const float *pm_buf;            //PM table buffer the layout points into
+    pm_frame_decode_fn decode;      //Specialized decoder of the layout. NULL uses the generic path.
+    const float *src[PMF_NUM_FIELDS]; //Scalar source, or start of a consecutive per core / L3 run
+    float *pool;
+    unsigned int pool_size;         //Floats in pool
+};
+
+#define pm_frame_valid(frame, field) (((frame)->valid[(field) / 32] >> ((field) % 32)) & 0x01)
+
+//Value of a scalar, like pmta()/pmta0() but from the frame in "frame"
+#define pmf(name)       (frame->scalars[PMF_##name])
+#define pmf0(name)      (pmf_valid(name) ? pmf(name) : 0.f)
+#define pmf_valid(name) pm_frame_valid(frame, PMF_##name)
+
+//Missing array elements are NAN. Sums should take them as 0, like pmta0() does.
+#define pmf_nan0(v)     (isnan(v) ? 0.f : (v))
+
+int pm_frame_init(pm_frame *frame, const pm_table *pmt, system_info *sysinfo, const unsigned char *pm_buf);
+void pm_frame_free(pm_frame *frame);
+
+//Decodes pm_buf. Call after every smu_read_pm_table.
+void pm_frame_extract(pm_frame *frame);
+
+//Subtracts base, a frame of the same layout, from every value including the derived ones.
+//The frame is dense, so this is a few vector subtractions per sample.
+void pm_frame_subtract(pm_frame *frame, const pm_frame *base);
+
+#endif
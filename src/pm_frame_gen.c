@@ -0,0 +1,92 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/**
+ * Build time generator for pm_frame_decoders.c.
+ *
+ * Every known layout is selected over a probe buffer, so its field pointers
+ * turn into constant offsets. For each version a decoder is emitted that
+ * copies the fields the layout has from constant offsets into a pm_frame.
+ * Fields the layout lacks are left out; pm_frame_init sets them to NAN once.
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pm_frame.h"
+
+//Large enough for every known PM table
+static float probe[16384];
+
+//Index of the float a layout pointer refers to
+#define OFFSET(p) ((unsigned long)((p) - probe))
+
+static void emit_scalar(const char *name, float *p) {
+    if (p) printf("    frame->scalars[PMF_%s] = pm[%lu];\n", name, OFFSET(p));
+}
+
+static void emit_array(const char *member, float **arr, int n) {
+    int i;
+
+    for (i = 1; i < n; i++)
+        if (!arr[i] || !arr[0] || arr[i] != arr[0] + i) break;
+    if (n && i == n) {
+        printf("    memcpy(frame->%s, pm + %lu, %d * sizeof(float));\n", member, OFFSET(arr[0]), n);
+        return;
+    }
+    //Missing elements are not written, pm_frame_init sets them to NAN once
+    for (i = 0; i < n; i++)
+        if (arr[i]) printf("    frame->%s[%d] = pm[%lu];\n", member, i, OFFSET(arr[i]));
+}
+
+static void emit_decoder(unsigned int version) {
+    pm_table pmt;
+
+    select_pm_table_version(version, &pmt, (unsigned char*)probe);
+    if (pmt.min_size > sizeof(probe)) {
+        fprintf(stderr, "PM Table 0x%x is larger than the probe buffer.\n", version);
+        exit(1);
+    }
+
+    printf("static void pm_frame_decode_0x%06x(pm_frame *frame, const float *pm) {\n", version);
+#define GEN_SCALAR(name) emit_scalar(#name, pmt.name);
+#define GEN_CORE(member, name) emit_array(#member, pmt.name, pmt.max_cores);
+#define GEN_L3(member, name) emit_array(#member, pmt.name, pmt.max_l3);
+    PM_FRAME_SCALARS(GEN_SCALAR)
+    PM_FRAME_CORE_ARRAYS(GEN_CORE)
+    PM_FRAME_L3_ARRAYS(GEN_L3)
+    printf("}\n\n");
+
+    pm_table_free(&pmt);
+}
+
+int main() {
+    printf("//Generated by pm_frame_gen from pm_tables.c. Do not edit.\n\n");
+    printf("#include <math.h>\n#include <string.h>\n\n#include \"pm_frame.h\"\n\n");
+
+#define GEN_DECODER(v) emit_decoder(v);
+    PM_TABLE_VERSIONS(GEN_DECODER)
+
+    printf("const pm_frame_decoder pm_frame_decoders[] = {\n");
+#define GEN_DISPATCH(v) printf("    { 0x%06x, pm_frame_decode_0x%06x },\n", v, v);
+    PM_TABLE_VERSIONS(GEN_DISPATCH)
+    printf("    { 0, NULL }\n};\n");
+
+    return 0;
+}
@@ -0,0 +1,297 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/**
+ * PM table layouts loaded at runtime from text files.
+ *
+ *   # Ryzen 5900X, SMU FW v56.50
+ *   version     0x380806
+ *   max_cores   16
+ *   max_l3      2
+ *   zen_version 3
+ *   min_size    0x948
+ *   PPT_LIMIT   2
+ *   CORE_POWER  200..215     # Consecutive elements
+ *   L3_TEMP     20 21        # Listed elements
+ *   CORE_FIT[3] 251          # A single element
+ *
+ * Numbers are float indices into the PM table, like in pm_tables.c. Field
+ * names are those of pm_table, looked up in the registry of pm_fields.h.
+ * The file is compiled into a list of (field, element, index) triples once
+ * at load time. Selecting it fills the same pm_table the built-in layouts
+ * do, so sampling does not see any difference.
+ **/
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "pm_layout.h"
+
+typedef struct {
+    unsigned short field;   //Index into pm_fields
+    unsigned short element;
+    unsigned int index;     //Float index in the PM table
+} pm_layout_entry;
+
+typedef struct {
+    pm_table meta;          //Only the header fields (version, max_cores, ...) are used
+    pm_layout_entry *entries;
+    unsigned int num_entries, cap_entries;
+} pm_layout;
+
+static pm_layout *layouts;
+static unsigned int num_layouts, cap_layouts;
+
+static void add_entry(pm_layout *layout, int field, unsigned int element, unsigned int index) {
+    pm_layout_entry *entries;
+
+    if (layout->num_entries == layout->cap_entries) {
+        layout->cap_entries = layout->cap_entries ? layout->cap_entries * 2 : 256;
+        entries = realloc(layout->entries, layout->cap_entries * sizeof(pm_layout_entry));
+        if (!entries) {
+            fprintf(stderr, "Could not allocate memory for the PM Table layout.\n");
+            exit(0);
+        }
+        layout->entries = entries;
+    }
+    layout->entries[layout->num_entries].field = field;
+    layout->entries[layout->num_entries].element = element;
+    layout->entries[layout->num_entries].index = index;
+    layout->num_entries++;
+}
+
+static int parse_number(char **p, unsigned int *value) {
+    char *end;
+
+    *value = strtoul(*p, &end, 0);
+    if (end == *p) return 0;
+    *p = end;
+
+    return 1;
+}
+
+static void skip_blanks(char **p) {
+    while (**p == ' ' || **p == '\t' || **p == '\r') (*p)++;
+}
+
+#define LAYOUT_ERROR(msg) { \
+    fprintf(stderr, "%s:%d: %s\n", path, line, msg); \
+    exit(0); }
+
+static void parse_layout(const char *path, char *text, pm_layout *layout) {
+    const pm_field *field;
+    unsigned int value, first, last, element, count, i;
+    char *p, *eol, *name;
+    int line, has_element, id;
+
+    memset(layout, 0, sizeof(pm_layout));
+
+    for (p = text, line = 1; *p; p = eol, line++) {
+        eol = strchr(p, '\n');
+        if (eol) *eol++ = 0;
+        else eol = p + strlen(p);
+        if ((name = strchr(p, '#'))) *name = 0;
+
+        skip_blanks(&p);
+        if (!*p) continue;
+
+        name = p;
+        while (*p && (isalnum((unsigned char)*p) || *p == '_')) p++;
+        has_element = *p == '[';
+        if (has_element) {
+            *p++ = 0;
+            if (!parse_number(&p, &element) || *p++ != ']') LAYOUT_ERROR("Invalid element number");
+        }
+        else if (*p) *p++ = 0;
+        skip_blanks(&p);
+
+        //Header
+        if (!has_element && islower((unsigned char)name[0])) {
+            if (!parse_number(&p, &value)) LAYOUT_ERROR("Expected a number");
+            //Elements are stored as unsigned short
+            if ((!strcmp(name, "max_cores") || !strcmp(name, "max_l3")) && value > USHRT_MAX) LAYOUT_ERROR("Too many elements");
+            if      (!strcmp(name, "version"))          layout->meta.version = value;
+            else if (!strcmp(name, "max_cores"))        layout->meta.max_cores = value;
+            else if (!strcmp(name, "max_l3"))           layout->meta.max_l3 = value;
+            else if (!strcmp(name, "zen_version"))      layout->meta.zen_version = value;
+            else if (!strcmp(name, "min_size"))         layout->meta.min_size = value;
+            else if (!strcmp(name, "experimental"))     layout->meta.experimental = value;
+            else if (!strcmp(name, "powersum_unclear")) layout->meta.powersum_unclear = value;
+            else if (!strcmp(name, "has_graphics"))     layout->meta.has_graphics = value;
+            else LAYOUT_ERROR("Unknown setting");
+            continue;
+        }
+
+        id = pm_field_lookup(name);
+        if (id < 0) LAYOUT_ERROR("Unknown PM Table field");
+        field = &pm_fields[id];
+
+        //Element counts of per core and per L3 arrays depend on the header
+        switch (field->kind) {
+            case PMT_FIELD_CORE:  count = layout->meta.max_cores; break;
+            case PMT_FIELD_L3:    count = layout->meta.max_l3; break;
+            default:              count = field->count; break;
+        }
+        if (field->kind != PMT_FIELD_SCALAR && !count) LAYOUT_ERROR("max_cores/max_l3 must be set before per core and L3 fields");
+
+        if (field->kind == PMT_FIELD_SCALAR || has_element) {
+            if (has_element && (field->kind == PMT_FIELD_SCALAR || element >= count)) LAYOUT_ERROR("Element out of range");
+            if (!parse_number(&p, &value)) LAYOUT_ERROR("Expected an index");
+            add_entry(layout, field - pm_fields, has_element ? element : 0, value);
+        }
+        else {
+            //A range first..last or a list of indices
+            for (element = 0; *p; ) {
+                if (!parse_number(&p, &first)) LAYOUT_ERROR("Expected an index");
+                last = first;
+                if (p[0] == '.' && p[1] == '.') {
+                    p += 2;
+                    if (!parse_number(&p, &last) || last < first) LAYOUT_ERROR("Invalid range");
+                }
+                if (element + last - first >= count) LAYOUT_ERROR("More elements than the array has");
+                for (i = first; i <= last; i++) add_entry(layout, field - pm_fields, element++, i);
+                skip_blanks(&p);
+                if (*p == ',') p++;
+                skip_blanks(&p);
+            }
+        }
+        skip_blanks(&p);
+        if (*p) LAYOUT_ERROR("Unexpected text after the value");
+    }
+
+    //Line 0: Applies to the whole file
+    line = 0;
+    if (!layout->meta.version) LAYOUT_ERROR("Missing version");
+    if (!layout->meta.min_size) LAYOUT_ERROR("Missing min_size");
+    for (i = 0; i < layout->num_entries; i++) {
+        if ((layout->entries[i].index + 1) * sizeof(float) > layout->meta.min_size)
+            LAYOUT_ERROR("Field beyond min_size");
+        //max_cores/max_l3 may have been lowered after the line was parsed
+        switch (pm_fields[layout->entries[i].field].kind) {
+            case PMT_FIELD_CORE: count = layout->meta.max_cores; break;
+            case PMT_FIELD_L3:   count = layout->meta.max_l3; break;
+            default:             count = pm_fields[layout->entries[i].field].count; break;
+        }
+        if (pm_fields[layout->entries[i].field].kind != PMT_FIELD_SCALAR && layout->entries[i].element >= count)
+            LAYOUT_ERROR("Element beyond max_cores/max_l3");
+    }
+}
+
+static int load_file(const char *path) {
+    pm_layout *list;
+    struct stat st;
+    char *text;
+    int fd, ok;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st)) {
+        fprintf(stderr, "Could not read the PM Table layout \"%s\".\n", path);
+        exit(0);
+    }
+    text = malloc(st.st_size + 1);
+    ok = text && read(fd, text, st.st_size) == st.st_size;
+    close(fd);
+    if (!ok) {
+        fprintf(stderr, "Could not read the PM Table layout \"%s\".\n", path);
+        exit(0);
+    }
+    text[st.st_size] = 0;
+
+    if (num_layouts == cap_layouts) {
+        cap_layouts = cap_layouts ? cap_layouts * 2 : 8;
+        list = realloc(layouts, cap_layouts * sizeof(pm_layout));
+        if (!list) {
+            fprintf(stderr, "Could not allocate memory for the PM Table layout.\n");
+            exit(0);
+        }
+        layouts = list;
+    }
+    parse_layout(path, text, &layouts[num_layouts++]);
+    free(text);
+
+    return 1;
+}
+
+int pm_layout_load(const char *path) {
+    char file[4096];
+    struct dirent *de;
+    struct stat st;
+    size_t len;
+    DIR *dir;
+    int n = 0;
+
+    if (stat(path, &st) || !S_ISDIR(st.st_mode))
+        return load_file(path);
+
+    dir = opendir(path);
+    if (!dir) {
+        fprintf(stderr, "Could not read the PM Table layout directory \"%s\".\n", path);
+        exit(0);
+    }
+    while ((de = readdir(dir))) {
+        len = strlen(de->d_name);
+        if (len < 8 || strcmp(de->d_name + len - 7, ".layout")) continue;
+        snprintf(file, sizeof(file), "%s/%s", path, de->d_name);
+        n += load_file(file);
+    }
+    closedir(dir);
+
+    return n;
+}
+
+int pm_layout_select(unsigned int version, pm_table *pmt, void *base_addr) {
+    const pm_field *field;
+    pm_layout_entry *e;
+    pm_layout *layout;
+    float *ptr;
+    char *member;
+    unsigned int i;
+
+    //Later files override earlier ones
+    for (i = num_layouts; i > 0 && layouts[i - 1].meta.version != version; i--);
+    if (!i) return 0;
+    layout = &layouts[i - 1];
+
+    memcpy(pmt, &layout->meta, offsetof(pm_table, STAPM_LIMIT));
+    pmt->from_file = 1;
+    pm_table_alloc_arrays(pmt);
+
+    for (i = 0; i < layout->num_entries; i++) {
+        e = &layout->entries[i];
+        field = &pm_fields[e->field];
+        member = (char*)pmt + field->offset;
+        ptr = (float*)base_addr + e->index;
+        switch (field->kind) {
+            case PMT_FIELD_SCALAR: *(float**)member = ptr; break;
+            case PMT_FIELD_CORE:
+            case PMT_FIELD_L3:     (*(float***)member)[e->element] = ptr; break;
+            case PMT_FIELD_FIXED:  ((float**)member)[e->element] = ptr; break;
+        }
+    }
+
+    return 1;
+}
@@ -0,0 +1,33 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef PM_LAYOUT_H
+#define PM_LAYOUT_H
+
+#include "pm_tables.h"
+
+//Loads a layout definition file, or every *.layout file in a directory.
+//Exits with a message on syntax errors. Returns the number of layouts loaded.
+int pm_layout_load(const char *path);
+
+//Fills pmt from a loaded layout of the given version, pointing into base_addr.
+//Returns 0 if no layout for this version was loaded.
+int pm_layout_select(unsigned int version, pm_table *pmt, void *base_addr);
+
+#endif
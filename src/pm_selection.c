@@ -0,0 +1,183 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fnmatch.h>
+
+#include "pm_selection.h"
+
+#define PMT_MEMBER(pmt, f) ((const char*)(pmt) + pm_fields[f].offset)
+
+int pm_field_length(const pm_table *pmt, int field) {
+    switch (pm_fields[field].kind) {
+        case PMT_FIELD_CORE:  return pmt->max_cores;
+        case PMT_FIELD_L3:    return pmt->max_l3;
+        case PMT_FIELD_FIXED: return pm_fields[field].count;
+        default:              return 1;
+    }
+}
+
+const float* pm_field_element(const pm_table *pmt, int field, int element) {
+    float **arr;
+
+    switch (pm_fields[field].kind) {
+        case PMT_FIELD_SCALAR:
+            return *(float* const*)PMT_MEMBER(pmt, field);
+        case PMT_FIELD_FIXED:
+            return ((float* const*)PMT_MEMBER(pmt, field))[element];
+        default:
+            arr = *(float** const*)PMT_MEMBER(pmt, field);
+            return arr ? arr[element] : NULL;
+    }
+}
+
+//Copies one pattern. Brackets around a plain number are escaped, so "CORE_POWER[3]" selects
+//that element instead of being a character class.
+static int copy_pattern(char *dst, size_t size, const char *src, size_t len) {
+    size_t i, j, k;
+
+    for (i = 0, j = 0; i < len; i++) {
+        if (src[i] == '[') {
+            for (k = i + 1; k < len && src[k] >= '0' && src[k] <= '9'; k++);
+            if (k > i + 1 && k < len && src[k] == ']') {
+                if (j + (k - i) + 3 >= size) return 0;
+                dst[j++] = '\\';
+                memcpy(dst + j, src + i, k - i);
+                j += k - i;
+                dst[j++] = '\\';
+                dst[j++] = ']';
+                i = k;
+                continue;
+            }
+        }
+        if (j + 1 >= size) return 0;
+        dst[j++] = src[i];
+    }
+    dst[j] = 0;
+
+    return 1;
+}
+
+//Checks the name of the field and, for arrays, "NAME[i]" against each pattern
+static int match_patterns(const char *patterns, const char *name, int element, int is_array) {
+    char pattern[128], elem_name[128];
+    const char *p, *end;
+    size_t len;
+
+    if (!patterns || !*patterns) return 1;
+    if (is_array) snprintf(elem_name, sizeof(elem_name), "%s[%d]", name, element);
+
+    for (p = patterns; *p; p = *end ? end + 1 : end) {
+        end = strchr(p, ',');
+        if (!end) end = p + strlen(p);
+        len = end - p;
+        if (!len) continue;
+        if (!copy_pattern(pattern, sizeof(pattern), p, len)) continue;
+
+        if (!fnmatch(pattern, name, 0)) return 1;
+        if (is_array && !fnmatch(pattern, elem_name, 0)) return 1;
+    }
+
+    return 0;
+}
+
+int pm_selection_compile(pm_selection *sel, const pm_table *pmt, const char *patterns) {
+    unsigned int cap = 0;
+    int f, e, n;
+    const float *src;
+    void *p;
+
+    memset(sel, 0, sizeof(pm_selection));
+
+    for (f = 0; f < PMT_NUM_FIELDS; f++) {
+        n = pm_field_length(pmt, f);
+        for (e = 0; e < n; e++) {
+            src = pm_field_element(pmt, f, e);
+            if (!src) continue;
+            if (!match_patterns(patterns, pm_fields[f].name, e, pm_fields[f].kind != PMT_FIELD_SCALAR)) continue;
+
+            if (sel->num_refs == cap) {
+                cap = cap ? cap * 2 : 64;
+                if (!(p = realloc(sel->refs, cap * sizeof(pm_selection_ref)))) goto fail;
+                sel->refs = p;
+                if (!(p = realloc(sel->src, cap * sizeof(float*)))) goto fail;
+                sel->src = p;
+            }
+            sel->refs[sel->num_refs].field = f;
+            sel->refs[sel->num_refs].element = e;
+            sel->src[sel->num_refs] = src;
+            sel->num_refs++;
+        }
+    }
+
+    sel->values = calloc(sel->num_refs ? sel->num_refs : 1, sizeof(float));
+    if (!sel->values) goto fail;
+
+    return sel->num_refs;
+
+fail:
+    pm_selection_free(sel);
+    return -1;
+}
+
+void pm_selection_free(pm_selection *sel) {
+    free(sel->refs);
+    free(sel->src);
+    free(sel->values);
+    free(sel->baseline);
+    memset(sel, 0, sizeof(pm_selection));
+}
+
+int pm_selection_set_baseline(pm_selection *sel, const unsigned char *pm_buf, const float *baseline) {
+    unsigned int i;
+
+    free(sel->baseline);
+    sel->baseline = malloc((sel->num_refs ? sel->num_refs : 1) * sizeof(float));
+    if (!sel->baseline) return 0;
+    for (i = 0; i < sel->num_refs; i++)
+        sel->baseline[i] = baseline[sel->src[i] - (const float*)pm_buf];
+
+    return 1;
+}
+
+void pm_selection_span(const pm_selection *sel, const unsigned char *pm_buf, unsigned int *offset, unsigned int *length) {
+    const float *first, *last;
+    unsigned int i;
+
+    *offset = *length = 0;
+    if (!sel->num_refs) return;
+
+    first = last = sel->src[0];
+    for (i = 1; i < sel->num_refs; i++) {
+        if (sel->src[i] < first) first = sel->src[i];
+        if (sel->src[i] > last) last = sel->src[i];
+    }
+    *offset = (const unsigned char*)first - pm_buf;
+    *length = (const unsigned char*)(last + 1) - (const unsigned char*)first;
+}
+
+void pm_selection_decode(pm_selection *sel) {
+    unsigned int i;
+
+    for (i = 0; i < sel->num_refs; i++) sel->values[i] = *sel->src[i];
+    if (sel->baseline)
+        for (i = 0; i < sel->num_refs; i++) sel->values[i] -= sel->baseline[i];
+}
@@ -0,0 +1,63 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef PM_SELECTION_H
+#define PM_SELECTION_H
+
+#include "pm_tables.h"
+
+//A subset of the PM table values, picked by name. Only the selected values are copied out of
+//the PM table per sample, so exporters and recorders don't pay for the fields they don't use.
+typedef struct {
+    unsigned short field;   //Index into pm_fields
+    unsigned short element; //0 for scalars
+} pm_selection_ref;
+
+typedef struct {
+    unsigned int num_refs;
+    pm_selection_ref *refs; //Ordered like pm_fields, elements ascending
+    const float **src;      //Location of each value in the PM table buffer
+    float *values;          //Filled by pm_selection_decode
+    float *baseline;        //Subtracted from values if not NULL
+} pm_selection;
+
+//Number of elements of a field in the selected PM table version. 1 for scalars.
+int pm_field_length(const pm_table *pmt, int field);
+//Location of an element of a field in the PM table buffer. NULL if the version doesn't have it.
+const float* pm_field_element(const pm_table *pmt, int field, int element);
+
+//Selects the values of pmt matching a comma separated list of glob patterns. A pattern
+//matches a whole field ("CORE_TEMP*", "L3_*") or single elements of an array ("CORE_POWER[0]").
+//NULL or an empty string selects everything. Fields the version doesn't have are left out.
+//Returns the number of selected values, -1 if memory could not be allocated.
+int pm_selection_compile(pm_selection *sel, const pm_table *pmt, const char *patterns);
+void pm_selection_free(pm_selection *sel);
+
+//Reports the selected values as differences to the PM table in baseline, which has the layout
+//of pm_buf. Returns 0 if memory could not be allocated.
+int pm_selection_set_baseline(pm_selection *sel, const unsigned char *pm_buf, const float *baseline);
+
+//Byte range of the PM table buffer that holds all selected values. Reading just this range is
+//enough for pm_selection_decode. Empty if nothing is selected.
+void pm_selection_span(const pm_selection *sel, const unsigned char *pm_buf, unsigned int *offset, unsigned int *length);
+
+//Copies the selected values out of the PM table buffer. Call after each read of the PM table.
+void pm_selection_decode(pm_selection *sel);
+
+#endif
@@ -21,7 +21,12 @@
  * This file contains the mapping of every known PM Table version
  **/
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "pm_tables.h"
+#include "pm_layout.h"
 
 //Calculate memory address of element
 #define pm_element(i) ((float*) (base_addr + (i)*4))
@@ -49,6 +54,62 @@
     arr[ 8]=pm_element(e+ 8); arr[ 9]=pm_element(e+ 9); arr[10]=pm_element(e+10); arr[11]=pm_element(e+11);\
     arr[12]=pm_element(e+12); arr[13]=pm_element(e+13); arr[14]=pm_element(e+14); arr[15]=pm_element(e+15);
 
+//Picks the per core and per L3 arrays out of PM_TABLE_FIELDS. Used to allocate them in one block.
+#define PMT_ARRAY_SCALAR(name, core, l3)
+#define PMT_ARRAY_FIXED(name, core, l3)
+#define PMT_ARRAY_CORE(name, core, l3) core(name)
+#define PMT_ARRAY_L3(name, core, l3)   l3(name)
+
+void pm_table_alloc_arrays(pm_table *pmt) {
+    float **pool;
+
+#define PMT_SIZE_CORE(name) + pmt->max_cores
+#define PMT_SIZE_L3(name)   + pmt->max_l3
+#define PMT_POOL_SIZE(name, kind, count, unit, category) PMT_ARRAY_##kind(name, PMT_SIZE_CORE, PMT_SIZE_L3)
+    pool = calloc(0 PM_TABLE_FIELDS(PMT_POOL_SIZE), sizeof(float*));
+    if (!pool) {
+        fprintf(stderr, "Could not allocate memory for the PM Table.\n");
+        exit(0);
+    }
+    pmt->array_pool = pool;
+
+#define PMT_ASSIGN_CORE(name) pmt->name = pool; pool += pmt->max_cores;
+#define PMT_ASSIGN_L3(name)   pmt->name = pool; pool += pmt->max_l3;
+#define PMT_ASSIGN_ARRAY(name, kind, count, unit, category) PMT_ARRAY_##kind(name, PMT_ASSIGN_CORE, PMT_ASSIGN_L3)
+    PM_TABLE_FIELDS(PMT_ASSIGN_ARRAY)
+}
+
+void pm_table_free(pm_table *pmt) {
+    free(pmt->array_pool);
+    pmt->array_pool = NULL;
+#define PMT_CLEAR(name) pmt->name = NULL;
+#define PMT_CLEAR_ARRAY(name, kind, count, unit, category) PMT_ARRAY_##kind(name, PMT_CLEAR, PMT_CLEAR)
+    PM_TABLE_FIELDS(PMT_CLEAR_ARRAY)
+}
+
+int select_pm_table_version(unsigned int version, pm_table *pmt, unsigned char *pm_buf) {
+    //Initialize pmt to 0. This also sets all pointers to 0, which signifies non-existiting fields.
+    //Access via pmta(...) will check if pointer is 0 before trying to access the value.
+    memset(pmt, 0, sizeof(pm_table));
+
+     //Select matching PM Table. Layouts loaded from files take precedence.
+    if (!pm_layout_select(version, pmt, pm_buf)) {
+        switch(version) {
+#define PMT_SELECT_CASE(v) case v: pm_table_##v(pmt, pm_buf); break;
+            PM_TABLE_VERSIONS(PMT_SELECT_CASE)
+            default:
+                return 0;
+        }
+    }
+
+    //APML_POWER is probably identical to PACKAGE_POWER
+    if (pmt->PACKAGE_POWER == NULL) pmt->PACKAGE_POWER = pmt->APML_POWER;
+
+    if (pmt->VDD18_POWER == NULL) pmt->VDD18_POWER = pmt->IO_VDD18_POWER;
+
+    return 1;
+}
+
 void pm_table_0x380804(pm_table *pmt, void* base_addr) {
     // Tested with:
     // Ryzen 5900X on Gigabyte B55M AORUS Pro-P, Bios V11p
@@ -59,6 +120,7 @@ void pm_table_0x380804(pm_table *pmt, void* base_addr) {
     pmt->max_cores = 16; //Number of cores supported by this PM table version
     pmt->max_l3 = 2; //Number of L3 caches supported by this PM table version
     pmt->zen_version = 3; //Zen3
+    pm_table_alloc_arrays(pmt);
 
     /* Legend for notes in comments:
      * o = ok. I'm confident this is the right value.
@@ -261,6 +323,7 @@ void pm_table_0x380805(pm_table *pmt, void* base_addr) {
     pmt->max_cores = 16; //Number of cores supported by this PM table version
     pmt->max_l3 = 2; //Number of L3 caches supported by this PM table version
     pmt->zen_version = 3; //Zen3
+    pm_table_alloc_arrays(pmt);
 
     /* Legend for notes in comments:
      * o = ok. I'm confident this is the right value.
@@ -470,6 +533,7 @@ void pm_table_0x380904(pm_table *pmt, void* base_addr) {
     pmt->max_cores = 8; //Number of cores supported by this PM table version
     pmt->max_l3 = 1; //Number of L3 caches supported by this PM table version
     pmt->zen_version = 3; //Zen3
+    pm_table_alloc_arrays(pmt);
 
 
     pmt->PPT_LIMIT                  = pm_element(0);
@@ -667,6 +731,7 @@ void pm_table_0x380905(pm_table *pmt, void* base_addr) {
     pmt->max_cores = 8; //Number of cores supported by this PM table version
     pmt->max_l3 = 1; //Number of L3 caches supported by this PM table version
     pmt->zen_version = 3; //Zen3
+    pm_table_alloc_arrays(pmt);
 
 
     pmt->PPT_LIMIT                  = pm_element(0);
@@ -866,6 +931,7 @@ void pm_table_0x400005(pm_table *pmt, void* base_addr) {
     pmt->max_cores = 8; //Number of cores supported by this PM table version
     pmt->max_l3 = 1; //Number of L3 caches supported by this PM table version
     pmt->zen_version = 3; //Zen3
+    pm_table_alloc_arrays(pmt);
     pmt->experimental = 0; //Print experimental note
     pmt->powersum_unclear = 1; //No idea how to calculate the total power
     pmt->has_graphics = 1; //Print GFX information
@@ -1161,7 +1227,9 @@ void pm_table_0x240903(pm_table *pmt, void* base_addr) {
 
     pmt->version = 0x240903;
     pmt->max_cores = 8; //Number of cores supported by this PM table version
+    pmt->max_l3 = 2; //Number of L3 caches supported by this PM table version
     pmt->zen_version = 2; //Zen2
+    pm_table_alloc_arrays(pmt);
 
     pmt->PPT_LIMIT                  = pm_element( 0);
     pmt->PPT_VALUE                  = pm_element( 1);
@@ -1345,6 +1413,7 @@ void pm_table_0x240803(pm_table *pmt, void* base_addr) {
     pmt->max_cores = 16; //Number of cores supported by this PM table version
     pmt->max_l3 = 4; //Number of L3 caches supported by this PM table version
     pmt->zen_version = 2; //Zen2
+    pm_table_alloc_arrays(pmt);
 
     pmt->PPT_LIMIT                  = pm_element( 0);
     pmt->PPT_VALUE                  = pm_element( 1);
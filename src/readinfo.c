@@ -23,13 +23,11 @@
 #include <stdio.h>
 #include <cpuid.h>
 #include <ctype.h>
-#include <libsmu.h>
+#include <string.h>
 #include "readinfo.h"
 
-extern smu_obj_t obj;
-
-#define READ_SMN_V1(offs) { if (smu_read_smn_addr(&obj, offs + offset, &value1) != SMU_Return_OK) goto _READ_ERROR; }
-#define READ_SMN_V2(offs) { if (smu_read_smn_addr(&obj, offs + offset, &value2) != SMU_Return_OK) goto _READ_ERROR; }
+#define READ_SMN_V1(offs) { if (smu_read_smn_addr(obj, offs + offset, &value1) != SMU_Return_OK) goto _READ_ERROR; }
+#define READ_SMN_V2(offs) { if (smu_read_smn_addr(obj, offs + offset, &value2) != SMU_Return_OK) goto _READ_ERROR; }
 
 void append_u32_to_str(char* buffer, unsigned int val) {
     buffer[0] = val & 0xff;
@@ -38,10 +36,10 @@ void append_u32_to_str(char* buffer, unsigned int val) {
     buffer[3] = (val >> 24) & 0xff;
 }
 
-const char* get_processor_name() {
+const char* get_processor_name(char *out, size_t size) {
     unsigned int eax, ebx, ecx, edx;
+    char buffer[PROCESSOR_NAME_LEN + 3] = { 0 }, *p;
     int i;
-    static char buffer[50] = { 0 }, *p;
 
     i=0;
     __get_cpuid(0x80000002, &eax, &ebx, &ecx, &edx);
@@ -68,7 +66,8 @@ const char* get_processor_name() {
     while(isspace(p[i]) && i>=0) p[i--]=0;
     while(*p && isspace(*p)) p++;
 
-    return p;
+    snprintf(out, size, "%s", p);
+    return out;
 }
 
 unsigned int count_set_bits(unsigned int v) {
@@ -82,57 +81,96 @@ unsigned int count_set_bits(unsigned int v) {
     return result;
 }
 
-void get_processor_topology(system_info *sysinfo, unsigned int zen_version) {
+void set_core_disabled(system_info *sysinfo, unsigned int core) {
+    unsigned int words, old_words;
+    unsigned int *map;
+
+    if (core >= sysinfo->core_disable_map_size) {
+        old_words = (sysinfo->core_disable_map_size + 31) / 32;
+        words = (core + 32) / 32;
+        map = realloc(sysinfo->core_disable_map, words * sizeof(unsigned int));
+        if (!map) {
+            fprintf(stderr, "Could not allocate memory for the core map.\n");
+            exit(0);
+        }
+        memset(map + old_words, 0, (words - old_words) * sizeof(unsigned int));
+        sysinfo->core_disable_map = map;
+        sysinfo->core_disable_map_size = words * 32;
+    }
+    sysinfo->core_disable_map[core / 32] |= 1u << (core % 32);
+}
+
+unsigned int count_disabled_cores(system_info *sysinfo, unsigned int first, unsigned int count) {
+    unsigned int i, result = 0;
+
+    for (i = first; i < first + count && i < sysinfo->core_disable_map_size; i++)
+        result += core_disabled(sysinfo, i);
+
+    return result;
+}
+
+void free_core_disable_map(system_info *sysinfo) {
+    free(sysinfo->core_disable_map);
+    sysinfo->core_disable_map = NULL;
+    sysinfo->core_disable_map_size = 0;
+}
+
+void get_processor_topology(smu_obj_t *obj, system_info *sysinfo, unsigned int zen_version) {
     unsigned int ccds_present, ccds_down, ccd_enable_map, ccd_disable_map,
-        core_disable_map_addr, core_disable_map_tmp, logical_cores, threads_per_core,
-        fam, model, fuse1, fuse2, offs, eax, ebx, ecx, edx;
+        core_disable_map_addr, logical_cores, threads_per_core,
+        fam, model, fuse[2], fuse_value[2], offs, ccd, i, n, eax, ebx, ecx, edx;
+    unsigned int ccd_addr[8], ccd_map[8];
 
     __get_cpuid(0x00000001, &eax, &ebx, &ecx, &edx);
     fam = ((eax & 0xf00) >> 8) + ((eax & 0xff00000) >> 20);
     model = ((eax & 0xf0000) >> 12) + ((eax & 0xf0) >> 4);
-    logical_cores = (ebx >> 16) & 0xFF;
+
+    //Number of threads in the package. Leaf 1 only holds an 8 bit count that is not
+    //guaranteed to match on large parts.
+    __get_cpuid(0x80000008, &eax, &ebx, &ecx, &edx);
+    logical_cores = (ecx & 0xFF) + 1;
 
     __get_cpuid(0x8000001E, &eax, &ebx, &ecx, &edx);
     threads_per_core = ((ebx >> 8) & 0xF) + 1;
 
-    fuse1 = 0x5D218;
-    fuse2 = 0x5D21C;
+    fuse[0] = 0x5D218;
+    fuse[1] = 0x5D21C;
     offs = 0x238;
 
     if (fam == 0x19) {
-        //fuse1 += 0x10;
-        //fuse2 += 0x10;
+        //fuse[0] += 0x10;
+        //fuse[1] += 0x10;
         offs = 0x598;
     }
     else if (fam == 0x17 && model != 0x71 && model != 0x31) {
-        fuse1 += 0x40;
-        fuse2 += 0x40;
+        fuse[0] += 0x40;
+        fuse[1] += 0x40;
     }
 
-    if (smu_read_smn_addr(&obj, fuse1, &ccds_present) != SMU_Return_OK ||
-        smu_read_smn_addr(&obj, fuse2, &ccds_down) != SMU_Return_OK) {
+    if (smu_read_smn_addrs(obj, fuse, fuse_value, 2) != SMU_Return_OK) {
         perror("Failed to read CCD fuses");
         exit(-1);
     }
+    ccds_present = fuse_value[0];
+    ccds_down = fuse_value[1];
 
     ccd_enable_map = (ccds_present >> 22) & 0xff;
     ccd_disable_map = ((ccds_present >> 30) & 0x3) | ((ccds_down & 0x3f) << 2);
 
+    //Each CCD has its own copy of the fuse, 0x2000000 apart. 8 cores per CCD.
     core_disable_map_addr = (0x30081800 + offs);
-    sysinfo->core_disable_map = 0;
-    if (ccd_enable_map & 0x01) {
-        if (smu_read_smn_addr(&obj, core_disable_map_addr, &core_disable_map_tmp) != SMU_Return_OK) {
-            perror("Failed to read disabled core fuse");
-            exit(-1);
-        }
-        sysinfo->core_disable_map |= core_disable_map_tmp & 0xff;
+    free_core_disable_map(sysinfo);
+    for (ccd = 0, n = 0; ccd < 8; ccd++)
+        if ((ccd_enable_map >> ccd) & 0x01) ccd_addr[n++] = core_disable_map_addr | (ccd << 25);
+    if (smu_read_smn_addrs(obj, ccd_addr, ccd_map, n) != SMU_Return_OK) {
+        perror("Failed to read disabled core fuse");
+        exit(-1);
     }
-    if (ccd_enable_map & 0x02) {
-        if (smu_read_smn_addr(&obj, core_disable_map_addr|0x2000000, &core_disable_map_tmp) != SMU_Return_OK) {
-            perror("Failed to read disabled core fuse");
-            exit(-1);
-        }
-        sysinfo->core_disable_map |= (core_disable_map_tmp & 0xff)<<8;
+    for (ccd = 0, n = 0; ccd < 8; ccd++) {
+        if (!((ccd_enable_map >> ccd) & 0x01)) continue;
+        for (i = 0; i < 8; i++)
+            if ((ccd_map[n] >> i) & 0x01) set_core_disabled(sysinfo, ccd * 8 + i);
+        n++;
     }
 
 
@@ -149,28 +187,29 @@ void get_processor_topology(system_info *sysinfo, unsigned int zen_version) {
             if (model != 0x50) {// Exclude Cezanne
                 sysinfo->ccxs = 0;
                 sysinfo->ccds = count_set_bits(ccd_enable_map);
-                sysinfo->cores_per_ccx = 8 - count_set_bits(sysinfo->core_disable_map & 0xff);
-                sysinfo->enabled_cores_count = 8*(sysinfo->ccds) - count_set_bits(sysinfo->core_disable_map);
+                sysinfo->cores_per_ccx = 8 - count_disabled_cores(sysinfo, 0, 8);
 
             } else {
-                sysinfo->core_disable_map = sysinfo->core_disable_map_pmt;
+                free_core_disable_map(sysinfo);
+                for (i = 0; i < 8; i++)
+                    if ((sysinfo->core_disable_map_pmt >> i) & 0x01) set_core_disabled(sysinfo, i);
                 sysinfo->ccds = 1;
                 sysinfo->cores_per_ccx = 8;
             }
-            sysinfo->enabled_cores_count = 8*(sysinfo->ccds) - count_set_bits(sysinfo->core_disable_map);
+            sysinfo->enabled_cores_count = 8*(sysinfo->ccds) - count_disabled_cores(sysinfo, 0, sysinfo->core_disable_map_size);
             break;
         case 2:
         default:
-            sysinfo->cores_per_ccx = (8 - count_set_bits(sysinfo->core_disable_map & 0xff)) / 2;
+            sysinfo->cores_per_ccx = (8 - count_disabled_cores(sysinfo, 0, 8)) / 2;
             sysinfo->ccds = count_set_bits(ccd_enable_map);
             sysinfo->ccxs = sysinfo->cores == sysinfo->cores_per_ccx ? 1 : sysinfo->ccds * 2;
-            sysinfo->enabled_cores_count = 8*(sysinfo->ccds) - count_set_bits(sysinfo->core_disable_map);
+            sysinfo->enabled_cores_count = 8*(sysinfo->ccds) - count_disabled_cores(sysinfo, 0, sysinfo->core_disable_map_size);
             break;
     }
     sysinfo->available=1;
 }
 
-void print_memory_timings() {
+void print_memory_timings(smu_obj_t *obj) {
     const char* bool_str[2] = { "Disabled", "Enabled" };
     unsigned int value1, value2, offset;
 
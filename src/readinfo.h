@@ -20,25 +20,42 @@
 #ifndef READINFO_H
 #define READINFO_H
 
+#include <stddef.h>
+#include <libsmu.h>
+
+//CPUID brand string: 48 characters and the terminator
+#define PROCESSOR_NAME_LEN 49
+
 typedef struct {
     char available;
-    const char *cpu_name;
+    char cpu_name[PROCESSOR_NAME_LEN];
     const char *codename;
-    const char *smu_fw_ver;
+    const char *smu_fw_ver;                 //Owned by the smu_obj_t
     unsigned int if_ver;   
     unsigned int cores;
     unsigned int ccds;
     unsigned int ccxs;
     unsigned int cores_per_ccx;
-    unsigned int core_disable_map;
+    unsigned int *core_disable_map;         //Bitmap of fused off cores, 8 cores per CCD
+    unsigned int core_disable_map_size;     //Number of cores covered by core_disable_map
     unsigned int core_disable_map_pmt;
     unsigned int enabled_cores_count;
 } system_info;
 
-void print_memory_timings();
-void get_processor_topology(system_info *sysinfo, unsigned int zen_version);
+//Cores beyond the end of the map are not disabled
+#define core_disabled(sysinfo, i) ((unsigned int)(i) < (sysinfo)->core_disable_map_size && \
+    (((sysinfo)->core_disable_map[(unsigned int)(i) / 32] >> ((unsigned int)(i) % 32)) & 0x01))
+
+//All SMN reads go through the given context. The driver has a single SMN address and mailbox, so
+//libsmu serializes them across all contexts of the process.
+void print_memory_timings(smu_obj_t *obj);
+void get_processor_topology(smu_obj_t *obj, system_info *sysinfo, unsigned int zen_version);
 unsigned int count_set_bits(unsigned int v);
-const char* get_processor_name();
+void set_core_disabled(system_info *sysinfo, unsigned int core);
+unsigned int count_disabled_cores(system_info *sysinfo, unsigned int first, unsigned int count);
+void free_core_disable_map(system_info *sysinfo);
+//Writes the trimmed CPUID brand string to buffer and returns the start of it.
+const char* get_processor_name(char *buffer, size_t size);
 void append_u32_to_str(char* buffer, unsigned int val);
 
 #endif
@@ -0,0 +1,132 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <time.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "recording.h"
+
+#define RECORDING_BUFFER (1 << 20)
+
+static uint64_t realtime_ns() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void recording_create(recording_writer *w, const char *path, unsigned int version, unsigned int size) {
+    recording_header h;
+
+    memset(w, 0, sizeof(recording_writer));
+    memset(&h, 0, sizeof(recording_header));
+    strcpy(h.magic, RECORDING_MAGIC);
+    h.format = RECORDING_FORMAT;
+    h.pm_table_version = version;
+    h.pm_table_size = size;
+    h.start_ns = realtime_ns();
+
+    w->fp = fopen(path, "wb");
+    if (!w->fp) {
+        fprintf(stderr, "Could not create the recording \"%s\".\n", path);
+        exit(0);
+    }
+    setvbuf(w->fp, NULL, _IOFBF, RECORDING_BUFFER);
+    if (fwrite(&h, sizeof(recording_header), 1, w->fp) != 1) {
+        fprintf(stderr, "Could not write the recording \"%s\".\n", path);
+        exit(0);
+    }
+}
+
+void recording_write(recording_writer *w, const unsigned char *pm_buf, unsigned int size) {
+    uint64_t t;
+
+    if (!w->fp) return;
+    t = realtime_ns();
+    //A full disk can still leave a torn frame when the buffer is flushed. Stop at the first error,
+    //so it is the last one, which recording_open drops.
+    if (fwrite(&t, sizeof(t), 1, w->fp) != 1 || fwrite(pm_buf, size, 1, w->fp) != 1) {
+        fprintf(stderr, "Could not write the recording. Stopped recording.\n");
+        fclose(w->fp);
+        w->fp = NULL;
+        return;
+    }
+    w->frames++;
+}
+
+void recording_close(recording_writer *w) {
+    if (w->fp) fclose(w->fp);
+    w->fp = NULL;
+}
+
+int recording_open(recording *r, const char *path) {
+    struct stat st;
+    void *map;
+    int fd;
+
+    memset(r, 0, sizeof(recording));
+    fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+    if (fstat(fd, &st) || st.st_size < (off_t)sizeof(recording_header)) {
+        close(fd);
+        return 0;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return 0;
+
+    memcpy(&r->header, map, sizeof(recording_header));
+    if (memcmp(r->header.magic, RECORDING_MAGIC, sizeof(RECORDING_MAGIC)) || r->header.format != RECORDING_FORMAT
+        || !r->header.pm_table_size) {
+        munmap(map, st.st_size);
+        return 0;
+    }
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+    r->map = map;
+    r->map_size = st.st_size;
+    r->frame_size = sizeof(uint64_t) + r->header.pm_table_size;
+    //A torn last frame of a recording that was killed or ran out of disk space is ignored
+    r->frames = (st.st_size - sizeof(recording_header)) / r->frame_size;
+
+    return 1;
+}
+
+void recording_free(recording *r) {
+    if (r->map) munmap((void*)r->map, r->map_size);
+    memset(r, 0, sizeof(recording));
+}
+
+uint64_t recording_find(const recording *r, uint64_t t_ns) {
+    uint64_t lo = 0, hi = r->frames, mid;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (recording_timestamp(r, mid) < t_ns) lo = mid + 1;
+        else hi = mid;
+    }
+
+    return lo;
+}
@@ -0,0 +1,74 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef RECORDING_H
+#define RECORDING_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/**
+ * Recordings of raw PM tables.
+ *
+ * A 32 byte header is followed by frames of equal size: a 64 bit
+ * CLOCK_REALTIME timestamp in nanoseconds and the raw PM table. All values
+ * are stored in the byte order of the machine that recorded them.
+ **/
+
+#define RECORDING_MAGIC   "RYZMREC"
+#define RECORDING_FORMAT  1
+
+typedef struct {
+    char magic[8];              //RECORDING_MAGIC, 0 terminated
+    uint32_t format;            //RECORDING_FORMAT
+    uint32_t pm_table_version;
+    uint32_t pm_table_size;     //Bytes of PM table per frame
+    uint32_t reserved;
+    uint64_t start_ns;          //Creation of the file. file@start:end ranges are relative to it.
+} recording_header;
+
+typedef struct {
+    FILE *fp;
+    uint64_t frames;
+} recording_writer;
+
+typedef struct {
+    recording_header header;
+    const unsigned char *map;   //Whole file, mapped read only
+    size_t map_size;
+    uint64_t frames;
+    size_t frame_size;          //Timestamp + PM table
+} recording;
+
+//Creates the file and writes the header. Exits on errors like the rest of the setup.
+void recording_create(recording_writer *w, const char *path, unsigned int version, unsigned int size);
+void recording_write(recording_writer *w, const unsigned char *pm_buf, unsigned int size);
+void recording_close(recording_writer *w);
+
+//Maps a recording. Returns 0 if the file can't be read or is no recording.
+int recording_open(recording *r, const char *path);
+void recording_free(recording *r);
+
+#define recording_timestamp(r, i) (*(const uint64_t*)((r)->map + sizeof(recording_header) + (i) * (r)->frame_size))
+#define recording_table(r, i) ((r)->map + sizeof(recording_header) + (i) * (r)->frame_size + sizeof(uint64_t))
+
+//Index of the first frame at or after t_ns. frames if there is none.
+uint64_t recording_find(const recording *r, uint64_t t_ns);
+
+#endif
@@ -29,19 +29,65 @@
 #include <stdarg.h>
 #include <signal.h>
 #include <unistd.h>
+#include <getopt.h>
 #include <string.h>
+#include <time.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
 #include <libsmu.h>
 #include "readinfo.h"
 #include "pm_tables.h"
+#include "pm_layout.h"
+#include "workload.h"
+#include "cpu_topology.h"
+#include "perf_counters.h"
+#include "energy_attribution.h"
+#include "core_stats.h"
+#include "pm_frame.h"
+#include "pm_selection.h"
+#include "exporters.h"
+#include "layout_learn.h"
+#include "stimulus.h"
+#include "recording.h"
+#include "pm_diff.h"
+#include "baseline.h"
+#include "smu_sim.h"
+#include "platform_cache.h"
+#include "low_perturbation.h"
+#include "self_overhead.h"
+#include "timing.h"
 
 #define PROGRAM_VERSION "1.0.6"
 
+#define LEARN_DEFAULT_SAMPLES  2000
+#define LEARN_DEFAULT_INTERVAL 0.005
+#define STIM_DEFAULT_INTERVAL  0.01
+
 smu_obj_t obj;
-static int update_time_s = 1;
+static double update_time_s = 1;
 static int show_disabled_cores = 0;
+static int show_cpu_mapping = 0;
+static int perf_counter_mode = 0;
+static int attribution_top = 0;
+static export_format export_mode = EXPORT_NONE;
+static char *field_patterns = NULL;
+static char *recording_path = NULL;
+static recording_writer recorder;
+static char *baseline_spec = NULL;
+static float *baseline = NULL;
+static int show_smu_stats = 0;
+static int run_once = 0;
+static int use_platform_cache = 1;
+static platform_cache pcache;
+static int low_perturbation_mode = 0;
+static int low_perturbation_cpu = -1;
+static low_perturbation lowpert;
+static int show_overhead = 0;
+static self_overhead overhead;
+//Set by the signal handler while a sample loop polls it. The loop finishes the sample and returns.
+static volatile sig_atomic_t poll_interrupt = 0;
+static volatile sig_atomic_t interrupted = 0;
 
 void print_line(const char* label, const char* value_format, ...) {
     static char buffer[1024];
@@ -54,18 +100,23 @@ void print_line(const char* label, const char* value_format, ...) {
     fprintf(stdout, "│ %45s │ %46s │\n", label, buffer);
 }
 
-//Helper to access the PM Table elements. If an element doesn't exist in the
-//current PM Table version, it's pointer is set to 0. This helper returns
-//NAN for not available fields.
-#define pmta(elem) ((pmt->elem)?(*pmt->elem):NAN)
-//Same, but with 0 as return. For summations that should not fail if one value is not present.
-#define pmta0(elem) ((pmt->elem)?(*pmt->elem):0)
+//Value, limit and usage in %. With a baseline both are differences, so the ratio is left out.
+void print_limit_line(const char* label, const char* value_format, float value, float limit) {
+    char format[64];
+
+    if (baseline) {
+        print_line(label, value_format, value, limit);
+        return;
+    }
+    snprintf(format, sizeof(format), "%s | %%8.2f %%%%", value_format);
+    print_line(label, format, value, limit, value / limit * 100);
+}
 
-void draw_screen(pm_table *pmt, system_info *sysinfo) {
+void draw_screen(pm_frame *frame, system_info *sysinfo, cpu_topology *topo, perf_counters *perf) {
     //general
-    int i, j;
+    int i, j, k, l;
     //core block
-    float core_voltage, core_frequency, package_sleep_time, core_sleep_time, average_voltage;
+    float core_voltage, core_frequency;
     float peak_core_frequency, peak_core_temp, peak_core_voltage;
     float total_core_voltage, total_core_power, total_usage, total_core_CC6;
     int core_disabled, core_number;
@@ -73,9 +124,11 @@ void draw_screen(pm_table *pmt, system_info *sysinfo) {
     float edc_value;
     //power block
     float l3_logic_power, l3_vddm_power;
-    char strbuf[100];
+    char strbuf[100], labelbuf[100];
+    perf_core_metrics perf_metrics;
+    core_stat freq_stat, temp_stat, voltage_stat, power_stat, c0_stat, cc6_stat;
 
-    if (pmt->experimental) {
+    if (frame->pmt->experimental) {
         fprintf(stdout, "Warning: Support for this PM table version is expermiental. Can't trust anything.\n");
     }
 
@@ -85,7 +138,7 @@ void draw_screen(pm_table *pmt, system_info *sysinfo) {
         print_line("Processor Code Name", sysinfo->codename);
         print_line("Cores", "%d", sysinfo->cores);
         print_line("Core CCDs", "%d", sysinfo->ccds);
-        if (pmt->zen_version!=3) {
+        if (frame->pmt->zen_version!=3) {
             print_line("Core CCXs", "%d", sysinfo->ccxs);
             print_line("Cores Per CCX", "%d", sysinfo->cores_per_ccx);
         }
@@ -97,74 +150,108 @@ void draw_screen(pm_table *pmt, system_info *sysinfo) {
     }
 
 
-    peak_core_frequency = peak_core_temp = peak_core_voltage = 0;
-    total_core_voltage = total_core_power = total_usage = total_core_CC6 = 0;
     core_number = 0;
 
-    if(pmt->PC6)
-    {
-        package_sleep_time = pmta(PC6) / 100.f;
-        average_voltage = (pmta(CPU_TELEMETRY_VOLTAGE) - (0.2 * package_sleep_time)) / (1.0 - package_sleep_time);
-    }
-    else
-    {
-        average_voltage = pmta(CPU_TELEMETRY_VOLTAGE);
-    }
+    //Statistics over the enabled cores
+    core_stats_array(frame->core_freqeff, &frame->mask, &freq_stat);
+    core_stats_array(frame->core_temp, &frame->mask, &temp_stat);
+    core_stats_array(frame->core_voltage_est, &frame->mask, &voltage_stat);
+    core_stats_array(frame->core_power, &frame->mask, &power_stat);
+    core_stats_array(frame->core_c0, &frame->mask, &c0_stat);
+    core_stats_array(frame->core_cc6, &frame->mask, &cc6_stat);
+
+    peak_core_frequency = freq_stat.max * 1000.f;
+    peak_core_temp = temp_stat.max;
+    peak_core_voltage = voltage_stat.max;
+    total_core_voltage = voltage_stat.sum;
+    total_core_power = power_stat.sum;
+    total_usage = c0_stat.sum;
+    total_core_CC6 = cc6_stat.sum;
 
     fprintf(stdout, "╭─────────┬────────────┬──────────┬─────────┬──────────┬─────────────┬─────────────┬─────────────╮\n");
-    for (i = 0; i < pmt->max_cores; i++) {
-        core_disabled = (sysinfo->core_disable_map >> i)&0x01;
-        core_frequency = pmta(CORE_FREQEFF[i]) * 1000.f;
+    for (i = 0; i < frame->num_cores; i++) {
+        core_disabled = core_disabled(sysinfo, i);
+        core_frequency = frame->core_freqeff[i] * 1000.f;
 
-        core_voltage = pmta(CORE_VOLTAGE[i]); // True core voltage
-        // Rumours say this is how AMD calculates core voltage
-        //if (pmta(CORE_FREQ[i]) != 0.f) {
-            core_sleep_time = pmta(CORE_CC6[i]) / 100.f;
-            core_voltage = ((1.0 - core_sleep_time) * average_voltage) + (0.2 * core_sleep_time);
-        //}
+        //True core voltage is in frame->core_voltage. Show the estimate Ryzen Master shows.
+        core_voltage = frame->core_voltage_est[i];
 
         if (core_disabled) {
             if (show_disabled_cores)
                     fprintf(stdout,
                         "│ %*s %d │   Disabled | %6.3f W | %5.3f V | %6.2f C | C0: %5.1f %% | C1: %5.1f %% | C6: %5.1f %% │\n",
                     (core_number<10)+4, "Core", core_number, //Print "Core" and its number but right-justified
-                        pmta(CORE_POWER[i]), core_voltage, pmta(CORE_TEMP[i]),
-                        pmta(CORE_C0[i]), pmta(CORE_CC1[i]), pmta(CORE_CC6[i]));
+                        frame->core_power[i], core_voltage, frame->core_temp[i],
+                        frame->core_c0[i], frame->core_cc1[i], frame->core_cc6[i]);
         }
-        else if (pmta(CORE_C0[i]) >= 6.f) {
+        else if (frame->core_c0[i] >= 6.f || baseline) {
             // AMD denotes a sleeping core as having spent less than 6% of the time in C0.
-            // Source: Ryzen Master
+            // Source: Ryzen Master. A difference in C0 says nothing about that.
                 fprintf(stdout,
                     "│ %*s %d │   %4.f MHz | %6.3f W | %5.3f V | %6.2f C | C0: %5.1f %% | C1: %5.1f %% | C6: %5.1f %% │\n",
                 (core_number<10)+4, "Core", core_number, //Print "Core" and its number but right-justified
-                core_frequency, pmta(CORE_POWER[i]), core_voltage, pmta(CORE_TEMP[i]),
-                    pmta(CORE_C0[i]), pmta(CORE_CC1[i]), pmta(CORE_CC6[i]));
+                core_frequency, frame->core_power[i], core_voltage, frame->core_temp[i],
+                    frame->core_c0[i], frame->core_cc1[i], frame->core_cc6[i]);
             }
             else {
                 fprintf(stdout,
                     "│ %*s %d │   Sleeping | %6.3f W | %5.3f V | %6.2f C | C0: %5.1f %% | C1: %5.1f %% | C6: %5.1f %% │\n",
                 (core_number<10)+4, "Core", core_number, //Print "Core" and its number but right-justified
-                    pmta(CORE_POWER[i]), core_voltage, pmta(CORE_TEMP[i]),
-                    pmta(CORE_C0[i]), pmta(CORE_CC1[i]), pmta(CORE_CC6[i]));
+                    frame->core_power[i], core_voltage, frame->core_temp[i],
+                    frame->core_c0[i], frame->core_cc1[i], frame->core_cc6[i]);
         }
 
         //Don't confuse people by numbering cores that are disabled and hence not shown on 6 | 12 core CPUs
         //(which actually have 8 | 16 cores)
         if (show_disabled_cores || !core_disabled) core_number++;
+    }
 
-        //Statistics
-        if (!core_disabled) {
-            if (peak_core_frequency < core_frequency) peak_core_frequency = core_frequency;
-            if (peak_core_temp < pmta(CORE_TEMP[i])) peak_core_temp = pmta(CORE_TEMP[i]);
-            if (peak_core_voltage < core_voltage) peak_core_voltage = core_voltage;
-            total_core_voltage += core_voltage;
-            total_core_power += pmta(CORE_POWER[i]);
-            total_usage += pmta(CORE_C0[i]);
-            total_core_CC6 += pmta(CORE_CC6[i]);
+    fprintf(stdout, "╰─────────┴────────────┴──────────┴─────────┴──────────┴─────────────┴─────────────┴─────────────╯\n");
+
+    if (topo && show_cpu_mapping) {
+        fprintf(stdout, "╭── Linux CPUs: OS Utilization per Thread ──────┬────────────────────────────────────────────────╮\n");
+        for (i = 0, core_number = 0; i < frame->num_cores; i++) {
+            core_disabled = core_disabled(sysinfo, i);
+            if (core_disabled && !show_disabled_cores) continue;
+
+            k = snprintf(labelbuf, sizeof(labelbuf), "Core %d (CPU", core_number++);
+            l = 0;
+            for (j = 0; j < topo->threads_per_core; j++) {
+                if (cpu_topology_core_cpu(topo, i, j) < 0) continue;
+                k += snprintf(labelbuf+k, sizeof(labelbuf)-k, "%s %d", (j?",":""), cpu_topology_core_cpu(topo, i, j));
+                l += snprintf(strbuf+l, sizeof(strbuf)-l, "%5.1f %% | ", topo->cpu_util[cpu_topology_core_cpu(topo, i, j)]);
+            }
+            snprintf(labelbuf+k, sizeof(labelbuf)-k, ")");
+            if (!l) snprintf(labelbuf, sizeof(labelbuf), "Core %d (not online)", core_number-1);
+            snprintf(strbuf+l, sizeof(strbuf)-l, "%6.3f W", frame->core_power[i]);
+            print_line(labelbuf, "%s", strbuf);
         }
+        fprintf(stdout, "╰───────────────────────────────────────────────┴────────────────────────────────────────────────╯\n");
     }
 
-    fprintf(stdout, "╰─────────┴────────────┴──────────┴─────────┴──────────┴─────────────┴─────────────┴─────────────╯\n");
+    if (topo && perf) {
+        fprintf(stdout, "╭── Perf Counters ──────────────────────────────┬────────────────────────────────────────────────╮\n");
+        print_line("", perf_counter_mode > 1 ? "IPC | Instr/Joule | Clock/Effective | Misses"
+                                             : "IPC | Instr/Joule | Cycle Clock/Effective Clock");
+        for (i = 0, core_number = 0; i < frame->num_cores; i++) {
+            core_disabled = core_disabled(sysinfo, i);
+            if (core_disabled && !show_disabled_cores) continue;
+
+            snprintf(labelbuf, sizeof(labelbuf), "Core %d", core_number++);
+            //Instructions per joule need the absolute power
+            if (!perf_counters_core_metrics(perf, topo, i, baseline ? NAN : frame->core_power[i], &perf_metrics))
+                print_line(labelbuf, "%s", "no counters");
+            else if (perf_counter_mode > 1)
+                print_line(labelbuf, "%4.2f IPC|%5.2f GI/J|%4.0f/%4.0f MHz|%4.1f MPKI",
+                    perf_metrics.ipc, perf_metrics.instr_per_joule / 1e9, perf_metrics.cycle_freq,
+                    frame->core_freqeff[i] * 1000.f, perf_metrics.mpki);
+            else
+                print_line(labelbuf, "%4.2f IPC | %6.2f GI/J | %5.0f / %5.0f MHz",
+                    perf_metrics.ipc, perf_metrics.instr_per_joule / 1e9, perf_metrics.cycle_freq,
+                    frame->core_freqeff[i] * 1000.f);
+        }
+        fprintf(stdout, "╰───────────────────────────────────────────────┴────────────────────────────────────────────────╯\n");
+    }
 
     fprintf(stdout, "╭── Core Statistics (Calculated) ───────────────┬────────────────────────────────────────────────╮\n");
     print_line("Highest Effective Core Frequency", "%8.0f MHz", peak_core_frequency);
@@ -175,104 +262,104 @@ void draw_screen(pm_table *pmt, system_info *sysinfo) {
     print_line("Total Core Power Sum", "%7.3f W", total_core_power);
 
     fprintf(stdout, "├── Reported by SMU ────────────────────────────┼────────────────────────────────────────────────┤\n");
-    //print_line("Package Power", "%8.3f W", pmta(SOCKET_POWER)); //Is listed below in power section
-    print_line("Peak Core Voltage", "%5.3f V", pmta(CPU_TELEMETRY_VOLTAGE));
-    if(pmt->PC6) print_line("Package CC6", "%6.2f %%", pmta(PC6));
+    //print_line("Package Power", "%8.3f W", pmf(SOCKET_POWER)); //Is listed below in power section
+    print_line("Peak Core Voltage", "%5.3f V", pmf(CPU_TELEMETRY_VOLTAGE));
+    if(pmf_valid(PC6)) print_line("Package CC6", "%6.2f %%", pmf(PC6));
     fprintf(stdout, "╰───────────────────────────────────────────────┴────────────────────────────────────────────────╯\n");
 
     fprintf(stdout, "╭── Electrical & Thermal Constraints ───────────┬────────────────────────────────────────────────╮\n");
-    edc_value = pmta(EDC_VALUE) * (total_usage / sysinfo->cores / 100);
-    if (edc_value < pmta(TDC_VALUE)) edc_value = pmta(TDC_VALUE);
-
-    print_line("Peak Temperature", "%8.2f C", pmta(PEAK_TEMP));
-    if(pmt->SOC_TEMP) print_line("SoC Temperature", "%8.2f C", pmta(SOC_TEMP));
-    if(pmt->GFX_TEMP) print_line("GFX Temperature", "%8.2f C", pmta(GFX_TEMP));
-    //print_line("Core Power", "%8.4f W", pmta(VDDCR_CPU_POWER));
-
-    print_line("Voltage from Core VRM", "%7.3f V | %7.3f V | %8.2f %%", pmta(VID_VALUE), pmta(VID_LIMIT), (pmta(VID_VALUE) / pmta(VID_LIMIT) * 100));
-    //if(pmt->STAPM_VALUE) print_line("STAPM", "%7.3f   | %7.f   | %8.2f %%", pmta(STAPM_VALUE), pmta(STAPM_LIMIT), (pmta(STAPM_VALUE) / pmta(STAPM_LIMIT) * 100));
-    print_line("PPT", "%7.3f W | %7.f W | %8.2f %%", pmta(PPT_VALUE), pmta(PPT_LIMIT), (pmta(PPT_VALUE) / pmta(PPT_LIMIT) * 100));
-    if(pmt->PPT_VALUE_APU) print_line("PPT APU", "%7.3f W | %7.f W | %8.2f %%", pmta(PPT_VALUE_APU), pmta(PPT_LIMIT_APU), (pmta(PPT_VALUE_APU) / pmta(PPT_LIMIT_APU) * 100));
-    print_line("TDC Value", "%7.3f A | %7.f A | %8.2f %%", pmta(TDC_VALUE), pmta(TDC_LIMIT), (pmta(TDC_VALUE) / pmta(TDC_LIMIT) * 100));
-    if(pmt->TDC_ACTUAL) print_line("TDC Actual", "%7.3f A | %7.f A | %8.2f %%", pmta(TDC_ACTUAL), pmta(TDC_LIMIT), (pmta(TDC_ACTUAL) / pmta(TDC_LIMIT) * 100));
-    if(pmt->TDC_VALUE_SOC) print_line("TDC Value, SoC only", "%7.3f A | %7.f A | %8.2f %%", pmta(TDC_VALUE_SOC), pmta(TDC_LIMIT_SOC), (pmta(TDC_VALUE_SOC) / pmta(TDC_LIMIT_SOC) * 100));
-    print_line("EDC", "%7.3f A | %7.f A | %8.2f %%", edc_value, pmta(EDC_LIMIT), (edc_value / pmta(EDC_LIMIT) * 100));
-    if(pmt->EDC_VALUE_SOC) print_line("EDC, SoC only", "%7.3f A | %7.f A | %8.2f %%", pmta(EDC_VALUE_SOC), pmta(EDC_LIMIT_SOC), (pmta(EDC_VALUE_SOC) / pmta(EDC_LIMIT_SOC) * 100));
-    print_line("THM", "%7.2f C | %7.f C | %8.2f %%", pmta(THM_VALUE), pmta(THM_LIMIT), (pmta(THM_VALUE) / pmta(THM_LIMIT) * 100));
-    if(pmt->THM_VALUE_SOC) print_line("THM SoC", "%7.2f C | %7.f C | %8.2f %%", pmta(THM_VALUE_SOC), pmta(THM_LIMIT_SOC), (pmta(THM_VALUE_SOC) / pmta(THM_LIMIT_SOC) * 100));
-    if(pmt->THM_VALUE_GFX) print_line("THM GFX", "%7.2f C | %7.f C | %8.2f %%", pmta(THM_VALUE_GFX), pmta(THM_LIMIT_GFX), (pmta(THM_VALUE_GFX) / pmta(THM_LIMIT_GFX) * 100));
-    //if(pmt->STT_LIMIT_APU) print_line("STT APU", "%7.2f   | %7.f   | %8.2f %%", pmta(STT_VALUE_APU), pmta(STT_LIMIT_APU), (pmta(STT_VALUE_APU) / pmta(STT_LIMIT_APU) * 100)); //Always zero
-    //if(pmt->STT_LIMIT_DGPU) print_line("STT DGPU", "%7.2f   | %7.f   | %8.2f %%", pmta(STT_VALUE_DGPU), pmta(STT_LIMIT_DGPU), (pmta(STT_VALUE_DGPU) / pmta(STT_LIMIT_DGPU) * 100)); //Always zero
-    print_line("FIT", "%7.f   | %7.f   | %8.2f %%", pmta(FIT_VALUE), pmta(FIT_LIMIT), (pmta(FIT_VALUE) / pmta(FIT_LIMIT)) * 100.f);
+    edc_value = pmf(EDC_VALUE) * (total_usage / sysinfo->cores / 100);
+    if (edc_value < pmf(TDC_VALUE)) edc_value = pmf(TDC_VALUE);
+
+    print_line("Peak Temperature", "%8.2f C", pmf(PEAK_TEMP));
+    if(pmf_valid(SOC_TEMP)) print_line("SoC Temperature", "%8.2f C", pmf(SOC_TEMP));
+    if(pmf_valid(GFX_TEMP)) print_line("GFX Temperature", "%8.2f C", pmf(GFX_TEMP));
+    //print_line("Core Power", "%8.4f W", pmf(VDDCR_CPU_POWER));
+
+    print_limit_line("Voltage from Core VRM", "%7.3f V | %7.3f V", pmf(VID_VALUE), pmf(VID_LIMIT));
+    //if(pmf_valid(STAPM_VALUE)) print_limit_line("STAPM", "%7.3f   | %7.f  ", pmf(STAPM_VALUE), pmf(STAPM_LIMIT));
+    print_limit_line("PPT", "%7.3f W | %7.f W", pmf(PPT_VALUE), pmf(PPT_LIMIT));
+    if(pmf_valid(PPT_VALUE_APU)) print_limit_line("PPT APU", "%7.3f W | %7.f W", pmf(PPT_VALUE_APU), pmf(PPT_LIMIT_APU));
+    print_limit_line("TDC Value", "%7.3f A | %7.f A", pmf(TDC_VALUE), pmf(TDC_LIMIT));
+    if(pmf_valid(TDC_ACTUAL)) print_limit_line("TDC Actual", "%7.3f A | %7.f A", pmf(TDC_ACTUAL), pmf(TDC_LIMIT));
+    if(pmf_valid(TDC_VALUE_SOC)) print_limit_line("TDC Value, SoC only", "%7.3f A | %7.f A", pmf(TDC_VALUE_SOC), pmf(TDC_LIMIT_SOC));
+    print_limit_line("EDC", "%7.3f A | %7.f A", edc_value, pmf(EDC_LIMIT));
+    if(pmf_valid(EDC_VALUE_SOC)) print_limit_line("EDC, SoC only", "%7.3f A | %7.f A", pmf(EDC_VALUE_SOC), pmf(EDC_LIMIT_SOC));
+    print_limit_line("THM", "%7.2f C | %7.f C", pmf(THM_VALUE), pmf(THM_LIMIT));
+    if(pmf_valid(THM_VALUE_SOC)) print_limit_line("THM SoC", "%7.2f C | %7.f C", pmf(THM_VALUE_SOC), pmf(THM_LIMIT_SOC));
+    if(pmf_valid(THM_VALUE_GFX)) print_limit_line("THM GFX", "%7.2f C | %7.f C", pmf(THM_VALUE_GFX), pmf(THM_LIMIT_GFX));
+    //if(pmf_valid(STT_LIMIT_APU)) print_limit_line("STT APU", "%7.2f   | %7.f  ", pmf(STT_VALUE_APU), pmf(STT_LIMIT_APU)); //Always zero
+    //if(pmf_valid(STT_LIMIT_DGPU)) print_limit_line("STT DGPU", "%7.2f   | %7.f  ", pmf(STT_VALUE_DGPU), pmf(STT_LIMIT_DGPU)); //Always zero
+    print_limit_line("FIT", "%7.f   | %7.f  ", pmf(FIT_VALUE), pmf(FIT_LIMIT));
     fprintf(stdout, "╰───────────────────────────────────────────────┴────────────────────────────────────────────────╯\n");
 
     fprintf(stdout, "╭── Memory Interface ───────────────────────────┬────────────────────────────────────────────────╮\n");
-    print_line("Coupled Mode", "%8s", pmta(UCLK_FREQ) == pmta(MEMCLK_FREQ) ? "ON" : "OFF");
-    print_line("Fabric Clock (Average)", "%5.f MHz", pmta(FCLK_FREQ_EFF));
-    print_line("Fabric Clock", "%5.f MHz", pmta(FCLK_FREQ));
-    print_line("Uncore Clock", "%5.f MHz", pmta(UCLK_FREQ));
-    print_line("Memory Clock", "%5.f MHz", pmta(MEMCLK_FREQ));
-    //print_line("VDDCR_Mem", "%7.3f W", pmta(VDDIO_MEM_POWER)); //Is listed below in power section
-    //print_line("VDDCR_SoC", "%7.3f V", pmta(SOC_SET_VOLTAGE)); //Might be the default voltage, not the actually set one
-    print_line("cLDO_VDDM", "%7.4f V", pmta(V_VDDM));
-    print_line("cLDO_VDDP", "%7.4f V", pmta(V_VDDP));
-    if(pmt->V_VDDG)     print_line("cLDO_VDDG", "%7.4f V", pmta(V_VDDG));
-    if(pmt->V_VDDG_IOD) print_line("cLDO_VDDG_IOD", "%7.4f V", pmta(V_VDDG_IOD));
-    if(pmt->V_VDDG_CCD) print_line("cLDO_VDDG_CCD", "%7.4f V", pmta(V_VDDG_CCD));
+    if (!baseline) print_line("Coupled Mode", "%8s", pmf(UCLK_FREQ) == pmf(MEMCLK_FREQ) ? "ON" : "OFF");
+    print_line("Fabric Clock (Average)", "%5.f MHz", pmf(FCLK_FREQ_EFF));
+    print_line("Fabric Clock", "%5.f MHz", pmf(FCLK_FREQ));
+    print_line("Uncore Clock", "%5.f MHz", pmf(UCLK_FREQ));
+    print_line("Memory Clock", "%5.f MHz", pmf(MEMCLK_FREQ));
+    //print_line("VDDCR_Mem", "%7.3f W", pmf(VDDIO_MEM_POWER)); //Is listed below in power section
+    //print_line("VDDCR_SoC", "%7.3f V", pmf(SOC_SET_VOLTAGE)); //Might be the default voltage, not the actually set one
+    print_line("cLDO_VDDM", "%7.4f V", pmf(V_VDDM));
+    print_line("cLDO_VDDP", "%7.4f V", pmf(V_VDDP));
+    if(pmf_valid(V_VDDG))     print_line("cLDO_VDDG", "%7.4f V", pmf(V_VDDG));
+    if(pmf_valid(V_VDDG_IOD)) print_line("cLDO_VDDG_IOD", "%7.4f V", pmf(V_VDDG_IOD));
+    if(pmf_valid(V_VDDG_CCD)) print_line("cLDO_VDDG_CCD", "%7.4f V", pmf(V_VDDG_CCD));
     fprintf(stdout, "╰───────────────────────────────────────────────┴────────────────────────────────────────────────╯\n");
 
-    if(pmt->has_graphics){
+    if(frame->pmt->has_graphics){
     fprintf(stdout, "╭── Graphics Subsystem──────────────────────────┬────────────────────────────────────────────────╮\n");
-    print_line("GFX Voltage | ROC Power", "%7.4f V | %8.3f W", pmta(GFX_VOLTAGE), pmta(ROC_POWER));
-    print_line("GFX Temperature", "%8.2f C", pmta(GFX_TEMP));
-    print_line("GFX Clock Real | Effective", "%5.f MHz | %6.f MHz", pmta(GFX_FREQ), pmta(GFX_FREQEFF));
-    print_line("GFX Busy", "%8.2f %%", pmta(GFX_BUSY) * 100.f);
-    print_line("GFX EDC Limit | Residency", "%7.3f A | %8.2f %%", pmta(GFX_EDC_LIM), pmta(GFX_EDC_RESIDENCY) * 100.f);
-    print_line("Display Count | FPS", "%2.f | %8.2f  ", pmta(DISPLAY_COUNT), pmta(FPS));
-    print_line("DGPU Power | Freq Target | Busy", "%7.3f W | %5.f MHz | %8.2f %%", pmta(DGPU_POWER), pmta(DGPU_FREQ_TARGET), pmta(DGPU_GFX_BUSY) * 100.f);
+    print_line("GFX Voltage | ROC Power", "%7.4f V | %8.3f W", pmf(GFX_VOLTAGE), pmf(ROC_POWER));
+    print_line("GFX Temperature", "%8.2f C", pmf(GFX_TEMP));
+    print_line("GFX Clock Real | Effective", "%5.f MHz | %6.f MHz", pmf(GFX_FREQ), pmf(GFX_FREQEFF));
+    print_line("GFX Busy", "%8.2f %%", pmf(GFX_BUSY) * 100.f);
+    print_line("GFX EDC Limit | Residency", "%7.3f A | %8.2f %%", pmf(GFX_EDC_LIM), pmf(GFX_EDC_RESIDENCY) * 100.f);
+    print_line("Display Count | FPS", "%2.f | %8.2f  ", pmf(DISPLAY_COUNT), pmf(FPS));
+    print_line("DGPU Power | Freq Target | Busy", "%7.3f W | %5.f MHz | %8.2f %%", pmf(DGPU_POWER), pmf(DGPU_FREQ_TARGET), pmf(DGPU_GFX_BUSY) * 100.f);
     fprintf(stdout, "╰───────────────────────────────────────────────┴────────────────────────────────────────────────╯\n");
     }
 
     fprintf(stdout, "╭── Power Consumption ──────────────────────────┬────────────────────────────────────────────────╮\n");
     //These powers are drawn via VDDCR_SOC and VDDCR_CPU and thus are pulled from the CPU power connector of the mainboard
     print_line("Total Core Power Sum", "%7.3f W", total_core_power);
-    //print_line("VDDCR_CPU Power", "%7.3f W", pmta(VDDCR_CPU_POWER)); //This value doesn't correlate with what the cores
+    //print_line("VDDCR_CPU Power", "%7.3f W", pmf(VDDCR_CPU_POWER)); //This value doesn't correlate with what the cores
                                                                         //report, nor with what is actually consumed. but is
                                                                         //the value HWiNFO shows.
-    print_line("VDDCR_SOC Power", "%7.3f W", pmta(VDDCR_SOC_POWER));
-    if(pmt->IO_VDDCR_SOC_POWER) print_line("IO VDDCR_SOC Power", "%7.3f W", pmta(IO_VDDCR_SOC_POWER));
-    if(pmt->GMI2_VDDG_POWER) print_line("GMI2_VDDG Power", "%7.3f W", pmta(GMI2_VDDG_POWER));
-    if(pmt->ROC_POWER) print_line("ROC Power", "%7.3f W", pmta(ROC_POWER));
+    print_line("VDDCR_SOC Power", "%7.3f W", pmf(VDDCR_SOC_POWER));
+    if(pmf_valid(IO_VDDCR_SOC_POWER)) print_line("IO VDDCR_SOC Power", "%7.3f W", pmf(IO_VDDCR_SOC_POWER));
+    if(pmf_valid(GMI2_VDDG_POWER)) print_line("GMI2_VDDG Power", "%7.3f W", pmf(GMI2_VDDG_POWER));
+    if(pmf_valid(ROC_POWER)) print_line("ROC Power", "%7.3f W", pmf(ROC_POWER));
 
     //L3 caches (2 per CCD on Zen2, 1 per CCD on Zen3)
     l3_logic_power=0;
     l3_vddm_power=0;
-    for (i=0; i<pmt->max_l3; i++) {
-        l3_logic_power += pmta0(L3_LOGIC_POWER[i]);
-        l3_vddm_power += pmta0(L3_VDDM_POWER[i]);
+    for (i=0; i<frame->num_l3; i++) {
+        l3_logic_power += frame->l3_logic_power[i];
+        l3_vddm_power += frame->l3_vddm_power[i];
     }
-    if (pmt->max_l3 == 1) {
-        print_line("L3 Logic Power", "%7.3f W", pmta(L3_LOGIC_POWER[0]));
-        print_line("L3 VDDM Power", "%7.3f W", pmta(L3_VDDM_POWER[0]));
+    if (frame->num_l3 == 1) {
+        print_line("L3 Logic Power", "%7.3f W", frame->l3_logic_power[0]);
+        print_line("L3 VDDM Power", "%7.3f W", frame->l3_vddm_power[0]);
     } else {
-        for (i=0; i<pmt->max_l3; i+=2) {
+        for (i=0; i<frame->num_l3; i+=2) {
             // + sign if needed and first value
-            j = snprintf(strbuf, sizeof(strbuf), "%s%7.3f W", (i?"+ ":""), pmta(L3_LOGIC_POWER[i]));
+            j = snprintf(strbuf, sizeof(strbuf), "%s%7.3f W", (i?"+ ":""), frame->l3_logic_power[i]);
             // second value if it exists
-            if (pmt->max_l3-i > 1) j += snprintf(strbuf+j, sizeof(strbuf)-j, " + %7.3f W", pmta(L3_LOGIC_POWER[i+1]));
+            if (frame->num_l3-i > 1) j += snprintf(strbuf+j, sizeof(strbuf)-j, " + %7.3f W", frame->l3_logic_power[i+1]);
             // end of string (sum or nothing)
-            if (pmt->max_l3-i > 2) j += snprintf(strbuf+j, sizeof(strbuf)-j, "            ");
+            if (frame->num_l3-i > 2) j += snprintf(strbuf+j, sizeof(strbuf)-j, "            ");
             else j += snprintf(strbuf+j, sizeof(strbuf)-j, " = %7.3f W", l3_logic_power);
             // print
             print_line((i?"":"L3 Logic Power"), "%s", strbuf);
         }
-        for (i=0; i<pmt->max_l3; i+=2) {
+        for (i=0; i<frame->num_l3; i+=2) {
             // + sign if needed and first value
-            j = snprintf(strbuf, sizeof(strbuf), "%s%7.3f W", (i?"+ ":""), pmta(L3_VDDM_POWER[i]));
+            j = snprintf(strbuf, sizeof(strbuf), "%s%7.3f W", (i?"+ ":""), frame->l3_vddm_power[i]);
             // second value if it exists
-            if (pmt->max_l3-i > 1) j += snprintf(strbuf+j, sizeof(strbuf)-j, " + %7.3f W", pmta(L3_VDDM_POWER[i+1]));
+            if (frame->num_l3-i > 1) j += snprintf(strbuf+j, sizeof(strbuf)-j, " + %7.3f W", frame->l3_vddm_power[i+1]);
             // end of string (sum or nothing)
-            if (pmt->max_l3-i > 2) j += snprintf(strbuf+j, sizeof(strbuf)-j, "            ");
+            if (frame->num_l3-i > 2) j += snprintf(strbuf+j, sizeof(strbuf)-j, "            ");
             else j += snprintf(strbuf+j, sizeof(strbuf)-j, " = %7.3f W", l3_vddm_power);
             // print
             print_line((i?"":"L3 VDDM Power"), "%s", strbuf);
@@ -281,61 +368,65 @@ void draw_screen(pm_table *pmt, system_info *sysinfo) {
 
     //These powers are supplied by other power lines to the CPU and are drawn from the 24 pin ATX connector on most boards
     print_line("","");
-    print_line("VDDIO_MEM Power", "%7.3f W", pmta(VDDIO_MEM_POWER));
-    print_line("IOD_VDDIO_MEM Power", "%7.3f W", pmta(IOD_VDDIO_MEM_POWER));
-    if(pmt->DDR_VDDP_POWER) print_line("DDR_VDDP Power", "%7.3f W", pmta(DDR_VDDP_POWER));
-    if(pmt->DDR_PHY_POWER) print_line("DDR Phy Power", "%7.3f W", pmta(DDR_PHY_POWER));
-    print_line("VDD18 Power", "%7.3f W", pmta(VDD18_POWER)); //Same as pmta(IO_VDD18_POWER)
-    if(pmt->IO_DISPLAY_POWER) print_line("CPU Display IO Power", "%7.3f W", pmta(IO_DISPLAY_POWER));
-    if(pmt->IO_USB_POWER) print_line("CPU USB IO Power", "%7.3f W", pmta(IO_USB_POWER));
-
-    if(!pmt->powersum_unclear) {
+    print_line("VDDIO_MEM Power", "%7.3f W", pmf(VDDIO_MEM_POWER));
+    print_line("IOD_VDDIO_MEM Power", "%7.3f W", pmf(IOD_VDDIO_MEM_POWER));
+    if(pmf_valid(DDR_VDDP_POWER)) print_line("DDR_VDDP Power", "%7.3f W", pmf(DDR_VDDP_POWER));
+    if(pmf_valid(DDR_PHY_POWER)) print_line("DDR Phy Power", "%7.3f W", pmf(DDR_PHY_POWER));
+    print_line("VDD18 Power", "%7.3f W", pmf(VDD18_POWER)); //Same as pmf(IO_VDD18_POWER)
+    if(pmf_valid(IO_DISPLAY_POWER)) print_line("CPU Display IO Power", "%7.3f W", pmf(IO_DISPLAY_POWER));
+    if(pmf_valid(IO_USB_POWER)) print_line("CPU USB IO Power", "%7.3f W", pmf(IO_USB_POWER));
+
+    if(!frame->pmt->powersum_unclear) {
     //The sum is the thermal output of the whole package. Yes, this is higher than PPT and SOCKET_POWER.
     //Confirmed by measuring the actual current draw on the mainboard.
     print_line("","");
-    print_line("Calculated Thermal Output", "%7.3f W", total_core_power + pmta0(VDDCR_SOC_POWER) + pmta0(GMI2_VDDG_POWER) 
+    print_line("Calculated Thermal Output", "%7.3f W", total_core_power + pmf0(VDDCR_SOC_POWER) + pmf0(GMI2_VDDG_POWER) 
             + l3_logic_power + l3_vddm_power
-            + pmta0(VDDIO_MEM_POWER) + pmta0(IOD_VDDIO_MEM_POWER) + pmta0(DDR_VDDP_POWER) + pmta0(VDD18_POWER));
+            + pmf0(VDDIO_MEM_POWER) + pmf0(IOD_VDDIO_MEM_POWER) + pmf0(DDR_VDDP_POWER) + pmf0(VDD18_POWER));
     }
 
     fprintf(stdout, "├── Additional Reports ─────────────────────────┼────────────────────────────────────────────────┤\n");
-    //print_line("ROC_POWER", "%7.4f",pmta(ROC_POWER));
-    print_line("SoC Power (SVI2)", "%8.3f V | %7.3f A | %8.3f W", pmta(SOC_TELEMETRY_VOLTAGE), pmta(SOC_TELEMETRY_CURRENT), pmta(SOC_TELEMETRY_POWER));
-    print_line("Core Power (SVI2)", "%8.3f V | %7.3f A | %8.3f W", pmta(CPU_TELEMETRY_VOLTAGE), pmta(CPU_TELEMETRY_CURRENT), pmta(CPU_TELEMETRY_POWER));
-    print_line("Core Power (SMU)", "%7.3f W", pmta(VDDCR_CPU_POWER));
-    print_line("Socket Power (SMU)", "%7.3f W", pmta(SOCKET_POWER));
-    if (pmt->PACKAGE_POWER) print_line("Package Power (SMU)", "%7.3f W", pmta(PACKAGE_POWER));
+    //print_line("ROC_POWER", "%7.4f",pmf(ROC_POWER));
+    print_line("SoC Power (SVI2)", "%8.3f V | %7.3f A | %8.3f W", pmf(SOC_TELEMETRY_VOLTAGE), pmf(SOC_TELEMETRY_CURRENT), pmf(SOC_TELEMETRY_POWER));
+    print_line("Core Power (SVI2)", "%8.3f V | %7.3f A | %8.3f W", pmf(CPU_TELEMETRY_VOLTAGE), pmf(CPU_TELEMETRY_CURRENT), pmf(CPU_TELEMETRY_POWER));
+    print_line("Core Power (SMU)", "%7.3f W", pmf(VDDCR_CPU_POWER));
+    print_line("Socket Power (SMU)", "%7.3f W", pmf(SOCKET_POWER));
+    if (pmf_valid(PACKAGE_POWER)) print_line("Package Power (SMU)", "%7.3f W", pmf(PACKAGE_POWER));
     fprintf(stdout, "╰───────────────────────────────────────────────┴────────────────────────────────────────────────╯\n");
 }
 
-int select_pm_table_version(unsigned int version, pm_table *pmt, unsigned char *pm_buf) {
-    //Initialize pmt to 0. This also sets all pointers to 0, which signifies non-existiting fields.
-    //Access via pmta(...) will check if pointer is 0 before trying to access the value.
-    memset(pmt, 0, sizeof(pm_table));
-
-     //Select matching PM Table
-    switch(version) {
-        case 0x380904: pm_table_0x380904(pmt, pm_buf); break; //Ryzen 5600X
-        case 0x380905: pm_table_0x380905(pmt, pm_buf); break; //Ryzen 5600X
-        case 0x380804: pm_table_0x380804(pmt, pm_buf); break; //Ryzen 5900X / 5950X
-        case 0x380805: pm_table_0x380805(pmt, pm_buf); break; //Ryzen 5900X / 5950X
-        case 0x400005: pm_table_0x400005(pmt, pm_buf); break; //Ryzen 5700G
-        case 0x240903: pm_table_0x240903(pmt, pm_buf); break; //Ryzen 3700X / 3800X
-        case 0x240803: pm_table_0x240803(pmt, pm_buf); break; //Ryzen 3950X
-        default:
-            return 0;
+void draw_energy_attribution(energy_attribution *ea) {
+    int i, n, *idx;
+    char labelbuf[100];
+
+    idx = malloc(attribution_top * sizeof(int));
+    if (!idx) return;
+
+    fprintf(stdout, "╭── Energy Attribution (Estimated) ─────────────┬────────────────────────────────────────────────╮\n");
+    print_line("Processes", "%s", "Energy (Core + Uncore) | Power");
+    n = energy_attribution_top_processes(ea, idx, attribution_top);
+    for (i = 0; i < n; i++) {
+        snprintf(labelbuf, sizeof(labelbuf), "%d %s%s", ea->processes[idx[i]].pid, ea->processes[idx[i]].comm,
+            ea->processes[idx[i]].alive ? "" : " (exited)");
+        print_line(labelbuf, "%9.2f J + %8.2f J | %7.3f W",
+            ea->processes[idx[i]].core_energy, ea->processes[idx[i]].uncore_energy, ea->processes[idx[i]].power);
     }
+    print_line("", "");
+    print_line("Cgroups", "%s", "");
+    n = energy_attribution_top_cgroups(ea, idx, attribution_top);
+    for (i = 0; i < n; i++) {
+        //Keep the end of long cgroup paths, it's the most specific part
+        snprintf(labelbuf, sizeof(labelbuf), "%s", ea->cgroups[idx[i]].path
+            + (strlen(ea->cgroups[idx[i]].path) > 45 ? strlen(ea->cgroups[idx[i]].path) - 45 : 0));
+        print_line(labelbuf, "%9.2f J + %8.2f J | %7.3f W",
+            ea->cgroups[idx[i]].core_energy, ea->cgroups[idx[i]].uncore_energy, ea->cgroups[idx[i]].power);
+    }
+    print_line("", "");
+    print_line("Unattributed | Total", "%9.2f J | %9.2f J", ea->unattributed_energy, ea->total_energy);
+    print_line("Processes Read | Changed", "%6u | %6u", ea->scanned, ea->changed);
+    fprintf(stdout, "╰───────────────────────────────────────────────┴────────────────────────────────────────────────╯\n");
 
-    //Avoid access bejond bounds of the defined arrays.
-    if (pmt->max_l3 > PMT_MAX_NUM_L3) pmt->max_l3 = PMT_MAX_NUM_L3;
-    if (pmt->max_cores > PMT_MAX_NUM_CORES) pmt->max_cores = PMT_MAX_NUM_CORES;
-
-    //APML_POWER is probably identical to PACKAGE_POWER
-    if (pmt->PACKAGE_POWER == NULL) pmt->PACKAGE_POWER = pmt->APML_POWER;
-
-    if (pmt->VDD18_POWER == NULL) pmt->VDD18_POWER = pmt->IO_VDD18_POWER;
-
-    return 1;
+    free(idx);
 }
 
 void disabled_cores_0x400005(pm_table *pmt, system_info *sysinfo) {
@@ -361,10 +452,10 @@ void disabled_cores_0x400005(pm_table *pmt, system_info *sysinfo) {
     }
 }
 
-void start_pm_monitor(unsigned int force) {
+unsigned char* setup_pm_monitor(unsigned int force, pm_table *pmt, system_info *sysinfo) {
     unsigned char *pm_buf;
-    pm_table pmt;
-    system_info sysinfo;
+
+    memset(sysinfo, 0, sizeof(system_info));
 
     if (!smu_pm_tables_supported(&obj)) {
         fprintf(stderr, "PM Tables are not supported on this platform.\n");
@@ -382,59 +473,284 @@ void start_pm_monitor(unsigned int force) {
     }
 
     //Select matching PM Table
-    if(!select_pm_table_version(force?force:obj.pm_table_version, &pmt, pm_buf)) {
+    if(!select_pm_table_version(force?force:obj.pm_table_version, pmt, pm_buf)) {
         fprintf(stderr, "This PM Table version (0x%x) is currently not supported.\n", force?force:obj.pm_table_version);
-        fprintf(stderr, "Processor name: %s\n", get_processor_name());
+        fprintf(stderr, "A layout for it can be loaded with -l. -L proposes one.\n");
+        fprintf(stderr, "Processor name: %s\n", get_processor_name(sysinfo->cpu_name, sizeof(sysinfo->cpu_name)));
         fprintf(stderr, "SMU FW version: %s\n", smu_get_fw_version(&obj));
         exit(0);
     }
     //Prevent illegal memory access
-    if (obj.pm_table_size < pmt.min_size) {
+    if (obj.pm_table_size < pmt->min_size) {
         fprintf(stderr, "Selected PM Table is larger than the PM Table returned by the SMU.\n");
         exit(0);
     }
     //Maximum core count. Just to be safe. Will be overwritten by get_processor_topology(...).
-    sysinfo.enabled_cores_count = pmt.max_cores;
+    sysinfo->enabled_cores_count = pmt->max_cores;
+
+    sysinfo->codename    = smu_codename_to_str(&obj);
+    sysinfo->smu_fw_ver  = smu_get_fw_version(&obj);
 
-    sysinfo.cpu_name    = get_processor_name();
-    sysinfo.codename    = smu_codename_to_str(&obj);
-    sysinfo.smu_fw_ver  = smu_get_fw_version(&obj);
+    if (!use_platform_cache || !platform_cache_get_topology(&pcache, sysinfo, pmt->version, pmt->zen_version)) {
+        get_processor_name(sysinfo->cpu_name, sizeof(sysinfo->cpu_name));
 
-    //PMT hack for Cezanne's core_disabled_map 
-    if (obj.pm_table_version == 0x400005) {
-        if (smu_read_pm_table(&obj, pm_buf, obj.pm_table_size) == SMU_Return_OK) {
-            disabled_cores_0x400005(&pmt, &sysinfo);
+        //PMT hack for Cezanne's core_disabled_map 
+        if (obj.pm_table_version == 0x400005) {
+            if (smu_read_pm_table(&obj, pm_buf, obj.pm_table_size) == SMU_Return_OK) {
+                disabled_cores_0x400005(pmt, sysinfo);
+            }
+        }
+
+        get_processor_topology(&obj, sysinfo, pmt->zen_version);
+
+        if (use_platform_cache) {
+            platform_cache_set_topology(&pcache, sysinfo, pmt->version, pmt->zen_version);
+            platform_cache_save(&pcache);
         }
     }
-    
-    get_processor_topology(&sysinfo, pmt.zen_version);
 
     switch (obj.smu_if_version) {
-        case IF_VERSION_9:  sysinfo.if_ver =  9; break;
-        case IF_VERSION_10: sysinfo.if_ver = 10; break;
-        case IF_VERSION_11: sysinfo.if_ver = 11; break;
-        case IF_VERSION_12: sysinfo.if_ver = 12; break;
-        case IF_VERSION_13: sysinfo.if_ver = 13; break;
-        default:            sysinfo.if_ver =  0; break;
+        case IF_VERSION_9:  sysinfo->if_ver =  9; break;
+        case IF_VERSION_10: sysinfo->if_ver = 10; break;
+        case IF_VERSION_11: sysinfo->if_ver = 11; break;
+        case IF_VERSION_12: sysinfo->if_ver = 12; break;
+        case IF_VERSION_13: sysinfo->if_ver = 13; break;
+        default:            sysinfo->if_ver =  0; break;
+    }
+
+    return pm_buf;
+}
+
+void compile_selection(pm_selection *sel, pm_table *pmt, unsigned char *pm_buf) {
+    int n;
+
+    n = pm_selection_compile(sel, pmt, field_patterns);
+    if (n < 0) {
+        fprintf(stderr, "Could not allocate memory for the field selection.\n");
+        exit(0);
+    }
+    if (!n) {
+        fprintf(stderr, "No field of PM Table version 0x%x matches \"%s\".\n", pmt->version, field_patterns);
+        exit(0);
+    }
+    if (baseline && !pm_selection_set_baseline(sel, pm_buf, baseline)) {
+        fprintf(stderr, "Could not allocate memory for the field selection.\n");
+        exit(0);
+    }
+}
+
+void export_selection(pm_selection *sel, pm_table *pmt) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    pm_selection_decode(sel);
+    self_overhead_stage(&overhead, OVH_DECODE);
+    export_sample(stdout, export_mode, sel, pmt, ts.tv_sec + ts.tv_nsec * 1e-9, show_overhead ? &overhead : NULL);
+    self_overhead_stage(&overhead, OVH_RENDER);
+    fflush(stdout);
+    self_overhead_stage(&overhead, OVH_WRITE);
+}
+
+void print_overhead_summary() {
+    fflush(stdout);
+    self_overhead_summary(&overhead, stderr);
+}
+
+void start_overhead() {
+    self_overhead_init(&overhead);
+    if (!show_overhead) return;
+    if (!self_overhead_wrap_stdout(&overhead))
+        fprintf(stderr, "Could not count the bytes written to stdout.\n");
+}
+
+void print_low_perturbation_summary() {
+    fflush(stdout);
+    low_perturbation_summary(&lowpert, stderr);
+}
+
+void start_low_perturbation(pm_table *pmt, system_info *sysinfo, unsigned char *pm_buf) {
+    cpu_topology topo;
+    pm_frame frame;
+    int have_topo, core = -1;
+
+    have_topo = cpu_topology_init(&topo, sysinfo, pmt->max_cores);
+    //Without a given CPU the monitor goes to the core that is the least idle anyway
+    if (low_perturbation_cpu < 0 && pm_frame_init(&frame, pmt, sysinfo, pm_buf)) {
+        if (smu_read_pm_table_range(&obj, pm_buf, 0, pmt->min_size) == SMU_Return_OK) {
+            pm_frame_extract(&frame);
+            core = low_perturbation_pick_core(&frame, sysinfo);
+        }
+        pm_frame_free(&frame);
+    }
+    if (!low_perturbation_init(&lowpert, low_perturbation_cpu, core, have_topo ? &topo : NULL, update_time_s))
+        perror("Could not pin the monitor to a CPU");
+    if (have_topo) cpu_topology_free(&topo);
+}
+
+//Ends a sample loop that was left after a signal or a single sample
+void stop_monitor() {
+    // Re-enable the cursor.
+    if (!export_mode && !run_once) fprintf(stdout, "\e[?25h");
+    fflush(stdout);
+    recording_close(&recorder);
+    //After the last complete frame, never from the signal handler
+    if (low_perturbation_mode) print_low_perturbation_summary();
+    if (show_overhead) print_overhead_summary();
+    exit(0);
+}
+
+//Writes the selected fields to stdout instead of drawing the screen. Only the selection is decoded.
+void start_export(pm_table *pmt, unsigned char *pm_buf) {
+    unsigned int offset, length;
+    pm_selection sel;
+
+    compile_selection(&sel, pmt, pm_buf);
+    //Only the selected fields are read, unless the whole table is recorded
+    if (recording_path) {
+        offset = 0;
+        length = obj.pm_table_size;
+    }
+    else pm_selection_span(&sel, pm_buf, &offset, &length);
+
+    poll_interrupt = 1;
+    while(!interrupted) {
+        self_overhead_begin(&overhead);
+        if (smu_read_pm_table_range(&obj, pm_buf + offset, offset, length) != SMU_Return_OK)
+            continue;
+        self_overhead_stage(&overhead, OVH_READ);
+        if (recording_path) {
+            recording_write(&recorder, pm_buf, obj.pm_table_size);
+            self_overhead_bytes(&overhead, sizeof(uint64_t) + obj.pm_table_size);
+            self_overhead_stage(&overhead, OVH_WRITE);
+        }
+        export_selection(&sel, pmt);
+        if (run_once) break;
+        sleep_seconds(update_time_s, &interrupted);
+    }
+    stop_monitor();
+}
+
+//Decodes the baseline into base. pm_buf is overwritten by the next read anyway.
+void init_baseline_frame(pm_frame *base, pm_table *pmt, system_info *sysinfo, unsigned char *pm_buf, unsigned int size) {
+    if (!pm_frame_init(base, pmt, sysinfo, pm_buf)) {
+        fprintf(stderr, "Could not allocate memory for the PM Table.\n");
+        exit(0);
+    }
+    memcpy(pm_buf, baseline, size);
+    pm_frame_extract(base);
+}
+
+void start_pm_monitor(unsigned int force) {
+    unsigned char *pm_buf;
+    pm_table pmt;
+    pm_frame frame, base;
+    system_info sysinfo;
+    cpu_topology topo;
+    perf_counters perf;
+    energy_attribution ea;
+    unsigned int read_size;
+    int have_topo = 0;
+
+    pm_buf = setup_pm_monitor(force, &pmt, &sysinfo);
+    //The layout doesn't use anything beyond min_size
+    read_size = recording_path ? obj.pm_table_size : pmt.min_size;
+    if (recording_path) recording_create(&recorder, recording_path, pmt.version, obj.pm_table_size);
+    if (baseline_spec) baseline = baseline_load(baseline_spec, pmt.version, obj.pm_table_size);
+    start_overhead();
+    if (low_perturbation_mode) start_low_perturbation(&pmt, &sysinfo, pm_buf);
+    if (export_mode) start_export(&pmt, pm_buf);
+    if (!pm_frame_init(&frame, &pmt, &sysinfo, pm_buf)) {
+        fprintf(stderr, "Could not allocate memory for the PM Table.\n");
+        exit(0);
     }
+    if (baseline) init_baseline_frame(&base, &pmt, &sysinfo, pm_buf, obj.pm_table_size);
 
-    while(1) {
-        if (smu_read_pm_table(&obj, pm_buf, obj.pm_table_size) != SMU_Return_OK)
+    if (show_cpu_mapping || perf_counter_mode || attribution_top) {
+        have_topo = cpu_topology_init(&topo, &sysinfo, pmt.max_cores);
+        if (!have_topo) {
+            fprintf(stderr, "Could not read the CPU topology from sysfs.\n");
+            show_cpu_mapping = perf_counter_mode = attribution_top = 0;
+        }
+    }
+    if (attribution_top && !energy_attribution_init(&ea, pmt.max_cores)) {
+        fprintf(stderr, "Could not set up the energy attribution.\n");
+        attribution_top = 0;
+    }
+    if (perf_counter_mode && !perf_counters_init(&perf, &topo, perf_counter_mode > 1)) {
+        perror("Could not open the performance counters");
+        perf_counter_mode = 0;
+    }
+
+    poll_interrupt = 1;
+    while(!interrupted) {
+        self_overhead_begin(&overhead);
+        if (smu_read_pm_table_range(&obj, pm_buf, 0, read_size) != SMU_Return_OK)
             continue;
+        //Counted over the same interval as the PM table
+        if (perf_counter_mode) perf_counters_read(&perf);
+        self_overhead_stage(&overhead, OVH_READ);
+        if (recording_path) {
+            recording_write(&recorder, pm_buf, obj.pm_table_size);
+            self_overhead_bytes(&overhead, sizeof(uint64_t) + obj.pm_table_size);
+            self_overhead_stage(&overhead, OVH_WRITE);
+        }
+        pm_frame_extract(&frame);
+        if (baseline) pm_frame_subtract(&frame, &base);
+        self_overhead_stage(&overhead, OVH_DECODE);
+        if (have_topo) cpu_topology_sample(&topo);
+        if (attribution_top) energy_attribution_update(&ea, &frame, &sysinfo, &topo);
+        if (low_perturbation_mode) low_perturbation_update(&lowpert, &frame, &sysinfo);
+        self_overhead_stage(&overhead, OVH_DERIVE);
+
+        //Rendering is skipped while the terminal shows something else
+        if (!low_perturbation_mode || run_once || low_perturbation_watched()) {
+            //A single sample is printed as plain text for scripts
+            if (!run_once) fprintf(stdout, "\e[1;1H\e[2J"); //Move cursor to (1,1); Clear entire screen
+            if (baseline) fprintf(stdout, "Differences to the baseline %s\n", baseline_spec);
+            draw_screen(&frame, &sysinfo, have_topo ? &topo : NULL, perf_counter_mode ? &perf : NULL);
+            if (attribution_top) draw_energy_attribution(&ea);
+            if (low_perturbation_mode) low_perturbation_print(&lowpert, stdout);
+            if (show_overhead) self_overhead_print(&overhead, stdout);
+            if (run_once) break;
+            fprintf(stdout, "\e[?25l"); // Hide Cursor
+            self_overhead_stage(&overhead, OVH_RENDER);
+            fflush(stdout);
+            self_overhead_stage(&overhead, OVH_WRITE);
+        }
 
-        fprintf(stdout, "\e[1;1H\e[2J"); //Move cursor to (1,1); Clear entire screen
-        draw_screen(&pmt, &sysinfo);
-        fprintf(stdout, "\e[?25l"); // Hide Cursor
-        fflush(stdout);
+        sleep_seconds(update_time_s, &interrupted);
+    }
+    stop_monitor();
+}
 
-        sleep(update_time_s);
+int start_workload_monitor(unsigned int force, char **command) {
+    unsigned char *pm_buf;
+    pm_table pmt;
+    pm_frame frame;
+    system_info sysinfo;
+    int ret;
+
+    pm_buf = setup_pm_monitor(force, &pmt, &sysinfo);
+    if (!pm_frame_init(&frame, &pmt, &sysinfo, pm_buf)) {
+        fprintf(stderr, "Could not allocate memory for the PM Table.\n");
+        exit(0);
     }
+
+    ret = run_workload(&obj, &frame, &sysinfo, pm_buf, command, update_time_s);
+
+    pm_frame_free(&frame);
+    pm_table_free(&pmt);
+    free_core_disable_map(&sysinfo);
+    free(pm_buf);
+
+    return ret;
 }
 
 void read_from_dumpfile(char *dumpfile, unsigned int version) {
-    unsigned char readbuf[10240];
+    unsigned char readbuf[10240], dumpbuf[10240];
     unsigned int bytes_read;
     pm_table pmt;
+    pm_frame frame, base;
     system_info sysinfo;
     FILE *fd;
 
@@ -467,10 +783,37 @@ void read_from_dumpfile(char *dumpfile, unsigned int version) {
     
     sysinfo.available=0; //Did not read sysinfo
     sysinfo.enabled_cores_count = pmt.max_cores;
-    sysinfo.core_disable_map=0;
+    sysinfo.core_disable_map=NULL; //No fuses read, all cores enabled
+    sysinfo.core_disable_map_size=0;
     sysinfo.cores=sysinfo.enabled_cores_count;
 
-    draw_screen(&pmt, &sysinfo);
+    if (baseline_spec) baseline = baseline_load(baseline_spec, version, pmt.min_size);
+
+    if (export_mode) {
+        pm_selection sel;
+
+        compile_selection(&sel, &pmt, readbuf);
+        export_selection(&sel, &pmt);
+        pm_selection_free(&sel);
+        return;
+    }
+
+    if (!pm_frame_init(&frame, &pmt, &sysinfo, (unsigned char*)readbuf)) {
+        fprintf(stderr, "Could not allocate memory for the PM Table.\n");
+        exit(0);
+    }
+    if (baseline) {
+        memcpy(dumpbuf, readbuf, sizeof(readbuf));
+        init_baseline_frame(&base, &pmt, &sysinfo, readbuf, pmt.min_size);
+        memcpy(readbuf, dumpbuf, sizeof(readbuf));
+    }
+    pm_frame_extract(&frame);
+    if (baseline) {
+        pm_frame_subtract(&frame, &base);
+        fprintf(stdout, "Differences to the baseline %s\n", baseline_spec);
+    }
+
+    draw_screen(&frame, &sysinfo, NULL, NULL);
 }
 
 void print_version() {
@@ -482,36 +825,101 @@ void show_help(char* program) {
     fprintf(stdout,
         "Ryzen Monitor " PROGRAM_VERSION "\n\n"
 
-        "Usage: %s <option(s)>\n\n"
+        "Usage: %s <option(s)> [-- <command> [args...]]\n"
+        "       %s [-f<hex-value>] [-l<path>] diff [-e<delta>] [-E<percent>] [-s] [-n<N>] <a> <b>\n\n"
 
         "Options:\n"
             "\t-h            - Show this help screen.\n"
             "\t-v            - Show program version.\n"
             "\t-m            - Print DRAM Timings and exit.\n"
             "\t-d            - Show disabled cores.\n"
+            "\t-c            - Show Linux CPU ids and OS utilization of each hardware thread per core.\n"
+            "\t-p[2]         - Show IPC, instructions per Joule and cycle clock per core from perf_event counters.\n"
+            "\t                -p2 additionally counts cache misses.\n"
+            "\t-a[N]         - Estimate the energy used by each process and cgroup. Shows the top N. Defaults to 10.\n"
             "\t-u<seconds>   - Update the monitoring only after this number of second(s) have passed. Defaults to 1.\n"
+            "\t                Fractions are allowed. Defaults to 0.1 when running a command.\n"
             "\t-f<hex-value> - Force to use a specific PM table version.\n"
-            "\t-t<filename>  - Test mode. Read PM Table from raw-dumfile. Use in conjunction with -f\n",
-        program
+            "\t-l<path>      - Load PM table layouts from a file or from all *.layout files in a directory.\n"
+            "\t                Loaded layouts take precedence over the built-in ones.\n"
+            "\t-L[N]         - Learn the layout of the PM table from N samples (default %d, one every %gs or -u)\n"
+            "\t                and write a proposal for -l to stdout. Works best while the load varies.\n"
+            "\t-S[spec]      - Map per core fields: load one CPU at a time and rank the PM table offsets by\n"
+            "\t                correlation with each CPU. spec lists load kinds (scalar, avx2, memory) and CPUs,\n"
+            "\t                e.g. -Savx2,0-7. Defaults to all kinds on every physical core.\n"
+            "\t-r<filename>  - Record the raw PM table of every update to this file. See diff.\n"
+            "\t-B<file>[:s]  - Capture an idle baseline: the mean of every PM table value over s seconds\n"
+            "\t                (default %d, one sample every %gs or -u). Written as a recording.\n"
+            "\t-b<file>      - Show all values as differences to a baseline, also with -o and -t. Any recording\n"
+            "\t                or time range of one (file@start:end) can serve as the baseline.\n"
+            "\t-H[2]         - Print latency percentiles of the SMU commands and PM table reads on exit.\n"
+            "\t                -H2 additionally measures the contention of the libsmu locks.\n"
+            "\t-z[cpu]       - Low-perturbation mode: pin the monitor to this CPU or the least idle core, coalesce\n"
+            "\t                its timer and output, and skip rendering in the background. Shows the overhead.\n"
+            "\t-O            - Show the monitor's own cost: time per stage of each sample, CPU time, wakeups\n"
+            "\t                and bytes written per second. Also in the -o output and as a summary on exit.\n"
+            "\t-t<filename>  - Test mode. Read PM Table from raw-dumfile. Use in conjunction with -f\n"
+            "\t--once        - Print a single sample or export line and exit.\n"
+            "\t--no-cache    - Don't use or write the cache of the static platform information\n"
+            "\t                (" PLATFORM_CACHE_PATH ").\n"
+            "\t-x<config>    - Simulate the SMU instead of using the ryzen_smu driver, e.g. -x pm=rec.bin,latency=300.\n"
+            "\t                Serves PM tables from a recording and SMN registers from a snapshot. See README.\n"
+            "\t-o<format>    - Write the PM table to stdout as json (one object per line) or prometheus\n"
+            "\t                (text format) instead of showing the screen.\n"
+            "\t-F<patterns>  - Only export the fields matching these comma separated glob patterns,\n"
+            "\t                e.g. -F 'CORE_TEMP*,L3_*,PPT_VALUE'. Implies -o json.\n\n"
+
+        "If a command is given, it is run while the PM Table is sampled. When it exits, a summary\n"
+        "of energy, power, temperature, throttling, frequency and C-state residency is printed to\n"
+        "stderr. The exit code of the command is passed through.\n\n"
+
+        "diff compares two dumps or recordings, or time ranges of recordings given as file@start:end\n"
+        "in seconds, and lists the slots whose values changed. See diff -h.\n",
+        program, program, LEARN_DEFAULT_SAMPLES, LEARN_DEFAULT_INTERVAL,
+        BASELINE_DEFAULT_SECONDS, BASELINE_DEFAULT_INTERVAL
     );
 }
 
+void print_smu_stats() {
+    fprintf(stderr, "\nSMU command latencies:\n");
+    smu_print_histograms(&obj, stderr);
+    if (show_smu_stats > 1) {
+        fprintf(stderr, "\nSMU lock contention:\n");
+        smu_print_lock_stats(&obj, stderr);
+    }
+}
+
 void signal_interrupt(int sig) {
     switch (sig) {
         case SIGINT:
         case SIGABRT:
         case SIGTERM:
+            //Printing from here could interrupt a frame or a held libsmu lock
+            if (poll_interrupt) {
+                interrupted = 1;
+                break;
+            }
             // Re-enable the cursor.
-            fprintf(stdout, "\e[?25h");
+            if (!export_mode) fprintf(stdout, "\e[?25h");
+            recording_close(&recorder);
             exit(0);
         default:
             break;
     }
 }
 
+enum { OPT_ONCE = 256, OPT_NO_CACHE };
+
+static const struct option long_options[] = {
+    {"once",     no_argument, NULL, OPT_ONCE},
+    {"no-cache", no_argument, NULL, OPT_NO_CACHE},
+    {NULL,       0,           NULL, 0}
+};
+
 int main(int argc, char** argv) {
     smu_return_val ret;
-    int c=0, force=0, core=0, printtimings=0;
+    int c=0, force=0, core=0, printtimings=0, update_time_set=0, learn_samples=0, stimulus=0;
+    char *stimulus_spec=NULL, *capture_spec=NULL, *sim_config=NULL;
     char *dumpfile=0;
 
     //Set up signal handlers
@@ -523,8 +931,14 @@ int main(int argc, char** argv) {
     }
 
     //Parse arguments
-    while ((c = getopt(argc, argv, "vmd::f:t:u:h")) != -1) {
+    while ((c = getopt_long(argc, argv, "+vmd::cp::a::f:l:L::S::r:B:b:t:x:u:o:F:H::z::Oh", long_options, NULL)) != -1) {
         switch (c) {
+            case OPT_ONCE:
+                run_once = 1;
+                break;
+            case OPT_NO_CACHE:
+                use_platform_cache = 0;
+                break;
             case 'v':
                 print_version();
                 exit(0);
@@ -537,12 +951,61 @@ int main(int argc, char** argv) {
                 else
                     show_disabled_cores = 1;
                 break;
+            case 'c':
+                show_cpu_mapping = 1;
+                break;
+            case 'p':
+                if (optarg)
+                    perf_counter_mode = atoi(optarg);
+                else
+                    perf_counter_mode = 1;
+                break;
+            case 'a':
+                if (optarg)
+                    attribution_top = atoi(optarg);
+                else
+                    attribution_top = 10;
+                break;
             case 'f':
                 if(!optarg || sscanf(optarg,"%x", &force)!=1) {
                     show_help(argv[0]);
                     exit(0);
                 }
                 break;
+            case 'l':
+                if(!optarg || strlen(optarg)==0) {
+                    show_help(argv[0]);
+                    exit(0);
+                }
+                pm_layout_load(optarg);
+                break;
+            case 'L':
+                if (optarg)
+                    learn_samples = atoi(optarg);
+                else
+                    learn_samples = LEARN_DEFAULT_SAMPLES;
+                if (learn_samples < 2) {
+                    show_help(argv[0]);
+                    exit(0);
+                }
+                break;
+            case 'S':
+                stimulus = 1;
+                stimulus_spec = optarg;
+                break;
+            case 'r':
+                if(!optarg || strlen(optarg)==0) {
+                    show_help(argv[0]);
+                    exit(0);
+                }
+                recording_path=optarg;
+                break;
+            case 'B':
+                capture_spec=optarg;
+                break;
+            case 'b':
+                baseline_spec=optarg;
+                break;
             case 't':
                 if(!optarg || strlen(optarg)==0) {
                     show_help(argv[0]);
@@ -550,8 +1013,36 @@ int main(int argc, char** argv) {
                 }
                 dumpfile=optarg;
                 break;
+            case 'x':
+                sim_config=optarg;
+                break;
+            case 'o':
+                export_mode = export_parse_format(optarg);
+                if (export_mode == EXPORT_NONE) {
+                    fprintf(stderr, "Unknown output format \"%s\". Use json or prometheus.\n", optarg);
+                    exit(0);
+                }
+                break;
+            case 'F':
+                field_patterns = optarg;
+                break;
             case 'u':
-                update_time_s = atoi(optarg);
+                update_time_s = atof(optarg);
+                update_time_set = 1;
+                break;
+            case 'H':
+                if (optarg)
+                    show_smu_stats = atoi(optarg);
+                else
+                    show_smu_stats = 1;
+                break;
+            case 'z':
+                low_perturbation_mode = 1;
+                if (optarg)
+                    low_perturbation_cpu = atoi(optarg);
+                break;
+            case 'O':
+                show_overhead = 1;
                 break;
             case 'h':
                 show_help(argv[0]);
@@ -563,22 +1054,64 @@ int main(int argc, char** argv) {
         }
     }
 
+    if (field_patterns && !export_mode) export_mode = EXPORT_JSON;
+
+    //"-- diff" still runs the diff program as a workload
+    if (optind < argc && !strcmp(argv[optind], "diff") && strcmp(argv[optind - 1], "--"))
+        return run_diff(argc - optind, argv + optind, force, stdout);
+
     if(dumpfile && !printtimings)
         read_from_dumpfile(dumpfile, force);
     else
     {
-        if (getuid() != 0 && geteuid() != 0) {
+        if (!sim_config && getuid() != 0 && geteuid() != 0) {
             fprintf(stderr, "Program must be run as root.\n");
             exit(-2);
         }
 
-        ret = smu_init(&obj);
+        //The simulator has nothing to cache
+        if (sim_config) {
+            use_platform_cache = 0;
+            ret = smu_init_backend(&obj, &smu_sim_backend, sim_config);
+        }
+        else if (use_platform_cache && platform_cache_load(&pcache) &&
+            smu_init_static(&obj, &pcache.smu) == SMU_Return_OK)
+            ret = SMU_Return_OK;
+        else {
+            ret = smu_init(&obj);
+            if (ret == SMU_Return_OK && use_platform_cache) {
+                platform_cache_load(&pcache);
+                pcache.has_topology = 0;
+                platform_cache_set_smu(&pcache, &obj);
+                platform_cache_save(&pcache);
+            }
+        }
         if (ret != SMU_Return_OK) {
             fprintf(stderr, "%s\n", smu_return_to_str(ret));
             exit(-2);
         }
+        if (show_smu_stats) atexit(print_smu_stats);
+        if (show_smu_stats > 1) smu_lock_stats_enable(&obj, 1);
 
-        if(printtimings) print_memory_timings();
+        if(printtimings) print_memory_timings(&obj);
+        else if(stimulus || learn_samples || capture_spec) {
+            if (!smu_pm_tables_supported(&obj)) {
+                fprintf(stderr, "PM Tables are not supported on this platform.\n");
+                exit(0);
+            }
+            if (capture_spec)
+                return baseline_capture(&obj, force ? force : obj.pm_table_version, capture_spec,
+                    update_time_set ? update_time_s : BASELINE_DEFAULT_INTERVAL);
+            if (stimulus)
+                return run_stimulus(&obj, stimulus_spec, update_time_set ? update_time_s : STIM_DEFAULT_INTERVAL, stdout);
+            if (force) fprintf(stderr, "Learning as PM Table version 0x%x. System reports version 0x%x.\n", force, obj.pm_table_version);
+            return run_layout_learning(&obj, force ? force : obj.pm_table_version, learn_samples,
+                update_time_set ? update_time_s : LEARN_DEFAULT_INTERVAL, stdout);
+        }
+        else if(optind < argc) {
+            if (!update_time_set) update_time_s = 0.1;
+            return start_workload_monitor(force, argv + optind);
+        }
         else start_pm_monitor(force);
     }
 
@@ -0,0 +1,136 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "self_overhead.h"
+#include "timing.h"
+
+#define OVH_STDOUT_BUFFER (256 * 1024)
+
+const char *self_overhead_stage_names[OVH_NUM_STAGES] = { "read", "decode", "derive", "render", "write" };
+
+//Seconds per TSC tick, measured over the whole run
+static double tick_seconds(self_overhead *o, double now) {
+    uint64_t ticks = __rdtsc() - o->start_tsc;
+
+    return ticks ? (now - o->start_time) / ticks : 0;
+}
+
+void self_overhead_init(self_overhead *o) {
+    memset(o, 0, sizeof(self_overhead));
+    o->start_time = o->last_time = monotonic_s();
+    o->start_tsc = o->mark = __rdtsc();
+    process_usage(&o->start_cpu_time, &o->start_wakeups);
+    o->last_cpu_time = o->start_cpu_time;
+    o->last_wakeups = o->start_wakeups;
+}
+
+static ssize_t counting_write(void *cookie, const char *buf, size_t size) {
+    self_overhead *o = cookie;
+    size_t done = 0;
+    ssize_t n;
+
+    while (done < size) {
+        n = write(STDOUT_FILENO, buf + done, size - done);
+        if (n <= 0) return done ? (ssize_t)done : -1;
+        done += n;
+    }
+    self_overhead_bytes(o, done);
+
+    return done;
+}
+
+int self_overhead_wrap_stdout(self_overhead *o) {
+    cookie_io_functions_t io = { NULL, counting_write, NULL, NULL };
+    FILE *fp;
+
+    fflush(stdout);
+    fp = fopencookie(o, "w", io);
+    if (!fp) return 0;
+    setvbuf(fp, NULL, _IOFBF, OVH_STDOUT_BUFFER);
+    stdout = fp;
+
+    return 1;
+}
+
+void self_overhead_begin(self_overhead *o) {
+    double now, cpu_time, dt, tick;
+    long wakeups;
+    int i;
+
+    now = monotonic_s();
+    if (o->frames) {
+        process_usage(&cpu_time, &wakeups);
+        tick = tick_seconds(o, now);
+        for (i = 0; i < OVH_NUM_STAGES; i++) {
+            o->stage_s[i] = o->ticks[i] * tick;
+            o->total_ticks[i] += o->ticks[i];
+        }
+        dt = now - o->last_time;
+        if (dt > 0) {
+            o->cpu_percent = (cpu_time - o->last_cpu_time) * 100. / dt;
+            o->wakeups_per_s = (wakeups - o->last_wakeups) / dt;
+            o->bytes_per_s = o->bytes / dt;
+        }
+        o->last_cpu_time = cpu_time;
+        o->last_wakeups = wakeups;
+    }
+    o->last_time = now;
+    o->total_bytes += o->bytes;
+    o->bytes = 0;
+    memset(o->ticks, 0, sizeof(o->ticks));
+    o->frames++;
+    o->mark = __rdtsc();
+}
+
+void self_overhead_print(const self_overhead *o, FILE *out) {
+    int i;
+
+    fprintf(out, "Monitor: %.3f%% CPU, %.1f wakeups/s, %.0f B/s |", o->cpu_percent, o->wakeups_per_s, o->bytes_per_s);
+    for (i = 0; i < OVH_NUM_STAGES; i++)
+        fprintf(out, " %s %.0f us", self_overhead_stage_names[i], o->stage_s[i] * 1e6);
+    fprintf(out, "\n");
+}
+
+void self_overhead_summary(self_overhead *o, FILE *out) {
+    double now, cpu_time, dt, tick;
+    uint64_t frames;
+    long wakeups;
+    int i;
+
+    now = monotonic_s();
+    process_usage(&cpu_time, &wakeups);
+    dt = now - o->start_time;
+    tick = tick_seconds(o, now);
+    //The current frame counts as far as it got
+    frames = o->frames ? o->frames : 1;
+    if (dt <= 0) return;
+
+    fprintf(out, "Monitor overhead over %.1fs and %llu frames: %.4f%% CPU (%.3fs), %.2f wakeups/s, %.0f B/s\n",
+        dt, (unsigned long long)o->frames, (cpu_time - o->start_cpu_time) * 100. / dt, cpu_time - o->start_cpu_time,
+        (wakeups - o->start_wakeups) / dt, (o->total_bytes + o->bytes) / dt);
+    fprintf(out, "Per frame:");
+    for (i = 0; i < OVH_NUM_STAGES; i++)
+        fprintf(out, " %s %.1f us", self_overhead_stage_names[i], (o->total_ticks[i] + o->ticks[i]) * tick * 1e6 / frames);
+    fprintf(out, "\n");
+}
@@ -0,0 +1,89 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef SELF_OVERHEAD_H
+#define SELF_OVERHEAD_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <x86intrin.h>
+
+/**
+ * What the monitor costs: time per stage of each frame from TSC timestamps,
+ * its own CPU time and voluntary context switches (wakeups) from getrusage,
+ * and the bytes it writes. TSC ticks are converted with the rate measured
+ * against CLOCK_MONOTONIC since init, so nothing is calibrated up front.
+ **/
+
+enum {
+    OVH_READ,       //PM table from the driver
+    OVH_DECODE,     //Frame or selection
+    OVH_DERIVE,     //Topology, perf counters, energy attribution
+    OVH_RENDER,     //Screen or export formatting into the stdout buffer
+    OVH_WRITE,      //stdout and recording writes
+    OVH_NUM_STAGES
+};
+
+extern const char *self_overhead_stage_names[OVH_NUM_STAGES];
+
+typedef struct {
+    uint64_t mark;                          //TSC at the end of the last stage
+    uint64_t ticks[OVH_NUM_STAGES];         //Current frame
+    uint64_t total_ticks[OVH_NUM_STAGES];
+    uint64_t frames;
+    uint64_t bytes, total_bytes;
+
+    uint64_t start_tsc;
+    double start_time, start_cpu_time;
+    long start_wakeups;
+    double last_time, last_cpu_time;
+    long last_wakeups;
+
+    //Last complete frame
+    double stage_s[OVH_NUM_STAGES];
+    double cpu_percent;                     //Of one CPU, since the frame before
+    double wakeups_per_s;
+    double bytes_per_s;
+} self_overhead;
+
+void self_overhead_init(self_overhead *o);
+
+//Replaces stdout with a fully buffered stream that counts the bytes written through it.
+//Returns 0 if that is not possible, stdout then stays as it is.
+int self_overhead_wrap_stdout(self_overhead *o);
+
+//Starts a frame. The figures of the previous one become available.
+void self_overhead_begin(self_overhead *o);
+
+//Adds the time since the previous mark to a stage. Can be called several times per stage.
+static inline void self_overhead_stage(self_overhead *o, int stage) {
+    uint64_t t = __rdtsc();
+
+    o->ticks[stage] += t - o->mark;
+    o->mark = t;
+}
+
+#define self_overhead_bytes(o, n) ((o)->bytes += (n))
+
+//One line with the figures of the last frame
+void self_overhead_print(const self_overhead *o, FILE *out);
+//Totals since init
+void self_overhead_summary(self_overhead *o, FILE *out);
+
+#endif
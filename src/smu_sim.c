@@ -0,0 +1,345 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "smu_sim.h"
+#include "recording.h"
+#include "timing.h"
+
+enum { SIM_STEP, SIM_TIME, SIM_RANDOM };
+
+typedef struct {
+    unsigned int address;
+    unsigned int value;
+} sim_register;
+
+typedef struct {
+    recording rec;
+    unsigned char *dump;        //Raw dump if pm= is no recording
+    uint64_t next;              //Frame of the next read in step order
+    uint64_t start_ns;          //Time of the first read in time order
+    int order;
+    double speed;
+
+    sim_register *regs;         //Sorted by address
+    unsigned int num_regs, cap_regs;
+
+    double latency_us, jitter_us, busy;
+    uint64_t rng[SMU_MUTEX_COUNT]; //One per lock, the backend functions of different locks run concurrently
+} smu_sim;
+
+//xorshift64*, uniform in [0, 1)
+static double sim_random(smu_sim *sim, int lock) {
+    uint64_t x = sim->rng[lock];
+
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    sim->rng[lock] = x;
+    return (double)((x * 0x2545F4914F6CDD1Dull) >> 11) / (double)(1ull << 53);
+}
+
+static void sim_delay(smu_sim *sim, int lock) {
+    double us;
+
+    us = sim->latency_us;
+    if (sim->jitter_us > 0) us += sim->jitter_us * sim_random(sim, lock);
+    sleep_seconds(us / 1e6, NULL);
+}
+
+static sim_register* find_register(smu_sim *sim, unsigned int address, unsigned int *pos) {
+    unsigned int lo = 0, hi = sim->num_regs, mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (sim->regs[mid].address < address) lo = mid + 1;
+        else hi = mid;
+    }
+    *pos = lo;
+    return lo < sim->num_regs && sim->regs[lo].address == address ? &sim->regs[lo] : NULL;
+}
+
+static void set_register(smu_sim *sim, unsigned int address, unsigned int value) {
+    sim_register *reg, *regs;
+    unsigned int pos;
+
+    reg = find_register(sim, address, &pos);
+    if (reg) {
+        reg->value = value;
+        return;
+    }
+    if (sim->num_regs == sim->cap_regs) {
+        sim->cap_regs = sim->cap_regs ? sim->cap_regs * 2 : 64;
+        regs = realloc(sim->regs, sim->cap_regs * sizeof(sim_register));
+        if (!regs) {
+            fprintf(stderr, "Could not allocate memory for the SMN snapshot.\n");
+            exit(0);
+        }
+        sim->regs = regs;
+    }
+    memmove(&sim->regs[pos + 1], &sim->regs[pos], (sim->num_regs - pos) * sizeof(sim_register));
+    sim->regs[pos].address = address;
+    sim->regs[pos].value = value;
+    sim->num_regs++;
+}
+
+static void load_snapshot(smu_sim *sim, const char *path) {
+    unsigned int address, value;
+    char line[256], *p, *end;
+    FILE *fp;
+    int n;
+
+    fp = fopen(path, "r");
+    if (!fp) {
+        fprintf(stderr, "Could not read the SMN snapshot \"%s\".\n", path);
+        exit(0);
+    }
+    for (n = 1; fgets(line, sizeof(line), fp); n++) {
+        if ((p = strchr(line, '#'))) *p = 0;
+        for (p = line; isspace((unsigned char)*p); p++);
+        if (!*p) continue;
+        address = strtoul(p, &end, 0);
+        if (end == p) p = NULL;
+        else value = strtoul(p = end, &end, 0);
+        if (!p || end == p) {
+            fprintf(stderr, "%s:%d: Expected an address and a value\n", path, n);
+            exit(0);
+        }
+        set_register(sim, address, value);
+    }
+    fclose(fp);
+}
+
+static void load_dump(smu_obj_t* obj, smu_sim *sim, const char *path) {
+    FILE *fp;
+    long size;
+
+    fp = fopen(path, "rb");
+    if (!fp || fseek(fp, 0, SEEK_END) || (size = ftell(fp)) <= 0 || fseek(fp, 0, SEEK_SET) ||
+        !(sim->dump = malloc(size)) || fread(sim->dump, size, 1, fp) != 1) {
+        fprintf(stderr, "Could not read the PM table dump \"%s\".\n", path);
+        exit(0);
+    }
+    fclose(fp);
+    obj->pm_table_size = size;
+}
+
+static void set_codename(smu_obj_t* obj, const char *name) {
+    const char *s, *n;
+
+    //Compared like smu_codename_to_str prints them, ignoring case and blanks
+    for (obj->codename = 0; obj->codename < CODENAME_COUNT; obj->codename++) {
+        for (s = smu_codename_to_str(obj), n = name; *s || *n; s++, n++) {
+            while (*s == ' ') s++;
+            if (tolower((unsigned char)*s) != tolower((unsigned char)*n)) break;
+        }
+        if (!*s && !*n) return;
+    }
+    fprintf(stderr, "Unknown codename \"%s\".\n", name);
+    exit(0);
+}
+
+static smu_return_val sim_init(smu_obj_t* obj, const char* config) {
+    char *copy, *item, *value, *save, *pm_path = NULL, *codename = NULL;
+    unsigned int i, version = 0;
+    smu_sim *sim;
+
+    sim = calloc(1, sizeof(smu_sim));
+    copy = strdup(config ? config : "");
+    if (!sim || !copy) return SMU_Return_Failed;
+    obj->backend_data = sim;
+    sim->speed = 1;
+    sim->rng[0] = 0x9E3779B97F4A7C15ull;
+
+    for (item = strtok_r(copy, ",", &save); item; item = strtok_r(NULL, ",", &save)) {
+        value = strchr(item, '=');
+        if (!value) {
+            fprintf(stderr, "Simulator setting \"%s\" has no value.\n", item);
+            exit(0);
+        }
+        *value++ = 0;
+        if      (!strcmp(item, "pm"))       pm_path = value;
+        else if (!strcmp(item, "smn"))      load_snapshot(sim, value);
+        else if (!strcmp(item, "latency"))  sim->latency_us = atof(value);
+        else if (!strcmp(item, "jitter"))   sim->jitter_us = atof(value);
+        else if (!strcmp(item, "busy"))     sim->busy = atof(value);
+        else if (!strcmp(item, "speed"))    sim->speed = atof(value), sim->order = SIM_TIME;
+        else if (!strcmp(item, "version"))  version = strtoul(value, NULL, 16);
+        else if (!strcmp(item, "codename")) codename = value;
+        else if (!strcmp(item, "fw"))       obj->smu_version = strtoul(value, NULL, 16);
+        else if (!strcmp(item, "seed"))     sim->rng[0] = strtoull(value, NULL, 0) | 1;
+        else if (!strcmp(item, "order")) {
+            if      (!strcmp(value, "step"))   sim->order = SIM_STEP;
+            else if (!strcmp(value, "time"))   sim->order = SIM_TIME;
+            else if (!strcmp(value, "random")) sim->order = SIM_RANDOM;
+            else {
+                fprintf(stderr, "Unknown simulator order \"%s\". Use step, time or random.\n", value);
+                exit(0);
+            }
+        }
+        else {
+            fprintf(stderr, "Unknown simulator setting \"%s\".\n", item);
+            exit(0);
+        }
+    }
+    for (i = 1; i < SMU_MUTEX_COUNT; i++)
+        sim->rng[i] = sim->rng[0] * (2 * i + 1);
+
+    if (pm_path) {
+        if (recording_open(&sim->rec, pm_path)) {
+            if (!sim->rec.frames) {
+                fprintf(stderr, "The recording \"%s\" has no frames.\n", pm_path);
+                exit(0);
+            }
+            obj->pm_table_version = sim->rec.header.pm_table_version;
+            obj->pm_table_size = sim->rec.header.pm_table_size;
+        }
+        else {
+            if (!version) {
+                fprintf(stderr, "\"%s\" is no recording. Set the PM table version of the dump with version=.\n", pm_path);
+                exit(0);
+            }
+            load_dump(obj, sim, pm_path);
+        }
+        if (version) obj->pm_table_version = version;
+    }
+
+    //Guess the processor from the PM table version, like the families in pm_tables.c
+    switch (obj->pm_table_version >> 16) {
+        case 0x24: obj->codename = CODENAME_MATISSE; obj->smu_if_version = IF_VERSION_11; break;
+        case 0x38: obj->codename = CODENAME_VERMEER; obj->smu_if_version = IF_VERSION_11; break;
+        case 0x40: obj->codename = CODENAME_CEZANNE; obj->smu_if_version = IF_VERSION_12; break;
+        default:   obj->codename = CODENAME_UNDEFINED; obj->smu_if_version = IF_VERSION_11; break;
+    }
+    if (codename) set_codename(obj, codename);
+
+    free(copy);
+
+    return SMU_Return_OK;
+}
+
+static void sim_free(smu_obj_t* obj) {
+    smu_sim *sim = obj->backend_data;
+
+    if (!sim) return;
+    recording_free(&sim->rec);
+    free(sim->dump);
+    free(sim->regs);
+    free(sim);
+    obj->backend_data = NULL;
+}
+
+static smu_return_val sim_read_smn(smu_obj_t* obj, unsigned int address, unsigned int* result) {
+    smu_sim *sim = obj->backend_data;
+    sim_register *reg;
+    unsigned int pos;
+
+    sim_delay(sim, SMU_MUTEX_SMN);
+    reg = find_register(sim, address, &pos);
+    *result = reg ? reg->value : 0;
+
+    return SMU_Return_OK;
+}
+
+static smu_return_val sim_write_smn(smu_obj_t* obj, unsigned int address, unsigned int value) {
+    smu_sim *sim = obj->backend_data;
+
+    sim_delay(sim, SMU_MUTEX_SMN);
+    set_register(sim, address, value);
+
+    return SMU_Return_OK;
+}
+
+//Commands are acknowledged with their arguments unchanged
+static smu_return_val sim_send_command(smu_obj_t* obj, unsigned int op, smu_arg_t* args,
+    enum smu_mailbox mailbox) {
+    smu_sim *sim = obj->backend_data;
+
+    //Commands only cost time, they don't change the simulated state
+    (void)op;
+    (void)args;
+    (void)mailbox;
+
+    sim_delay(sim, SMU_MUTEX_CMD);
+    if (sim->busy > 0 && sim_random(sim, SMU_MUTEX_CMD) < sim->busy)
+        return SMU_Return_CmdRejectedBusy;
+
+    return SMU_Return_OK;
+}
+
+//Table to serve for the next read
+static const unsigned char* sim_next_table(smu_sim *sim) {
+    uint64_t frame, now, first, span;
+
+    if (sim->dump) return sim->dump;
+    if (!sim->rec.frames) return NULL;
+
+    switch (sim->order) {
+        case SIM_TIME:
+            //The last frame recorded at the scaled time since the first read, wrapping around at the end
+            now = monotonic_ns();
+            if (!sim->start_ns) sim->start_ns = now;
+            first = recording_timestamp(&sim->rec, 0);
+            span = recording_timestamp(&sim->rec, sim->rec.frames - 1) - first + 1;
+            frame = recording_find(&sim->rec, first + (uint64_t)((now - sim->start_ns) * sim->speed) % span + 1) - 1;
+            break;
+        case SIM_RANDOM:
+            frame = (uint64_t)(sim_random(sim, SMU_MUTEX_PM) * sim->rec.frames);
+            break;
+        default:
+            frame = sim->next;
+            sim->next = (sim->next + 1) % sim->rec.frames;
+            break;
+    }
+
+    return recording_table(&sim->rec, frame);
+}
+
+static smu_return_val sim_read_pm_table_range(smu_obj_t* obj, unsigned char* dst, size_t offset,
+    size_t len) {
+    smu_sim *sim = obj->backend_data;
+    const unsigned char *table;
+
+    sim_delay(sim, SMU_MUTEX_PM);
+    table = sim_next_table(sim);
+    if (!table) return SMU_Return_Unsupported;
+    memcpy(dst, table + offset, len);
+
+    return SMU_Return_OK;
+}
+
+static smu_return_val sim_read_pm_table(smu_obj_t* obj, unsigned char* dst, size_t dst_len) {
+    return sim_read_pm_table_range(obj, dst, 0, dst_len);
+}
+
+const smu_backend smu_sim_backend = {
+    .name           = "simulator",
+    .init           = sim_init,
+    .free           = sim_free,
+    .read_smn       = sim_read_smn,
+    .write_smn      = sim_write_smn,
+    .send_command   = sim_send_command,
+    .read_pm_table  = sim_read_pm_table,
+    .read_pm_table_range = sim_read_pm_table_range,
+};
@@ -0,0 +1,43 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef SMU_SIM_H
+#define SMU_SIM_H
+
+#include <libsmu.h>
+
+/**
+ * libsmu backend that simulates the SMU from files, for running without the
+ * ryzen_smu driver. Initialized with smu_init_backend(obj, &smu_sim_backend, config).
+ *
+ * config is a comma separated list of settings:
+ *   pm=<file>        PM tables from a recording (-r) or a raw dump (-t, needs version=)
+ *   order=<mode>     step: the next frame on every read, wrapping around (default)
+ *                    time: follow the recorded timestamps, scaled by speed=<x>
+ *                    random: a random frame on every read
+ *   smn=<file>       SMN register snapshot, "<address> <value>" per line. Other
+ *                    addresses read as 0. Writes are kept.
+ *   latency=<us>     Added to every access, plus up to jitter=<us> at random
+ *   busy=<p>         Probability of a command being rejected as busy
+ *   version=<hex>, codename=<name>, fw=<hex>, seed=<n>
+ **/
+
+extern const smu_backend smu_sim_backend;
+
+#endif
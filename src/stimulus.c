@@ -0,0 +1,416 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/**
+ * Controlled per core load for mapping the PM table.
+ *
+ * One worker thread is pinned to each selected CPU. The schedule loads a
+ * single CPU at a time, cycling through the CPUs and load kinds, while the
+ * main thread samples the PM table. Every offset is then correlated with the
+ * on/off schedule of each CPU. Per core arrays show up as offsets that follow
+ * the CPU of PM table core n at base + n.
+ **/
+
+#define _GNU_SOURCE
+
+#include <math.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "stimulus.h"
+#include "layout_learn.h"
+#include "cpu_topology.h"
+#include "timing.h"
+
+#define STIM_IDLE  -1
+#define STIM_EXIT  -2
+#define STIM_MEMORY_BYTES (64 << 20)   //Larger than the L3 of current parts
+#define STIM_BURST 200000              //Iterations between checks of the state
+
+typedef struct {
+    pthread_t thread;
+    int cpu;
+    int state;          //STIM_*, STIM_IDLE or STIM_EXIT
+    int running;
+} stim_worker;
+
+static const char * const stim_kind_names[STIM_NUM_KINDS] = { "scalar", "avx2", "memory" };
+
+static size_t *chase;           //Shared by the memory workers. Only one runs at a time.
+static int have_avx2;
+static volatile double stim_sink;
+
+static void spin_scalar() {
+    unsigned long long x = 88172645463325252ull;
+    double f = 1.0;
+    int i;
+
+    for (i = 0; i < STIM_BURST; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        f = f * 1.0000001 + (double)(x & 0xff) * 1e-9;
+    }
+    stim_sink += f + x;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2,fma")))
+static void spin_avx2() {
+    __m256 a0, a1, a2, a3, m, c;
+    float r[8];
+    int i;
+
+    a0 = a1 = a2 = a3 = _mm256_set1_ps(1.0f);
+    m = _mm256_set1_ps(0.999999f);
+    c = _mm256_set1_ps(1e-6f);
+    //Four independent chains keep both FMA ports busy
+    for (i = 0; i < STIM_BURST / 4; i++) {
+        a0 = _mm256_fmadd_ps(a0, m, c);
+        a1 = _mm256_fmadd_ps(a1, m, c);
+        a2 = _mm256_fmadd_ps(a2, m, c);
+        a3 = _mm256_fmadd_ps(a3, m, c);
+    }
+    _mm256_storeu_ps(r, _mm256_add_ps(_mm256_add_ps(a0, a1), _mm256_add_ps(a2, a3)));
+    stim_sink += r[0];
+}
+#else
+static void spin_avx2() {
+    spin_scalar();
+}
+#endif
+
+static void spin_memory() {
+    size_t p = 0;
+    int i;
+
+    for (i = 0; i < STIM_BURST / 50; i++) p = chase[p];
+    stim_sink += p;
+}
+
+static void* worker_main(void *arg) {
+    stim_worker *w = arg;
+    cpu_set_t set;
+    int state;
+
+    CPU_ZERO(&set);
+    CPU_SET(w->cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+
+    while ((state = __atomic_load_n(&w->state, __ATOMIC_RELAXED)) != STIM_EXIT) {
+        switch (state) {
+            case STIM_SCALAR: spin_scalar(); break;
+            case STIM_AVX2:   if (have_avx2) spin_avx2(); else spin_scalar(); break;
+            case STIM_MEMORY: spin_memory(); break;
+            default:          sleep_seconds(0.001, NULL); break;
+        }
+    }
+
+    return NULL;
+}
+
+//Random cyclic permutation of cache lines (Sattolo), so every load misses
+static int build_chase() {
+    size_t n, i, j, stride, t;
+
+    stride = 64 / sizeof(size_t);
+    n = STIM_MEMORY_BYTES / 64;
+    chase = malloc(n * 64);
+    if (!chase) return 0;
+
+    for (i = 0; i < n; i++) chase[i * stride] = i;
+    for (i = n - 1; i > 0; i--) {
+        j = (((size_t)rand() << 16) ^ rand()) % i;
+        t = chase[i * stride];
+        chase[i * stride] = chase[j * stride];
+        chase[j * stride] = t;
+    }
+    for (i = 0; i < n; i++) chase[i * stride] *= stride;
+
+    return 1;
+}
+
+static int parse_spec(const char *spec, unsigned int *kinds, int *cpus, int *num_cpus, int max_cpus) {
+    const char *p, *end;
+    char *num_end;
+    int a, b, k;
+    size_t len;
+
+    *kinds = 0;
+    *num_cpus = 0;
+    for (p = spec; p && *p; p = *end ? end + 1 : end) {
+        end = strchr(p, ',');
+        if (!end) end = p + strlen(p);
+        len = end - p;
+
+        if (*p >= '0' && *p <= '9') {
+            a = b = strtol(p, &num_end, 10);
+            if (*num_end == '-') b = strtol(num_end + 1, &num_end, 10);
+            if (num_end != end || b < a) return 0;
+            for (; a <= b; a++) {
+                if (a >= max_cpus) return 0;
+                for (k = 0; k < *num_cpus && cpus[k] != a; k++);
+                if (k == *num_cpus) cpus[(*num_cpus)++] = a;
+            }
+            continue;
+        }
+        for (k = 0; k < STIM_NUM_KINDS; k++)
+            if (strlen(stim_kind_names[k]) == len && !strncmp(p, stim_kind_names[k], len)) break;
+        if (k == STIM_NUM_KINDS) return 0;
+        *kinds |= 1 << k;
+    }
+    if (!*kinds) *kinds = (1 << STIM_NUM_KINDS) - 1;
+
+    return 1;
+}
+
+//Samples until the end of the step and records which CPU was loaded with which kind
+static void sample_step(smu_obj_t *obj, layout_learner *l, unsigned char *pm_buf, short *active, unsigned char *kind,
+    int cur, int cur_kind, double seconds, double interval_s) {
+    double end;
+
+    end = monotonic_s() + seconds;
+    while (monotonic_s() < end && l->num_samples < l->max_samples) {
+        if (smu_read_pm_table(obj, pm_buf, obj->pm_table_size) == SMU_Return_OK) {
+            active[l->num_samples] = cur;
+            kind[l->num_samples] = cur_kind;
+            layout_learn_add(l, pm_buf);
+        }
+        sleep_seconds(interval_s, NULL);
+    }
+}
+
+static int compare_abs_desc(const void *a, const void *b, void *arg) {
+    const float *corr = arg;
+    float x = fabsf(corr[*(const int*)a]), y = fabsf(corr[*(const int*)b]);
+
+    return (x < y) - (x > y);
+}
+
+//Mean of slot base + cores[i] while CPU i was loaded with the kind, over all CPUs. STIM_IDLE for no load.
+static float loaded_mean(const layout_learner *l, const short *active, const unsigned char *kind,
+    int base, const int *cores, int num_cpus, int k) {
+    double sum = 0;
+    unsigned int i, n = 0;
+    int c;
+
+    for (i = 0; i < l->num_samples; i++) {
+        if (k == STIM_IDLE) {
+            if (active[i] != STIM_IDLE) continue;
+            for (c = 0; c < num_cpus; c++) sum += l->data[(size_t)i * l->stride + base + cores[c]];
+            n += num_cpus;
+        }
+        else if (active[i] != STIM_IDLE && kind[i] == k) {
+            sum += l->data[(size_t)i * l->stride + base + cores[active[i]]];
+            n++;
+        }
+    }
+
+    return n ? sum / n : NAN;
+}
+
+static void report(layout_learner *l, const float *corr, const short *active, const unsigned char *kind,
+    unsigned int kinds, const int *cpus, const int *cores, int num_cpus, FILE *out) {
+    int *order, *votes, c, j, k, base, found, last;
+    const float *cc;
+
+    order = malloc(l->num_slots * sizeof(int));
+    votes = calloc(l->num_slots, sizeof(int));
+    if (!order || !votes) {
+        free(order);
+        free(votes);
+        return;
+    }
+
+    fprintf(out, "# PM table offsets (float index) by correlation with the load on each CPU\n");
+    for (c = 0; c < num_cpus; c++) {
+        cc = corr + (size_t)c * l->stride;
+        for (j = 0; j < (int)l->num_slots; j++) order[j] = j;
+        qsort_r(order, l->num_slots, sizeof(int), compare_abs_desc, (void*)cc);
+
+        fprintf(out, "cpu %3d:", cpus[c]);
+        for (j = 0; j < STIM_TOP; j++) fprintf(out, " %4d(%+.2f)", order[j], cc[order[j]]);
+        fprintf(out, "\n");
+
+        //Offsets following CPU c vote for an array starting its PM core index elements earlier
+        for (j = 0; j < STIM_TOP; j++)
+            if (fabsf(cc[order[j]]) >= STIM_MIN_CORR && order[j] >= cores[c]) votes[order[j] - cores[c]]++;
+    }
+
+    last = 0;
+    for (c = 0; c < num_cpus; c++) if (cores[c] > last) last = cores[c];
+
+    fprintf(out, "\n# Per core arrays: offsets base..base+%d, each following its CPU\n", last);
+    fprintf(out, "# base       cpus  mean r  values            idle");
+    for (k = 0; k < STIM_NUM_KINDS; k++)
+        if (kinds & (1 << k)) fprintf(out, " %8s", stim_kind_names[k]);
+    fprintf(out, "\n");
+    found = 0;
+    for (base = 0; base + last < (int)l->num_slots; base++) {
+        float r = 0;
+
+        if (votes[base] * 2 < num_cpus) continue;
+        for (c = 0; c < num_cpus; c++) r += corr[(size_t)c * l->stride + base + cores[c]];
+        fprintf(out, "%4d..%-4d %3d/%-3d %+6.2f  %-16s %6.2f", base, base + last, votes[base], num_cpus,
+            r / num_cpus, layout_learn_describe(l->ranges[base]),
+            loaded_mean(l, active, kind, base, cores, num_cpus, STIM_IDLE));
+        for (k = 0; k < STIM_NUM_KINDS; k++)
+            if (kinds & (1 << k)) fprintf(out, " %8.2f", loaded_mean(l, active, kind, base, cores, num_cpus, k));
+        fprintf(out, "\n");
+        found++;
+    }
+    if (!found) fprintf(out, "# none found\n");
+
+    free(order);
+    free(votes);
+}
+
+int run_stimulus(smu_obj_t *obj, const char *spec, double interval_s, FILE *out) {
+    unsigned char *pm_buf, *kind;
+    unsigned int kinds, max_samples;
+    int *cpus, *cores, num_cpus, max_cpus, c, k, round, steps, have_topo;
+    stim_worker *workers;
+    cpu_topology topo;
+    system_info sysinfo;
+    layout_learner l;
+    short *active;
+    float *ref, *corr;
+    double t;
+    unsigned int i;
+
+    max_cpus = sysconf(_SC_NPROCESSORS_CONF);
+    cpus = malloc(max_cpus * sizeof(int));
+    cores = malloc(max_cpus * sizeof(int));
+    if (!cpus || !cores || !parse_spec(spec, &kinds, cpus, &num_cpus, max_cpus)) {
+        fprintf(stderr, "Invalid stimulus \"%s\". Expected load kinds (scalar, avx2, memory) and CPUs, e.g. avx2,0-7.\n", spec);
+        exit(0);
+    }
+
+    memset(&sysinfo, 0, sizeof(system_info));
+    have_topo = cpu_topology_init(&topo, &sysinfo, max_cpus);
+
+    //Default: first thread of each physical core, in the order of the PM table cores.
+    //Disabled or offline cores leave gaps, so walk every slot.
+    if (!num_cpus) {
+        if (!have_topo) {
+            fprintf(stderr, "Could not read the CPU topology from sysfs.\n");
+            exit(0);
+        }
+        for (c = 0; c < max_cpus; c++) {
+            if (cpu_topology_core_cpu(&topo, c, 0) < 0) continue;
+            cores[num_cpus] = c;
+            cpus[num_cpus++] = cpu_topology_core_cpu(&topo, c, 0);
+        }
+    }
+    //Given CPUs: their PM table core, or the position in the list without a topology
+    else {
+        for (c = 0; c < num_cpus; c++) {
+            cores[c] = c;
+            if (have_topo && cpus[c] < topo.num_cpus && topo.cpu_to_core[cpus[c]] >= 0)
+                cores[c] = topo.cpu_to_core[cpus[c]];
+        }
+    }
+    if (have_topo) cpu_topology_free(&topo);
+
+#if defined(__x86_64__) || defined(__i386__)
+    have_avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+    if (kinds & (1 << STIM_AVX2) && !have_avx2) fprintf(stderr, "No AVX2. The avx2 load runs scalar code.\n");
+    if (kinds & (1 << STIM_MEMORY) && !build_chase()) {
+        fprintf(stderr, "Could not allocate memory for the memory load.\n");
+        exit(0);
+    }
+
+    steps = 0;
+    for (k = 0; k < STIM_NUM_KINDS; k++) if (kinds & (1 << k)) steps += STIM_ROUNDS * num_cpus;
+    t = 1.0 + steps * (STIM_ON_S + STIM_OFF_S);
+    max_samples = t / (interval_s > 0.001 ? interval_s : 0.001) + 100;
+
+    pm_buf = calloc(obj->pm_table_size, sizeof(unsigned char));
+    active = malloc(max_samples * sizeof(short));
+    kind = malloc(max_samples);
+    workers = calloc(num_cpus, sizeof(stim_worker));
+    if (!pm_buf || !active || !kind || !workers || !layout_learn_init(&l, obj->pm_table_size, max_samples)) {
+        fprintf(stderr, "Could not allocate memory for the stimulus.\n");
+        exit(0);
+    }
+
+    for (c = 0; c < num_cpus; c++) {
+        workers[c].cpu = cpus[c];
+        workers[c].state = STIM_IDLE;
+        workers[c].running = !pthread_create(&workers[c].thread, NULL, worker_main, &workers[c]);
+        if (!workers[c].running) fprintf(stderr, "Could not start the load thread for CPU %d.\n", cpus[c]);
+    }
+
+    fprintf(stderr, "Loading %d CPUs one at a time. This takes about %.0f seconds.\n", num_cpus, t);
+    sample_step(obj, &l, pm_buf, active, kind, STIM_IDLE, 0, 1.0, interval_s);
+    for (round = 0; round < STIM_ROUNDS; round++) {
+        for (k = 0; k < STIM_NUM_KINDS; k++) {
+            if (!(kinds & (1 << k))) continue;
+            for (c = 0; c < num_cpus; c++) {
+                __atomic_store_n(&workers[c].state, k, __ATOMIC_RELAXED);
+                sample_step(obj, &l, pm_buf, active, kind, c, k, STIM_ON_S, interval_s);
+                __atomic_store_n(&workers[c].state, STIM_IDLE, __ATOMIC_RELAXED);
+                sample_step(obj, &l, pm_buf, active, kind, STIM_IDLE, 0, STIM_OFF_S, interval_s);
+            }
+        }
+        fprintf(stderr, "Round %d of %d done.\n", round + 1, STIM_ROUNDS);
+    }
+
+    for (c = 0; c < num_cpus; c++) {
+        __atomic_store_n(&workers[c].state, STIM_EXIT, __ATOMIC_RELAXED);
+        if (workers[c].running) pthread_join(workers[c].thread, NULL);
+    }
+
+    //Correlate every offset with the schedule of each CPU
+    ref = malloc(l.num_samples * sizeof(float));
+    corr = aligned_alloc(32, (size_t)num_cpus * l.stride * sizeof(float));
+    if (!ref || !corr || l.num_samples < 2) {
+        fprintf(stderr, "Not enough samples of the PM Table.\n");
+        exit(0);
+    }
+    layout_learn_analyze(&l);
+    for (c = 0; c < num_cpus; c++) {
+        for (i = 0; i < l.num_samples; i++) ref[i] = active[i] == c;
+        layout_learn_correlate(&l, ref, corr + (size_t)c * l.stride);
+    }
+    report(&l, corr, active, kind, kinds, cpus, cores, num_cpus, out);
+
+    free(ref);
+    free(corr);
+    free(workers);
+    free(kind);
+    free(active);
+    free(pm_buf);
+    free(cpus);
+    free(cores);
+    free(chase);
+    chase = NULL;
+    layout_learn_free(&l);
+
+    return 0;
+}
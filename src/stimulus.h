@@ -0,0 +1,46 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef STIMULUS_H
+#define STIMULUS_H
+
+#include <stdio.h>
+#include <libsmu.h>
+
+enum {
+    STIM_SCALAR,    //Integer and scalar float dependency chains
+    STIM_AVX2,      //256 bit FMA. Falls back to scalar without AVX2.
+    STIM_MEMORY,    //Pointer chasing through a buffer larger than the L3
+    STIM_NUM_KINDS
+};
+
+#define STIM_ON_S       0.3     //Load on one core per step
+#define STIM_OFF_S      0.2     //Idle after each step, so the values settle
+#define STIM_ROUNDS     2       //Passes over all cores and kinds
+#define STIM_TOP        8       //Offsets listed per core
+#define STIM_MIN_CORR   0.5f    //Offsets below this don't count for arrays
+
+//spec is a comma separated list of load kinds (scalar, avx2, memory) and Linux CPUs ("0-7", "3").
+//Without kinds all are used, without CPUs the first thread of every physical core. spec may be NULL.
+//Loads one CPU at a time with each kind while sampling the PM table every interval_s seconds.
+//Afterwards ranks every PM table offset by its correlation with the load schedule of each CPU
+//and writes the result, including arrays with a per core stride, to out.
+int run_stimulus(smu_obj_t *obj, const char *spec, double interval_s, FILE *out);
+
+#endif
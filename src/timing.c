@@ -0,0 +1,56 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <time.h>
+#include <errno.h>
+#include <sys/resource.h>
+
+#include "timing.h"
+
+uint64_t monotonic_ns() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+double monotonic_s() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void sleep_seconds(double seconds, volatile sig_atomic_t *stop) {
+    struct timespec ts;
+
+    if (seconds <= 0) return;
+    ts.tv_sec = (time_t)seconds;
+    ts.tv_nsec = (long)((seconds - ts.tv_sec) * 1e9);
+    while (nanosleep(&ts, &ts) && errno == EINTR && !(stop && *stop));
+}
+
+void process_usage(double *cpu_time, long *wakeups) {
+    struct rusage ru;
+
+    getrusage(RUSAGE_SELF, &ru);
+    *cpu_time = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec * 1e-6
+              + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec * 1e-6;
+    *wakeups = ru.ru_nvcsw;
+}
@@ -0,0 +1,36 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdint.h>
+#include <signal.h>
+
+//CLOCK_MONOTONIC
+uint64_t monotonic_ns();
+double monotonic_s();
+
+//CPU time of the process in seconds and its voluntary context switches, which are its wakeups
+void process_usage(double *cpu_time, long *wakeups);
+
+//Sleeps the whole time even if signals interrupt it, unless *stop is set by then. stop may be NULL.
+void sleep_seconds(double seconds, volatile sig_atomic_t *stop);
+
+#endif
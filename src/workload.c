@@ -0,0 +1,267 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/**
+ * Run-a-command mode: Sample the PM table for the lifetime of a child process
+ * and print a perf-stat like summary of energy, power, temperature and
+ * residency figures when it exits.
+ **/
+
+#define _GNU_SOURCE
+
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+
+#include "workload.h"
+#include "timing.h"
+
+enum {
+    LIMIT_PPT,
+    LIMIT_TDC,
+    LIMIT_EDC,
+    LIMIT_THM,
+    LIMIT_FIT,
+    LIMIT_COUNT
+};
+
+static const char *limit_names[LIMIT_COUNT] = { "PPT", "TDC", "EDC", "THM", "FIT" };
+
+typedef struct {
+    double elapsed;          //Sampled time span in seconds
+    unsigned int samples;
+    unsigned int failed_reads;
+    double package_energy;   //Joule
+    float peak_power;
+    float peak_temp;
+    float peak_core_temp;
+    double throttle_time[LIMIT_COUNT];
+    int limit_available[LIMIT_COUNT];
+    double pc6;              //Time weighted sum of the package C6 residency
+    //Per core. All sums are weighted with the sample duration.
+    double *core_energy;
+    double *core_freq;       //Only accumulated while the core is active
+    double *core_active_time;
+    double *core_c0;
+    double *core_cc1;
+    double *core_cc6;
+    //Cost of the monitoring itself
+    double sample_time;      //Wall time spent reading and accumulating samples
+} workload_stats;
+
+static double cpu_time_s() {
+    double cpu_time;
+    long wakeups;
+
+    process_usage(&cpu_time, &wakeups);
+    return cpu_time;
+}
+
+static void accumulate_limit(workload_stats *st, int limit, pm_frame *frame, int value, int max, double dt) {
+    if (!pm_frame_valid(frame, value) || !pm_frame_valid(frame, max) || frame->scalars[max] <= 0) return;
+
+    st->limit_available[limit] = 1;
+    if (frame->scalars[value] >= frame->scalars[max] * WORKLOAD_THROTTLE_RATIO) st->throttle_time[limit] += dt;
+}
+
+static void accumulate_sample(workload_stats *st, pm_frame *frame, system_info *sysinfo, double dt) {
+    float power, temp;
+    int i;
+
+    power = pmf_valid(SOCKET_POWER) ? pmf(SOCKET_POWER) : pmf0(PPT_VALUE);
+    st->package_energy += power * dt;
+    if (st->peak_power < power) st->peak_power = power;
+
+    temp = pmf0(THM_VALUE);
+    if (st->peak_temp < temp) st->peak_temp = temp;
+
+    accumulate_limit(st, LIMIT_PPT, frame, PMF_PPT_VALUE, PMF_PPT_LIMIT, dt);
+    accumulate_limit(st, LIMIT_TDC, frame, PMF_TDC_VALUE, PMF_TDC_LIMIT, dt);
+    accumulate_limit(st, LIMIT_EDC, frame, PMF_EDC_VALUE, PMF_EDC_LIMIT, dt);
+    accumulate_limit(st, LIMIT_THM, frame, PMF_THM_VALUE, PMF_THM_LIMIT, dt);
+    accumulate_limit(st, LIMIT_FIT, frame, PMF_FIT_VALUE, PMF_FIT_LIMIT, dt);
+
+    st->pc6 += pmf0(PC6) * dt;
+
+    for (i = 0; i < frame->num_cores; i++) {
+        if (core_disabled(sysinfo, i)) continue;
+
+        st->core_energy[i] += pmf_nan0(frame->core_power[i]) * dt;
+        st->core_c0[i]     += pmf_nan0(frame->core_c0[i]) * dt;
+        st->core_cc1[i]    += pmf_nan0(frame->core_cc1[i]) * dt;
+        st->core_cc6[i]    += pmf_nan0(frame->core_cc6[i]) * dt;
+
+        temp = pmf_nan0(frame->core_temp[i]);
+        if (st->peak_core_temp < temp) st->peak_core_temp = temp;
+
+        // Same definition of an active core as on the main screen: at least 6% in C0.
+        if (pmf_nan0(frame->core_c0[i]) >= 6.f) {
+            st->core_freq[i] += pmf_nan0(frame->core_freqeff[i]) * 1000.f * dt;
+            st->core_active_time[i] += dt;
+        }
+    }
+
+    st->elapsed += dt;
+    st->samples++;
+}
+
+static void print_summary(workload_stats *st, pm_frame *frame, system_info *sysinfo, char **command,
+    int status, double interval_s, double cpu_time) {
+    double t, active_freq, active_time;
+    int i, core_number;
+
+    t = st->elapsed > 0 ? st->elapsed : 1;
+
+    fprintf(stderr, "\n Ryzen Monitor stats for '");
+    for (i = 0; command[i]; i++) fprintf(stderr, "%s%s", i ? " " : "", command[i]);
+    if (WIFEXITED(status))
+        fprintf(stderr, "' (exit code %d):\n\n", WEXITSTATUS(status));
+    else if (WIFSIGNALED(status))
+        fprintf(stderr, "' (killed by signal %d):\n\n", WTERMSIG(status));
+    else
+        fprintf(stderr, "':\n\n");
+
+    fprintf(stderr, "  %12.3f s    elapsed (%u samples every %.3f s", st->elapsed, st->samples, interval_s);
+    if (st->failed_reads) fprintf(stderr, ", %u failed reads", st->failed_reads);
+    fprintf(stderr, ")\n");
+    fprintf(stderr, "  %12.3f J    package energy\n", st->package_energy);
+    fprintf(stderr, "  %12.3f W    average package power\n", st->package_energy / t);
+    fprintf(stderr, "  %12.3f W    peak package power\n", st->peak_power);
+    fprintf(stderr, "  %12.2f C    peak temperature\n", st->peak_temp);
+    fprintf(stderr, "  %12.2f C    peak core temperature\n", st->peak_core_temp);
+    if (pmf_valid(PC6)) fprintf(stderr, "  %12.2f %%    average package C6 residency\n", st->pc6 / t);
+
+    fprintf(stderr, "\n  Time in throttle (value >= %.0f %% of limit):\n", WORKLOAD_THROTTLE_RATIO * 100);
+    for (i = 0; i < LIMIT_COUNT; i++) {
+        if (!st->limit_available[i]) continue;
+        fprintf(stderr, "  %12.3f s    %-4s (%6.2f %%)\n", st->throttle_time[i], limit_names[i],
+            st->throttle_time[i] / t * 100);
+    }
+
+    fprintf(stderr, "\n  %-7s %12s %10s %14s %8s %8s %8s %8s\n",
+        "", "Energy", "Avg Power", "Eff. Freq", "Active", "C0", "CC1", "CC6");
+    active_freq = active_time = 0;
+    core_number = 0;
+    for (i = 0; i < frame->num_cores; i++) {
+        if (core_disabled(sysinfo, i)) continue;
+
+        fprintf(stderr, "  Core %2d %10.3f J %8.3f W ", core_number++, st->core_energy[i], st->core_energy[i] / t);
+        if (st->core_active_time[i] > 0)
+            fprintf(stderr, "%10.0f MHz ", st->core_freq[i] / st->core_active_time[i]);
+        else
+            fprintf(stderr, "%10s     ", "-");
+        fprintf(stderr, "%6.2f %% %6.2f %% %6.2f %% %6.2f %%\n", st->core_active_time[i] / t * 100,
+            st->core_c0[i] / t, st->core_cc1[i] / t, st->core_cc6[i] / t);
+
+        active_freq += st->core_freq[i];
+        active_time += st->core_active_time[i];
+    }
+    if (active_time > 0)
+        fprintf(stderr, "\n  %12.0f MHz  average effective frequency of the active cores\n", active_freq / active_time);
+
+    fprintf(stderr, "\n  Sampling overhead: %.3f ms CPU time (%.4f %% of one core), %.1f us per sample\n\n",
+        cpu_time * 1e3, cpu_time / t * 100, st->samples ? st->sample_time / st->samples * 1e6 : 0);
+}
+
+int run_workload(smu_obj_t *obj, pm_frame *frame, system_info *sysinfo, unsigned char *pm_buf,
+    char **command, double interval_s) {
+    workload_stats st;
+    sigset_t chld, old;
+    struct timespec ts;
+    double *core_data, start, last, next, now, remaining, cpu_start, t;
+    int status = 0, exited = 0;
+    pid_t pid;
+
+    memset(&st, 0, sizeof(st));
+    core_data = calloc(6 * frame->num_cores, sizeof(double));
+    if (!core_data) {
+        fprintf(stderr, "Could not allocate memory for the workload statistics.\n");
+        exit(0);
+    }
+    st.core_energy      = core_data;
+    st.core_freq        = core_data + 1 * frame->num_cores;
+    st.core_active_time = core_data + 2 * frame->num_cores;
+    st.core_c0          = core_data + 3 * frame->num_cores;
+    st.core_cc1         = core_data + 4 * frame->num_cores;
+    st.core_cc6         = core_data + 5 * frame->num_cores;
+
+    //SIGCHLD is only collected with sigtimedwait. This way, the end of the command
+    //is noticed immediately and not only after the current interval.
+    sigemptyset(&chld);
+    sigaddset(&chld, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &chld, &old);
+
+    cpu_start = cpu_time_s();
+    start = last = monotonic_s();
+
+    pid = fork();
+    if (pid < 0) {
+        perror("Could not start the command");
+        exit(-1);
+    }
+    if (pid == 0) {
+        sigprocmask(SIG_SETMASK, &old, NULL);
+        execvp(command[0], command);
+        fprintf(stderr, "Could not execute \"%s\": %s\n", command[0], strerror(errno));
+        _exit(127);
+    }
+
+    //Interrupts are meant for the command. We stay alive to print the summary.
+    signal(SIGINT, SIG_IGN);
+    signal(SIGQUIT, SIG_IGN);
+
+    next = start + interval_s;
+    while (!exited) {
+        remaining = next - monotonic_s();
+        if (remaining > 0) {
+            ts.tv_sec = (time_t)remaining;
+            ts.tv_nsec = (long)((remaining - ts.tv_sec) * 1e9);
+            sigtimedwait(&chld, NULL, &ts);
+        }
+        if (waitpid(pid, &status, WNOHANG) == pid) exited = 1;
+
+        now = monotonic_s();
+        if (smu_read_pm_table_range(obj, pm_buf, 0, frame->pmt->min_size) == SMU_Return_OK) {
+            pm_frame_extract(frame);
+            accumulate_sample(&st, frame, sysinfo, now - last);
+            last = now;
+        }
+        else st.failed_reads++;
+        st.sample_time += monotonic_s() - now;
+
+        next += interval_s;
+        if (next < now) next = now + interval_s;
+    }
+
+    t = cpu_time_s() - cpu_start;
+    print_summary(&st, frame, sysinfo, command, status, interval_s, t);
+
+    free(core_data);
+
+    if (WIFEXITED(status)) return WEXITSTATUS(status);
+    if (WIFSIGNALED(status)) return 128 + WTERMSIG(status);
+    return 0;
+}
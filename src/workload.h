@@ -0,0 +1,36 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor
+ * Copyright (C) 2021-2022
+ *    Florian Huehn <hattedsquirrel@gmail.com> (https://hattedsquirrel.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <libsmu.h>
+#include "readinfo.h"
+#include "pm_frame.h"
+
+//A limit counts as throttling once its value reaches this fraction of the limit
+#define WORKLOAD_THROTTLE_RATIO 0.99f
+
+//Runs command (NULL terminated argv) as a child process and samples the PM table
+//every interval_s seconds into frame until it exits. Prints a summary to stderr afterwards.
+//Returns the exit code of the command.
+int run_workload(smu_obj_t *obj, pm_frame *frame, system_info *sysinfo, unsigned char *pm_buf,
+    char **command, double interval_s);
+
+#endif